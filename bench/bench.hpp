@@ -0,0 +1,42 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string_view>
+#include <vector>
+
+/**
+ * Helpers of the benchmarks in bench/. They are plain executables built in
+ * release mode and run by hand - the numbers depend on the machine, so
+ * nothing is checked
+ **/
+namespace bench {
+
+// Keeps the compiler from dropping a result that is never used
+template <typename T> inline void doNotOptimize(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Median over "runs" runs of the time of one call of f in nanoseconds
+template <typename F>
+double nsPerOp(F &&f, size_t iterations, int runs = 7) {
+  std::vector<double> results;
+  for (int run = 0; run < runs; ++run) {
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i)
+      f();
+    const std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+    results.push_back(elapsed.count() / iterations);
+  }
+  std::ranges::nth_element(results, results.begin() + runs / 2);
+  return results[runs / 2];
+}
+
+inline void report(std::string_view name, double ns, FILE *out = stdout) {
+  std::fprintf(out, "%-48.*s %12.1f ns\n", static_cast<int>(name.size()),
+               name.data(), ns);
+}
+
+} // namespace bench
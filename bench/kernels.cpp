@@ -0,0 +1,92 @@
+#include "bench.hpp"
+#include "game/Kernels.hpp"
+#include <random>
+#include <string>
+#include <vector>
+
+using kernels::Isa;
+
+// Elements processed per measurement, whatever the batch size
+constexpr size_t ELEMENTS = 20'000'000;
+// Small enough that no entity reaches its destination during the runs
+constexpr float STEP = 0.001f;
+
+struct Arrays {
+  std::vector<float> posX, posY, destX, destY, dirX, dirY;
+  std::vector<uint8_t> stopped;
+  std::vector<uint32_t> outside;
+};
+
+// A wave of enemies around the map, an eighth of them stopped and a tenth
+// of them outside of it
+static Arrays makeArrays(size_t count) {
+  std::mt19937 rng(count);
+  std::uniform_real_distribution<float> coordinate(-50.f, 560.f);
+  std::uniform_real_distribution<float> unit(-1.f, 1.f);
+  std::uniform_int_distribution<int> eighth(0, 7);
+
+  Arrays arrays;
+  for (size_t i = 0; i < count; ++i) {
+    arrays.posX.push_back(coordinate(rng));
+    arrays.posY.push_back(coordinate(rng));
+    arrays.destX.push_back(coordinate(rng));
+    arrays.destY.push_back(coordinate(rng));
+    arrays.dirX.push_back(unit(rng));
+    arrays.dirY.push_back(unit(rng));
+    arrays.stopped.push_back(eighth(rng) == 0);
+  }
+  arrays.outside.resize(count);
+  return arrays;
+}
+
+static void benchIsa(Isa isa, size_t count) {
+  kernels::setIsa(isa);
+  Arrays arrays = makeArrays(count);
+  const size_t iterations = ELEMENTS / count;
+  const sf::FloatRect map({0.f, 0.f}, {512.f, 512.f});
+  const std::string suffix =
+      ", " + std::to_string(count) + ", " + kernels::getIsaName(isa);
+
+  bench::report("steer" + suffix, bench::nsPerOp(
+                                      [&] {
+                                        kernels::steer(
+                                            arrays.posX.data(),
+                                            arrays.posY.data(),
+                                            arrays.destX.data(),
+                                            arrays.destY.data(),
+                                            arrays.stopped.data(), count,
+                                            STEP);
+                                        bench::doNotOptimize(arrays.posX);
+                                      },
+                                      iterations));
+  bench::report("integrate" + suffix,
+                bench::nsPerOp(
+                    [&] {
+                      kernels::integrate(arrays.posX.data(),
+                                         arrays.posY.data(),
+                                         arrays.dirX.data(),
+                                         arrays.dirY.data(), count, STEP);
+                      bench::doNotOptimize(arrays.posX);
+                    },
+                    iterations));
+  bench::report("findOutside" + suffix,
+                bench::nsPerOp(
+                    [&] {
+                      bench::doNotOptimize(kernels::findOutside(
+                          arrays.posX.data(), arrays.posY.data(), count, map,
+                          arrays.outside.data()));
+                    },
+                    iterations));
+}
+
+int main() {
+  const Isa supported = kernels::getSupportedIsa();
+  // Odd sizes so the scalar tails are in there as well
+  for (size_t count : {100u, 1003u, 10'007u, 100'003u}) {
+    for (Isa isa : {Isa::Scalar, Isa::SSE2, Isa::AVX2}) {
+      if (isa <= supported)
+        benchIsa(isa, count);
+    }
+    std::printf("\n");
+  }
+}
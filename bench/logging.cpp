@@ -0,0 +1,75 @@
+#include "bench.hpp"
+#include "logging.hpp"
+#include <cstdio>
+#include <iostream>
+#include <unistd.h>
+
+/**
+ * Cost of a log call on the calling thread, against std::cout with
+ * std::endl like the logging did before. The messages go to /dev/null, the
+ * results to where stdout was.
+ **/
+
+// Calls that fit in the ring of the thread, so nothing waits for the
+// background thread
+constexpr size_t BURST = 500;
+constexpr int BURSTS = 101;
+// Calls that fill the ring many times over
+constexpr size_t SUSTAINED = 200'000;
+
+// A hit like Level::handleFireballHits logs it
+static void logHit(int health) { LOG_INFO("Enemy hit. health left: ", health); }
+
+// Median time of a call over bursts. The background thread catches up
+// between them
+template <typename F> static double burstNsPerCall(F &&f) {
+  std::vector<double> results;
+  for (int burst = 0; burst < BURSTS; ++burst) {
+    results.push_back(bench::nsPerOp(f, BURST, 1));
+    logging::flush();
+  }
+  std::ranges::nth_element(results, results.begin() + BURSTS / 2);
+  return results[BURSTS / 2];
+}
+
+int main() {
+  FILE *results = fdopen(dup(STDOUT_FILENO), "w");
+  if (results == nullptr || !std::freopen("/dev/null", "w", stdout)) {
+    std::fprintf(stderr, "Couldn't redirect stdout\n");
+    return 1;
+  }
+
+  int health = 100;
+  auto hit = [&health] { logHit(--health); };
+  auto tick = [&health] {
+    const int number = ++health;
+    LOG_INFO("Tick ", number, " took ", number * 0.013, " ms, ",
+             "allocations: ", 0u);
+  };
+
+  bench::report("LOG_INFO int, burst", burstNsPerCall(hit), results);
+  bench::report("LOG_INFO int float string, burst", burstNsPerCall(tick),
+                results);
+
+  // The writes to /dev/null are cheap, so these are the best case of a full
+  // ring. Blocking waits for the background thread to format the records
+  logging::setOverflowPolicy(logging::OverflowPolicy::Block);
+  bench::report("LOG_INFO int, sustained, blocking",
+                bench::nsPerOp(hit, SUSTAINED), results);
+  logging::flush();
+  logging::setOverflowPolicy(logging::OverflowPolicy::Drop);
+  bench::report("LOG_INFO int, sustained, dropping",
+                bench::nsPerOp(hit, SUSTAINED), results);
+  logging::flush();
+  logging::setOverflowPolicy(logging::OverflowPolicy::Block);
+
+  bench::report("std::cout with std::endl, as before",
+                bench::nsPerOp(
+                    [&health] {
+                      std::cout << "Enemy hit. health left: " << --health
+                                << std::endl;
+                    },
+                    SUSTAINED),
+                results);
+  std::fclose(results);
+}
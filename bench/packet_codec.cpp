@@ -0,0 +1,138 @@
+#include "bench.hpp"
+#include "network/packet.hpp"
+#include <cstring>
+#include <string>
+
+using namespace network;
+
+constexpr size_t ITERATIONS = 1'000'000;
+
+/**
+ * Codec the schema tables replaced: std::visit with a copy through a stack
+ * buffer to encode and a recursive search of the variant index to decode.
+ * Fixed size packets were copied as whole structs, padding included
+ **/
+namespace previous {
+
+template <typename VARIANT> std::string serializePacket(const VARIANT &packet) {
+  std::string body;
+  std::visit(
+      [&body](auto &&p) {
+        using T = std::decay_t<decltype(p)>;
+        if constexpr (internal::HasCustomSerialization<T>) {
+          p.serialize(body);
+        } else {
+          char buf[sizeof(T)] = {0};
+          std::memcpy(buf, &p, sizeof(T));
+          body.append(buf, sizeof(T));
+        }
+      },
+      packet);
+  return body;
+}
+
+template <class VARIANT, internal::PacketType INDEX = 0>
+std::optional<VARIANT> deserializePacket(internal::PacketType index,
+                                         std::string_view data) {
+  if constexpr (INDEX < std::variant_size_v<VARIANT>) {
+    if (index == INDEX) {
+      using T = std::variant_alternative_t<INDEX, VARIANT>;
+      T obj;
+      if constexpr (internal::HasCustomSerialization<T>) {
+        if (!obj.deserialize(data))
+          return std::nullopt;
+      } else {
+        if (data.size() != sizeof(T))
+          return std::nullopt;
+        std::memcpy(&obj, data.data(), sizeof(T));
+      }
+      return VARIANT{std::move(obj)};
+    }
+    return deserializePacket<VARIANT, INDEX + 1>(index, data);
+  } else {
+    return std::nullopt;
+  }
+}
+
+} // namespace previous
+
+template <typename VARIANT, typename T>
+static void benchPacket(const std::string &name, const T &packet) {
+  const VARIANT variant(packet);
+  const auto index = static_cast<internal::PacketType>(variant.index());
+
+  std::string tableBody;
+  internal::serializePacket(tableBody, variant);
+  const std::string previousBody = previous::serializePacket(variant);
+  std::printf("%s: %zu body bytes (previously %zu)\n", name.c_str(),
+              tableBody.size(), previousBody.size());
+
+  // The previous encoder returned a new string, the table one appends
+  std::string body;
+  bench::report(name + " encode, table", bench::nsPerOp(
+                                             [&] {
+                                               body.clear();
+                                               internal::serializePacket(
+                                                   body, variant);
+                                               bench::doNotOptimize(body);
+                                             },
+                                             ITERATIONS));
+  bench::report(name + " encode, previous",
+                bench::nsPerOp(
+                    [&] {
+                      auto result = previous::serializePacket(variant);
+                      bench::doNotOptimize(result);
+                    },
+                    ITERATIONS));
+
+  bench::report(name + " decode, table",
+                bench::nsPerOp(
+                    [&] {
+                      auto result = internal::deserializePacket<VARIANT>(
+                          index, tableBody);
+                      bench::doNotOptimize(result);
+                    },
+                    ITERATIONS));
+  bench::report(name + " decode, previous",
+                bench::nsPerOp(
+                    [&] {
+                      auto result = previous::deserializePacket<VARIANT>(
+                          index, previousBody);
+                      bench::doNotOptimize(result);
+                    },
+                    ITERATIONS));
+
+  // Whole messages with the header, as sent and received
+  bench::report(name + " encodePacket", bench::nsPerOp(
+                                            [&] {
+                                              auto result =
+                                                  encodePacket(variant);
+                                              bench::doNotOptimize(result);
+                                            },
+                                            ITERATIONS));
+  const std::string message = encodePacket(variant);
+  bench::report(name + " decodePacket",
+                bench::nsPerOp(
+                    [&] {
+                      auto result = decodePacket<VARIANT>(message);
+                      bench::doNotOptimize(result);
+                    },
+                    ITERATIONS));
+}
+
+int main() {
+  benchPacket<ServerPacket>("LobbyReadyResponse",
+                            LobbyReadyResponse{.playerID = 3, .isReady = true});
+  benchPacket<ServerPacket>("GameOverResponse", GameOverResponse{.isWon = 1});
+  benchPacket<ClientPacket>(
+      "PlayerMoveRequest",
+      PlayerMoveRequest{.direction = Direction::Left, .sequence = 1234});
+  benchPacket<ClientPacket>(
+      "FireballShotRequest",
+      FireballShotRequest{
+          .playerID = 2,
+          .fireball = {.id = 9, .pos = {100, 200}, .direction = {0, -1}}});
+  benchPacket<ClientPacket>(
+      "SnapshotAckRequest",
+      SnapshotAckRequest{.enemyTick = 1000, .fireballTick = 999});
+}
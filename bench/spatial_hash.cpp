@@ -0,0 +1,117 @@
+#include "bench.hpp"
+#include "game/Enemy.hpp"
+#include "game/Fireball.hpp"
+#include "game/SpatialHash.hpp"
+#include <cmath>
+#include <random>
+#include <string>
+
+constexpr float CELL_SIZE = 16.f;
+constexpr float ENEMY_SIZE = 2 * Enemy::RADIUS;
+constexpr float FIREBALL_SIZE = 2 * Fireball::RADIUS;
+// Brute force runs at least this long per measurement
+constexpr double BUDGET_NS = 2e8;
+
+struct World {
+  std::vector<EntityID> enemyIDs;
+  std::vector<sf::FloatRect> enemies;
+  std::vector<EntityID> fireballIDs;
+  std::vector<sf::FloatRect> fireballs;
+  sf::FloatRect base;
+};
+
+// Entities spread uniformly over a square of the given side, a fireball for
+// every 4 enemies like a busy wave
+static World makeWorld(uint32_t enemyCount, float side) {
+  std::mt19937 rng(enemyCount);
+  std::uniform_real_distribution<float> coordinate(0.f, side - ENEMY_SIZE);
+  auto at = [&](float size) {
+    return sf::FloatRect({coordinate(rng), coordinate(rng)}, {size, size});
+  };
+
+  World world;
+  for (uint32_t i = 0; i < enemyCount; ++i) {
+    world.enemyIDs.push_back(i + 1);
+    world.enemies.push_back(at(ENEMY_SIZE));
+  }
+  for (uint32_t i = 0; i < enemyCount / 4; ++i) {
+    world.fireballIDs.push_back(i + 1);
+    world.fireballs.push_back(at(FIREBALL_SIZE));
+  }
+  world.base = {{side / 2 - 32, side / 2 - 32}, {64, 64}};
+  return world;
+}
+
+// What Level::updateContacts does every tick. Returns the contact count
+static size_t gridContacts(SpatialHash &grid, const World &world) {
+  grid.clear();
+  for (size_t i = 0; i < world.enemies.size(); ++i)
+    grid.insert(world.enemyIDs[i], world.enemies[i]);
+  grid.build();
+
+  size_t contacts = 0;
+  for (const sf::FloatRect &fireball : world.fireballs)
+    contacts += grid.findFirst(fireball, [](EntityID) { return true; }) != 0;
+  grid.query(world.base, [&](EntityID, const sf::FloatRect &) {
+    ++contacts;
+    return true;
+  });
+  return contacts;
+}
+
+// Every fireball against every enemy, as before the grid
+static size_t bruteForceContacts(const World &world) {
+  size_t contacts = 0;
+  for (const sf::FloatRect &fireball : world.fireballs) {
+    for (const sf::FloatRect &enemy : world.enemies) {
+      if (fireball.findIntersection(enemy)) {
+        ++contacts;
+        break;
+      }
+    }
+  }
+  for (const sf::FloatRect &enemy : world.enemies)
+    contacts += world.base.findIntersection(enemy).has_value();
+  return contacts;
+}
+
+static void benchWorld(const std::string &name, uint32_t enemyCount,
+                       float side) {
+  const World world = makeWorld(enemyCount, side);
+  const auto cells = static_cast<uint32_t>(std::ceil(side / CELL_SIZE));
+  SpatialHash grid(cells, cells, CELL_SIZE);
+
+  // Both find the same contacts
+  const size_t contacts = gridContacts(grid, world);
+  if (contacts != bruteForceContacts(world))
+    std::printf("%s: contacts differ\n", name.c_str());
+
+  const double pairs =
+      static_cast<double>(world.fireballs.size()) * world.enemies.size();
+  const size_t iterations =
+      std::max<size_t>(1, static_cast<size_t>(BUDGET_NS / (pairs + 1)));
+  const int runs = iterations == 1 ? 3 : 7;
+
+  const double gridNs = bench::nsPerOp(
+      [&] { bench::doNotOptimize(gridContacts(grid, world)); },
+      std::max<size_t>(iterations, 20), runs);
+  const double bruteNs = bench::nsPerOp(
+      [&] { bench::doNotOptimize(bruteForceContacts(world)); }, iterations,
+      runs);
+
+  bench::report(name + ", grid", gridNs);
+  bench::report(name + ", brute force", bruteNs);
+  std::printf("%s: %zu contacts, grid speedup %.1fx\n\n", name.c_str(),
+              contacts, bruteNs / gridNs);
+}
+
+int main() {
+  // The game map is 32x32 tiles of 16 px. Past a few thousand entities it's
+  // packed, so the same density on a growing map is measured as well
+  for (uint32_t count : {100u, 1000u, 5000u, 10000u, 20000u, 50000u}) {
+    const std::string entities = std::to_string(count) + " enemies";
+    benchWorld(entities + " on the map", count, 512.f);
+    benchWorld(entities + " at 2 per tile", count,
+               CELL_SIZE * std::ceil(std::sqrt(count / 2.f)));
+  }
+}
@@ -0,0 +1,141 @@
+#include "bench.hpp"
+#include "game/Base.hpp"
+#include "game/Enemy.hpp"
+#include "game/Fireball.hpp"
+#include "game/HealthBar.hpp"
+#include "game/SpriteBatch.hpp"
+#include <SFML/Graphics/CircleShape.hpp>
+#include <SFML/Graphics/Image.hpp>
+#include <SFML/Graphics/RectangleShape.hpp>
+#include <SFML/Graphics/RenderTexture.hpp>
+#include <random>
+#include <string>
+
+/**
+ * Frame time of the enemies, fireballs and the base drawn offscreen into a
+ * sf::RenderTexture, through the sprite batch and as shapes drawn one by one
+ * like before it. Needs an OpenGL context like bench-tile-layer.
+ *
+ * Every frame reads the texture back so the GPU work is in the time.
+ **/
+
+constexpr unsigned TEXTURE_SIZE = 512;
+// Entities drawn per measurement, whatever their count
+constexpr size_t ENTITIES = 500'000;
+// Halfway between two ticks
+constexpr float ALPHA = 0.5f;
+
+struct Scene {
+  EnemyArrays enemies;
+  FireballArrays fireballs;
+  Base base{{TEXTURE_SIZE / 2.f - 32, TEXTURE_SIZE / 2.f - 32}};
+};
+
+// Enemies all over the texture at random health, a fireball for every 4 of
+// them like a busy wave
+static void fillScene(Scene &scene, uint32_t enemyCount) {
+  std::mt19937 rng(enemyCount);
+  std::uniform_real_distribution<float> coordinate(0.f, TEXTURE_SIZE - 16.f);
+  std::uniform_int_distribution<int> health(1, Enemy::MAX_HEALTH);
+  auto at = [&] { return sf::Vector2f{coordinate(rng), coordinate(rng)}; };
+
+  for (uint32_t i = 0; i < enemyCount; ++i) {
+    const EntityID id = scene.enemies.insert(at(), at());
+    scene.enemies.setHealth(scene.enemies.find(id), health(rng));
+  }
+  for (uint32_t i = 0; i < enemyCount / 4; ++i)
+    scene.fireballs.insert(at(), {1.f, 0.f});
+  scene.enemies.update(1 / 60.f);
+}
+
+// How the entities were drawn before the batch: a draw call per shape and
+// the health bars worked out every frame
+static void drawShapes(sf::RenderTarget &target, const Scene &scene) {
+  sf::CircleShape enemy(Enemy::RADIUS);
+  enemy.setFillColor(sf::Color::Magenta);
+  sf::RectangleShape barBack({HealthBar::MAX_WIDTH, HealthBar::HEIGHT});
+  barBack.setFillColor(sf::Color::Red);
+  sf::RectangleShape barFill;
+  barFill.setFillColor(sf::Color::Green);
+
+  const EnemyArrays &enemies = scene.enemies;
+  for (uint32_t i = 0; i < enemies.size(); ++i) {
+    const sf::Vector2f pos = enemies.getInterpolatedPosition(i, ALPHA);
+    enemy.setPosition(pos);
+    target.draw(enemy);
+
+    HealthBar bar({pos, {Enemy::RADIUS, Enemy::RADIUS}}, Enemy::MAX_HEALTH);
+    bar.health = enemies.health[i];
+    barBack.setPosition(bar.bounds.position);
+    target.draw(barBack);
+    barFill.setPosition(bar.bounds.position);
+    barFill.setSize(
+        {HealthBar::fillWidth(bar.health, bar.maxHealth), HealthBar::HEIGHT});
+    target.draw(barFill);
+  }
+
+  sf::CircleShape fireball(Fireball::RADIUS);
+  fireball.setFillColor(sf::Color::White);
+  const FireballArrays &fireballs = scene.fireballs;
+  for (uint32_t i = 0; i < fireballs.size(); ++i) {
+    fireball.setPosition(fireballs.getInterpolatedPosition(i, ALPHA));
+    target.draw(fireball);
+  }
+
+  sf::RectangleShape base(scene.base.rect.getSize());
+  base.setPosition(scene.base.rect.getPosition());
+  base.setFillColor(sf::Color::Blue);
+  target.draw(base);
+}
+
+static void benchScene(sf::RenderTexture &texture, uint32_t enemyCount) {
+  Scene scene;
+  fillScene(scene, enemyCount);
+  const size_t iterations = std::max<size_t>(1, ENTITIES / enemyCount);
+  const std::string name = std::to_string(enemyCount) + " enemies";
+
+  auto frame = [&texture](auto &&drawEntities) {
+    texture.clear();
+    drawEntities();
+    texture.display();
+    const sf::Image image = texture.getTexture().copyToImage();
+    bench::doNotOptimize(image.getSize());
+  };
+
+  SpriteBatch batch;
+  auto fillBatch = [&] {
+    scene.enemies.draw(batch, ALPHA);
+    scene.fireballs.draw(batch, ALPHA);
+    scene.base.draw(batch);
+  };
+  bench::report(name + " frame, sprite batch",
+                bench::nsPerOp(
+                    [&] {
+                      frame([&] {
+                        fillBatch();
+                        batch.flush(texture);
+                      });
+                    },
+                    iterations));
+  bench::report(name + " frame, shape per entity",
+                bench::nsPerOp(
+                    [&] { frame([&] { drawShapes(texture, scene); }); },
+                    iterations));
+
+  // What the batch draws in one call
+  fillBatch();
+  const size_t vertices = batch.getVertexCount();
+  batch.flush(texture);
+  std::printf("%s: %zu vertices per frame\n\n", name.c_str(), vertices);
+}
+
+int main() {
+  sf::RenderTexture texture;
+  if (!texture.resize({TEXTURE_SIZE, TEXTURE_SIZE})) {
+    std::fprintf(stderr, "Couldn't create the render texture\n");
+    return 1;
+  }
+
+  for (uint32_t count : {1'000u, 10'000u, 50'000u})
+    benchScene(texture, count);
+}
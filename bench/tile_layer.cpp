@@ -0,0 +1,102 @@
+#include "bench.hpp"
+#include "game/Level.hpp"
+#include "game/TileLayer.hpp"
+#include <SFML/Graphics/Image.hpp>
+#include <SFML/Graphics/RectangleShape.hpp>
+#include <SFML/Graphics/RenderTexture.hpp>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * Frame time of the map drawn offscreen into a sf::RenderTexture, as one
+ * mesh and as a shape per tile like before the tile layer. Needs an OpenGL
+ * context - without a GPU software GL works, e.g. Mesa's llvmpipe under
+ * xvfb-run.
+ *
+ * Every frame reads the texture back so the GPU work is in the time, the
+ * read back alone is reported too.
+ **/
+
+constexpr unsigned TEXTURE_SIZE = 1024;
+// Tiles drawn per measurement, whatever the map size
+constexpr size_t TILES = 2'000'000;
+
+// A square map of "side" tiles filling the texture, with every tile type
+static std::vector<Tile> makeMap(uint32_t side) {
+  std::mt19937 rng(side);
+  std::uniform_int_distribution<int> type(
+      0, static_cast<int>(TileType::Count) - 1);
+  const float tileSize = static_cast<float>(TEXTURE_SIZE) / side;
+
+  std::vector<Tile> tiles;
+  tiles.reserve(side * side);
+  for (uint32_t y = 0; y < side; ++y) {
+    for (uint32_t x = 0; x < side; ++x) {
+      tiles.emplace_back(x * tileSize, y * tileSize, tileSize,
+                         static_cast<TileType>(type(rng)));
+    }
+  }
+  return tiles;
+}
+
+static void benchMap(sf::RenderTexture &texture, uint32_t side) {
+  const std::vector<Tile> tiles = makeMap(side);
+  const size_t iterations = std::max<size_t>(1, TILES / tiles.size());
+  const int runs = iterations == 1 ? 3 : 7;
+  const std::string name = std::to_string(side) + "x" + std::to_string(side);
+
+  // Every tile used to keep its own shape
+  std::vector<sf::RectangleShape> shapes;
+  for (const Tile &tile : tiles) {
+    sf::RectangleShape &shape = shapes.emplace_back(tile.rect.getSize());
+    shape.setPosition(tile.rect.getPosition());
+    shape.setFillColor(Tile::getColor(tile.type));
+  }
+
+  TileLayer layer;
+  uint32_t revision = 0;
+  bench::report(name + " build", bench::nsPerOp(
+                                     [&] { layer.build(tiles, ++revision); },
+                                     iterations, runs));
+
+  auto frame = [&texture](auto &&drawMap) {
+    texture.clear();
+    drawMap();
+    texture.display();
+    const sf::Image image = texture.getTexture().copyToImage();
+    bench::doNotOptimize(image.getSize());
+  };
+
+  bench::report(name + " frame, tile layer",
+                bench::nsPerOp([&] { frame([&] { layer.draw(texture); }); },
+                               iterations, runs));
+  bench::report(name + " frame, shape per tile",
+                bench::nsPerOp(
+                    [&] {
+                      frame([&] {
+                        for (const sf::RectangleShape &shape : shapes)
+                          texture.draw(shape);
+                      });
+                    },
+                    iterations, runs));
+}
+
+int main() {
+  sf::RenderTexture texture;
+  if (!texture.resize({TEXTURE_SIZE, TEXTURE_SIZE})) {
+    std::fprintf(stderr, "Couldn't create the render texture\n");
+    return 1;
+  }
+
+  auto readBack = [&texture] {
+    texture.display();
+    const sf::Image image = texture.getTexture().copyToImage();
+    bench::doNotOptimize(image.getSize());
+  };
+  bench::report("read back only", bench::nsPerOp(readBack, 100));
+
+  // The game map is 32x32
+  for (uint32_t side : {32u, 128u, 512u, 1024u})
+    benchMap(texture, side);
+}
@@ -0,0 +1,43 @@
+#include "AllocationCounter.hpp"
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+// Per thread so counting doesn't need atomics and other threads don't show
+// up in the numbers of the game loop
+thread_local uint64_t t_allocations = 0;
+
+void *allocate(std::size_t size) {
+  ++t_allocations;
+  if (void *ptr = std::malloc(size == 0 ? 1 : size))
+    return ptr;
+  throw std::bad_alloc();
+}
+
+void *allocate(std::size_t size, std::align_val_t alignment) {
+  ++t_allocations;
+  const auto align = static_cast<std::size_t>(alignment);
+  // aligned_alloc wants the size to be a multiple of the alignment
+  const std::size_t rounded = (size + align - 1) / align * align;
+  if (void *ptr = std::aligned_alloc(align, rounded == 0 ? align : rounded))
+    return ptr;
+  throw std::bad_alloc();
+}
+
+} // namespace
+
+uint64_t getAllocationCount() { return t_allocations; }
+
+// The array and nothrow versions call these
+void *operator new(std::size_t size) { return allocate(size); }
+void *operator new(std::size_t size, std::align_val_t alignment) {
+  return allocate(size, alignment);
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept {
+  std::free(ptr);
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <cstdint>
+
+// Heap allocations (calls of operator new) made by the calling thread so far.
+// Counted by the replacement of the global operator new in
+// AllocationCounter.cpp, so it covers the standard containers as well
+uint64_t getAllocationCount();
@@ -8,9 +8,11 @@
 #include <SFML/Window/Mouse.hpp>
 #include <SFML/Window/WindowEnums.hpp>
 #include <csignal>
+#include <cstring>
 #include <iostream>
 
 #include "Application.hpp"
+#include "logging.hpp"
 #include "ui/ui.hpp"
 
 sf::Vector2i Application::s_mousePos = {-1, -1};
@@ -34,6 +36,15 @@ Application::Application(int argc, char *argv[]) : m_assetManager("./assets") {
   if (argc > 1 && argv[1][0] == 's') {
     title = "Server";
   } 
+
+  for (int i = 1; i + 1 < argc; ++i) {
+    if (std::strcmp(argv[i], "--tick-rate") != 0)
+      continue;
+    if (auto rate = FixedTimestep::parseTickRate(argv[i + 1]))
+      m_tickRate = *rate;
+    else
+      LOG_ERROR("Invalid tick rate ", argv[i + 1], ". Using ", m_tickRate);
+  }
   constexpr int WINDOW_WIDTH = 640;
   constexpr int WINDOW_HEIGHT = 640;
   constexpr int WINDOW_STYLE = sf::Style::Titlebar;
@@ -61,19 +72,21 @@ Application::Application(int argc, char *argv[]) : m_assetManager("./assets") {
   ui::g_UIContext.init(&m_window, &m_assetManager);
 }
 
-void Application::run(bool isServer) {
+void Application::run(bool isServer, network::SocketType transport) {
 
   sf::Clock deltaTimer;
+  FixedTimestep timestep(m_tickRate);
 
   const char *IP = "127.0.0.1";
   uint16_t port = 63921;
 
   if (isServer)
     m_sceneManager.pushScene(
-        new ConnectServerScene(IP, port, m_sceneManager, m_window));
+        new ConnectServerScene(IP, port, transport, m_tickRate, m_sceneManager,
+                               m_window));
   else
     m_sceneManager.pushScene(
-        new ConnectClientScene(IP, port, m_sceneManager, m_window));
+        new ConnectClientScene(IP, port, transport, m_sceneManager, m_window));
 
   while (m_window.isOpen()) {
     float dt = deltaTimer.restart().asSeconds();
@@ -84,8 +97,13 @@ void Application::run(bool isServer) {
     handleEvents();
 
     m_sceneManager.getCurrentScene()->update(dt);
+    // The scene is looked up every tick since a tick can change it
+    timestep.run(dt, [this](float tickDt) {
+      m_sceneManager.getCurrentScene()->fixedUpdate(tickDt);
+    });
+
     m_window.clear();
-    m_sceneManager.getCurrentScene()->draw();
+    m_sceneManager.getCurrentScene()->draw(timestep.getAlpha());
     m_window.display();
 
     ui::g_UIContext.endDraw();
@@ -1,5 +1,6 @@
 #pragma once
 #include "AssetManager.hpp"
+#include "FixedTimestep.hpp"
 #include "Scene.hpp"
 #include <SFML/Graphics/RenderWindow.hpp>
 #include <SFML/Window/Mouse.hpp>
@@ -11,7 +12,7 @@ public:
   ~Application() = default;
 
   void handleEvents();
-  void run(bool isServer);
+  void run(bool isServer, network::SocketType transport);
 
   // Returns the position of the mouse of the last click
   static sf::Vector2f getMousePosition();
@@ -20,6 +21,8 @@ public:
 
 private:
   SceneManager m_sceneManager;
+  // Simulation ticks per second (--tick-rate)
+  uint32_t m_tickRate = FixedTimestep::DEFAULT_TICK_RATE;
   sf::RenderWindow m_window;
   AssetManager m_assetManager;
 
@@ -0,0 +1,96 @@
+#include "DedicatedServer.hpp"
+#include "FixedTimestep.hpp"
+#include "ServerGame.hpp"
+#include "logging.hpp"
+#include <charconv>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <optional>
+#include <thread>
+
+namespace {
+
+volatile sig_atomic_t s_sigintReceived = 0;
+void onSigint(int) { s_sigintReceived = 1; }
+
+// Parses a whole argument as a number. Returns nullopt on garbage or overflow
+template <typename T> std::optional<T> parseNumber(const char *str) {
+  T value{};
+  const char *end = str + std::strlen(str);
+  auto [ptr, ec] = std::from_chars(str, end, value);
+  if (ec != std::errc() || ptr != end)
+    return std::nullopt;
+  return value;
+}
+
+} // namespace
+
+DedicatedServer::DedicatedServer(int argc, char *argv[]) {
+  for (int i = 1; i < argc; ++i) {
+    const bool hasValue = i + 1 < argc;
+
+    if (std::strcmp(argv[i], "udp") == 0) {
+      m_transport = network::SocketType::UDP;
+    } else if (std::strcmp(argv[i], "--ip") == 0 && hasValue) {
+      m_ip = argv[++i];
+    } else if (std::strcmp(argv[i], "--port") == 0 && hasValue) {
+      if (auto port = parseNumber<uint16_t>(argv[++i]))
+        m_port = *port;
+      else
+        LOG_ERROR("Invalid port ", argv[i], ". Using ", m_port);
+    } else if (std::strcmp(argv[i], "--tick-rate") == 0 && hasValue) {
+      if (auto rate = FixedTimestep::parseTickRate(argv[++i]))
+        m_tickRate = *rate;
+      else
+        LOG_ERROR("Invalid tick rate ", argv[i], ". Using ", m_tickRate);
+    } else {
+      LOG_ERROR("Unknown argument ", argv[i]);
+    }
+  }
+}
+
+int DedicatedServer::run() {
+  std::signal(SIGINT, onSigint);
+
+  auto server = std::make_shared<network::Server>();
+  if (!server->bind(m_ip, m_port, m_transport)) {
+    LOG_ERROR("Couldn't bind server ", m_ip, ":", m_port);
+    return 1;
+  }
+  LOG_INFO("Dedicated server listening on ", m_ip, ":", m_port,
+           (m_transport == network::SocketType::UDP ? " (UDP)" : " (TCP)"),
+           " at ", m_tickRate, " ticks/s");
+
+  using Clock = std::chrono::steady_clock;
+
+  ServerLobby lobby(server);
+  std::optional<ServerGame> game;
+  FixedTimestep timestep(m_tickRate);
+
+  auto lastFrame = Clock::now();
+  while (!s_sigintReceived) {
+    const auto now = Clock::now();
+    const float frameDt = std::chrono::duration<float>(now - lastFrame).count();
+    lastFrame = now;
+
+    timestep.run(frameDt, [&](float dt) {
+      if (game) {
+        if (!game->update(dt)) {
+          LOG_INFO("Game over. Back to the lobby");
+          game.reset();
+          lobby.resume();
+        }
+      } else if (lobby.update()) {
+        LOG_INFO("Players ready. Starting game");
+        game.emplace(server, m_tickRate);
+      }
+    });
+
+    std::this_thread::sleep_for(
+        std::chrono::duration<float>(timestep.getTimeToNextTick()));
+  }
+
+  LOG_INFO("SIGINT received - closing...");
+  return 0;
+}
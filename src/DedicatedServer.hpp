@@ -0,0 +1,28 @@
+#pragma once
+
+#include "FixedTimestep.hpp"
+#include "network/socket.hpp"
+#include <cstdint>
+
+// Server without a window. Binds on start and then runs the lobby and the
+// game at a fixed tick rate until SIGINT is received.
+//
+// Arguments:
+//   --ip <address>     address to bind (default 127.0.0.1)
+//   --port <port>      port to bind (default 63921)
+//   --tick-rate <hz>   simulation ticks per second (default 60)
+//   udp                use the UDP transport instead of TCP
+class DedicatedServer {
+public:
+  DedicatedServer(int argc, char *argv[]);
+  ~DedicatedServer() = default;
+
+  // Returns the exit code of the process
+  int run();
+
+private:
+  const char *m_ip = "127.0.0.1";
+  uint16_t m_port = 63921;
+  network::SocketType m_transport = network::SocketType::TCP;
+  uint32_t m_tickRate = FixedTimestep::DEFAULT_TICK_RATE;
+};
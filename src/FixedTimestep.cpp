@@ -0,0 +1,38 @@
+#include "FixedTimestep.hpp"
+#include "logging.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+FixedTimestep::FixedTimestep(uint32_t tickRate)
+    : m_tickRate(tickRate), m_tickDt(1.f / tickRate) {}
+
+void FixedTimestep::recordTick(double seconds, uint64_t allocations) {
+  ++m_stats.ticks;
+  m_stats.totalSeconds += seconds;
+  m_stats.maxSeconds = std::max(m_stats.maxSeconds, seconds);
+  m_stats.allocations += allocations;
+  m_stats.maxAllocations = std::max(m_stats.maxAllocations, allocations);
+
+  if (m_stats.ticks * m_tickDt >= STATS_INTERVAL)
+    logStats();
+}
+
+void FixedTimestep::logStats() {
+  const double avgMs = m_stats.totalSeconds * 1000.0 / m_stats.ticks;
+  LOG_INFO("Ticks: ", m_stats.ticks, " (", m_tickRate, "/s) avg ", avgMs,
+           " ms max ", m_stats.maxSeconds * 1000.0,
+           " ms dropped: ", m_stats.droppedTicks, " allocations/tick avg ",
+           m_stats.allocations * 1.0 / m_stats.ticks, " max ",
+           m_stats.maxAllocations);
+  m_stats = TickStats{};
+}
+
+std::optional<uint32_t> FixedTimestep::parseTickRate(const char *str) {
+  uint32_t rate = 0;
+  const char *end = str + std::strlen(str);
+  auto [ptr, ec] = std::from_chars(str, end, rate);
+  if (ec != std::errc() || ptr != end || rate == 0 || rate > MAX_TICK_RATE)
+    return std::nullopt;
+  return rate;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+#include "AllocationCounter.hpp"
+#include "FrameArena.hpp"
+
+// Time spent in the simulation ticks and their heap allocations, reset every
+// STATS_INTERVAL seconds
+struct TickStats {
+  uint64_t ticks = 0;
+  // Ticks thrown away by the spiral of death guard
+  uint64_t droppedTicks = 0;
+  // Wall clock time spent running the ticks
+  double totalSeconds = 0.0;
+  double maxSeconds = 0.0;
+  uint64_t allocations = 0;
+  uint64_t maxAllocations = 0;
+};
+
+/**
+ * Runs the simulation in whole ticks of 1/tickRate seconds, independently of
+ * the frame rate. Frame time is accumulated and as many ticks as fit are run.
+ * The remainder is kept for the next frame and can be used to interpolate
+ * the drawn state between the last two ticks.
+ *
+ * When the ticks can't keep up (each one takes longer than its dt) the
+ * accumulator would only grow. At most MAX_TICKS_PER_FRAME run in one frame
+ * and the rest of the time is dropped, so the simulation slows down instead
+ * of freezing the process.
+ *
+ * The frame arena of the thread is reset after every tick.
+ **/
+class FixedTimestep {
+public:
+  static constexpr uint32_t DEFAULT_TICK_RATE = 60;
+  static constexpr uint32_t MAX_TICK_RATE = 1000;
+  static constexpr uint32_t MAX_TICKS_PER_FRAME = 8;
+  static constexpr float STATS_INTERVAL = 10.f;
+
+  explicit FixedTimestep(uint32_t tickRate = DEFAULT_TICK_RATE);
+
+  // Adds the frame time and calls tick(dt) for every whole tick
+  template <typename F> void run(float frameDt, F &&tick);
+
+  float getTickDt() const { return m_tickDt; }
+  uint32_t getTickRate() const { return m_tickRate; }
+  // Fraction of a tick accumulated since the last one in [0, 1)
+  float getAlpha() const { return m_accumulator / m_tickDt; }
+  // Seconds until the next tick is due
+  float getTimeToNextTick() const { return m_tickDt - m_accumulator; }
+  const TickStats &getStats() const { return m_stats; }
+
+  // Parses a tick rate argument. Returns nullopt when it's not a number in
+  // [1, MAX_TICK_RATE]
+  static std::optional<uint32_t> parseTickRate(const char *str);
+
+private:
+  void recordTick(double seconds, uint64_t allocations);
+  void logStats();
+
+  uint32_t m_tickRate;
+  float m_tickDt;
+  float m_accumulator = 0.f;
+  TickStats m_stats;
+};
+
+template <typename F> void FixedTimestep::run(float frameDt, F &&tick) {
+  m_accumulator += frameDt;
+
+  uint32_t ticks = static_cast<uint32_t>(m_accumulator / m_tickDt);
+  m_accumulator -= ticks * m_tickDt;
+
+  if (ticks > MAX_TICKS_PER_FRAME) {
+    m_stats.droppedTicks += ticks - MAX_TICKS_PER_FRAME;
+    ticks = MAX_TICKS_PER_FRAME;
+  }
+
+  for (uint32_t i = 0; i < ticks; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    const uint64_t allocations = getAllocationCount();
+    tick(m_tickDt);
+    FrameArena::get().reset();
+    recordTick(std::chrono::duration<double>(
+                   std::chrono::steady_clock::now() - start)
+                   .count(),
+               getAllocationCount() - allocations);
+  }
+}
@@ -0,0 +1,54 @@
+#include "FrameArena.hpp"
+#include <bit>
+#include <new>
+
+FrameArena::FrameArena(size_t capacity)
+    : m_buffer(std::make_unique_for_overwrite<std::byte[]>(capacity)),
+      m_capacity(capacity) {}
+
+FrameArena::~FrameArena() { freeOverflow(); }
+
+void FrameArena::reset() {
+  // Sized for the whole tick so the next one like it stays in the buffer
+  const size_t used = getUsed();
+  freeOverflow();
+  if (used > m_capacity) {
+    m_capacity = std::bit_ceil(used);
+    m_buffer = std::make_unique_for_overwrite<std::byte[]>(m_capacity);
+  }
+  m_used = 0;
+}
+
+FrameArena &FrameArena::get() {
+  static thread_local FrameArena arena;
+  return arena;
+}
+
+void *FrameArena::do_allocate(size_t bytes, size_t alignment) {
+  void *ptr = m_buffer.get() + m_used;
+  size_t space = m_capacity - m_used;
+  if (std::align(alignment, bytes, ptr, space)) {
+    m_used = m_capacity - space + bytes;
+    return ptr;
+  }
+
+  // Doesn't fit. Lives on the heap until the next reset
+  size_t total = sizeof(Overflow) + alignment + bytes;
+  auto *block = static_cast<Overflow *>(::operator new(total));
+  block->next = m_overflow;
+  m_overflow = block;
+  m_overflowBytes += alignment + bytes;
+
+  ptr = block + 1;
+  total -= sizeof(Overflow);
+  return std::align(alignment, bytes, ptr, total);
+}
+
+void FrameArena::freeOverflow() {
+  while (m_overflow != nullptr) {
+    Overflow *next = m_overflow->next;
+    ::operator delete(m_overflow);
+    m_overflow = next;
+  }
+  m_overflowBytes = 0;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+/**
+ * Bump allocator for data that only lives during one simulation tick, like
+ * the snapshot deltas or the datagrams being put together. Allocating moves a
+ * pointer forward, deallocating does nothing and "reset" frees everything at
+ * once. FixedTimestep resets the arena of its thread after every tick.
+ *
+ * Used through std::pmr containers. When a tick needs more than the buffer
+ * has the rest comes from the heap, and the next reset grows the buffer to
+ * what the tick used. After the first few ticks it doesn't allocate at all.
+ *
+ * Memory from it must not outlive the tick - anything kept (queued messages,
+ * the snapshot history) stays on the heap.
+ **/
+class FrameArena : public std::pmr::memory_resource {
+public:
+  static constexpr size_t DEFAULT_CAPACITY = 64 * 1024;
+
+  explicit FrameArena(size_t capacity = DEFAULT_CAPACITY);
+  ~FrameArena() override;
+
+  FrameArena(const FrameArena &) = delete;
+  FrameArena &operator=(const FrameArena &) = delete;
+
+  // Frees everything allocated since the last reset
+  void reset();
+
+  size_t getCapacity() const { return m_capacity; }
+  // Bytes handed out since the last reset, the ones from the heap included
+  size_t getUsed() const { return m_used + m_overflowBytes; }
+
+  // Arena of the calling thread
+  static FrameArena &get();
+
+private:
+  // Block taken from the heap when the buffer ran out. The memory handed out
+  // follows the header
+  struct Overflow {
+    Overflow *next;
+  };
+
+  void *do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void *, size_t, size_t) override {}
+  bool do_is_equal(const memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+
+  void freeOverflow();
+
+  std::unique_ptr<std::byte[]> m_buffer;
+  size_t m_capacity;
+  size_t m_used = 0;
+
+  Overflow *m_overflow = nullptr;
+  size_t m_overflowBytes = 0;
+};
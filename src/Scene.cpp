@@ -6,6 +6,7 @@
 #include "logging.hpp"
 #include "network/packet.hpp"
 #include "ui/ui.hpp"
+#include <algorithm>
 #include <memory>
 #include <string>
 
@@ -40,8 +41,9 @@ Scene *SceneManager::getCurrentScene() const {
 }
 
 ConnectClientScene::ConnectClientScene(const char *ip, uint16_t port,
+                                       network::SocketType transport,
                                        SCENE_PARAMS)
-    : SCENE_CONSTRUCTOR, targetIP(ip), targetPort(port),
+    : SCENE_CONSTRUCTOR, targetIP(ip), targetPort(port), transport(transport),
       m_sceneManager(sceneManager), m_window(window),
       m_client(std::make_shared<network::Client>()) {}
 
@@ -52,8 +54,9 @@ void ConnectClientScene::resume() { m_isReady = false; }
 void ConnectClientScene::update(float dt) {
 
   if (m_isConnected) {
+    m_client->poll();
     while (auto msg = m_client->pollMessage()) {
-      auto packet = *msg;
+      auto &packet = *msg;
 
       if (auto *jlr = std::get_if<network::JoinLobbyResponse>(&packet)) {
 
@@ -72,7 +75,7 @@ void ConnectClientScene::update(float dt) {
     }
   }
 }
-void ConnectClientScene::draw() {
+void ConnectClientScene::draw(float alpha) {
   ui::Text(" ");
   ui::Text("Server Address:" + std::string(targetIP) + ":" +
            std::to_string(targetPort));
@@ -90,7 +93,7 @@ void ConnectClientScene::draw() {
   } else {
     if (ui::Button("Connect")) {
       LOG_INFO("Connecting to server ", targetIP, ":", targetPort);
-      if (m_client->connect(targetIP, targetPort)) {
+      if (m_client->connect(targetIP, targetPort, transport)) {
         LOG_INFO("Client connected");
         m_client->send(network::JoinLobbyRequest{});
         m_isConnected = true;
@@ -102,78 +105,45 @@ void ConnectClientScene::draw() {
 }
 
 ConnectServerScene::ConnectServerScene(const char *ip, uint16_t port,
-                                       SCENE_PARAMS)
-    : SCENE_CONSTRUCTOR, bindIP(ip), bindPort(port),
-      m_server(std::make_shared<network::Server>()) {
-
-  m_server->setOnDisconnectCallback([this](int32_t playerID) {
-    LOG_INFO("Player disconnected ", playerID, " disconnected from lobby");
-    m_lobbyMembers.erase(m_lobbyMembers.find(playerID));
-  });
-}
+                                       network::SocketType transport,
+                                       uint32_t tickRate, SCENE_PARAMS)
+    : SCENE_CONSTRUCTOR, bindIP(ip), bindPort(port), transport(transport),
+      tickRate(tickRate),
+      m_server(std::make_shared<network::Server>()), m_lobby(m_server) {}
 ConnectServerScene::~ConnectServerScene() {}
 
-void ConnectServerScene::resume() {
-  m_server->setOnDisconnectCallback([this](int32_t playerID) {
-    LOG_INFO("Player disconnected ", playerID, " disconnected from lobby");
-    m_lobbyMembers.erase(m_lobbyMembers.find(playerID));
-  });
-
-  for (auto [p, r] : m_lobbyMembers) {
-    m_lobbyMembers[p] = false;
-  }
-
-  m_server->sendAll(network::JoinLobbyResponse(m_lobbyMembers));
-}
+void ConnectServerScene::resume() { m_lobby.resume(); }
 void ConnectServerScene::update(float dt) {
 
   if (!m_isBound)
     return;
 
-  if (m_server->tryAcceptClient()) {
-    LOG_INFO("Client connected");
-  }
-
-  while (auto sockmsg = m_server->pollMessage()) {
-    auto [socket, msg] = *sockmsg;
-    if (auto *jlr = std::get_if<network::JoinLobbyRequest>(&msg)) {
-      LOG_INFO("Received JoinLobbyRequest");
-      m_lobbyMembers[socket->fd] = false;
-      m_server->sendAll(network::JoinLobbyResponse(m_lobbyMembers));
-    } else if (auto *lrr = std::get_if<network::LobbyReadyRequst>(&msg)) {
-      m_lobbyMembers[socket->fd] = lrr->isReady;
-      m_server->sendAll(network::LobbyReadyResponse{.playerID = socket->fd,
-                                                    .isReady = lrr->isReady});
-    } else {
-      LOG_ERROR("Unknown packet (variant index:", msg.index(), ")");
-    }
-  }
-
-  if (m_lobbyMembers.size() > 0 && allPlayersReady()) {
+  if (m_lobby.update()) {
     LOG_INFO("Players connected. Starting game");
-    auto gamescene = new ServerGameScene(m_server, m_sceneManager, m_window);
+    auto gamescene =
+        new ServerGameScene(m_server, tickRate, m_sceneManager, m_window);
     LOG_DEBUG("Game scene created");
     m_sceneManager.pushScene(gamescene);
   }
 }
-void ConnectServerScene::draw() {
+void ConnectServerScene::draw(float alpha) {
   ui::Text(" ");
   ui::Text("Server Address:" + std::string(bindIP) + ":" +
            std::to_string(bindPort));
 
   if (m_isBound) {
-    for (auto [id, isReady] : m_lobbyMembers) {
+    for (auto [id, isReady] : m_lobby.getMembers()) {
       ui::Text("Player: " + std::to_string(id) +
                std::string((isReady) ? " Ready " : " Not ready"));
     }
 
     ui::Text("Waiting for clients... (Connected: " +
-             std::to_string(m_lobbyMembers.size()) + ")");
+             std::to_string(m_lobby.getMembers().size()) + ")");
   } else {
     if (ui::Button("Bind")) {
       LOG_INFO("Binding server ", bindIP, ":", bindPort);
 
-      if (m_server->bind(bindIP, bindPort)) {
+      if (m_server->bind(bindIP, bindPort, transport)) {
         LOG_INFO("Server bind success");
         m_isBound = true;
       } else {
@@ -183,35 +153,32 @@ void ConnectServerScene::draw() {
   }
 }
 
-bool ConnectServerScene::allPlayersReady() const {
-  for (auto [p, ready] : m_lobbyMembers) {
-    if (!ready)
-      return false;
-  }
-  return true;
-}
-
 ClientGameScene::ClientGameScene(std::shared_ptr<network::Client> client,
                                  SCENE_PARAMS)
     : SCENE_CONSTRUCTOR, m_client(client), m_level() {
 
   LOG_INFO("Client game scene");
-  m_client->send(network::GameReadyRequest{});
+
+  std::vector<network::CachedMap> cachedMaps;
+  for (const Level::MapData &map : Level::getCachedMaps())
+    cachedMaps.push_back({.id = map.id, .hash = Level::hashMap(map)});
+
+  m_client->send(network::GameReadyRequest(std::move(cachedMaps)));
 }
 ClientGameScene::~ClientGameScene() {}
 
 void ClientGameScene::update(float dt) {
   if (Application::isKeyPressed(sf::Keyboard::Key::W)) {
-    m_client->send(network::PlayerMoveRequest{Direction::Up});
+    predictMove(Direction::Up);
   }
   if (Application::isKeyPressed(sf::Keyboard::Key::S)) {
-    m_client->send(network::PlayerMoveRequest{Direction::Down});
+    predictMove(Direction::Down);
   }
   if (Application::isKeyPressed(sf::Keyboard::Key::A)) {
-    m_client->send(network::PlayerMoveRequest{Direction::Left});
+    predictMove(Direction::Left);
   }
   if (Application::isKeyPressed(sf::Keyboard::Key::D)) {
-    m_client->send(network::PlayerMoveRequest{Direction::Right});
+    predictMove(Direction::Right);
   }
 
   if (Application::isMousePressed(sf::Mouse::Button::Left)) {
@@ -229,14 +196,26 @@ void ClientGameScene::update(float dt) {
   }
 
   m_playerSyncTimer += dt;
+  m_client->poll();
   while (auto msg = m_client->pollMessage()) {
     LOG_DEBUG("Received message from server");
-    auto packet = *msg;
+    auto &packet = *msg;
     LOG_DEBUG("Polled client packet2");
 
     if (auto *grr = std::get_if<network::GameReadyResponse>(&packet)) {
       LOG_DEBUG("Game ready response");
-      m_level = Level(grr->map, false);
+      if (grr->map)
+        Level::cacheMap(*grr->map);
+
+      const Level::MapData *map =
+          Level::findCachedMap(grr->mapID, grr->mapHash);
+      if (map == nullptr) {
+        LOG_ERROR("Server sent map ", (int)grr->mapID, " which isn't cached");
+        m_sceneManager.popScene();
+        return;
+      }
+
+      m_level = Level(*map, false);
       LOG_DEBUG("Level loaded");
 
       m_player = Player(grr->thisPlayerID);
@@ -245,6 +224,8 @@ void ClientGameScene::update(float dt) {
       m_otherPlayers[grr->otherID] = Player(grr->otherID);
       m_otherPlayers[grr->otherID].rect.setPosition(grr->otherPlayerPos);
 
+      m_serverClock.setInterval(grr->snapshotInterval);
+
       LOG_DEBUG("Players loaded");
 
       m_isInitialized = true;
@@ -252,26 +233,46 @@ void ClientGameScene::update(float dt) {
       LOG_DEBUG("Player Move response");
 
       if (fpsr->playerID == m_player.id) {
-        m_player.rect.setPosition(fpsr->newPos);
-
+        reconcile(fpsr->newPos, fpsr->lastSequence);
       } else {
         ASSERT(m_otherPlayers.contains(fpsr->playerID));
-        m_otherPlayers[fpsr->playerID].rect.setPosition(fpsr->newPos);
+        if (m_serverClock.isStarted())
+          m_otherPlayerTracks[fpsr->playerID].push(m_serverClock.getTick(),
+                                                   fpsr->newPos);
+        else
+          m_otherPlayers[fpsr->playerID].rect.setPosition(fpsr->newPos);
       }
     } else if (auto *eur = std::get_if<network::EnemyUpdateResponse>(&packet)) {
       LOG_DEBUG("Upadting enemies");
-      m_level.enemies.clear();
-      for (auto &enemyDTO : eur->enemies) {
-        Enemy e = Enemy(enemyDTO.pos, enemyDTO.destination);
-        e.healthBar.health = enemyDTO.health;
-        m_level.enemies.push_back(e);
+      const auto *baseline = m_enemySnapshots.find(eur->delta.baselineTick);
+
+      if (eur->delta.baselineTick != 0 && baseline == nullptr) {
+        // Waiting for the server to send a delta against a newer baseline
+        LOG_DEBUG("Missing enemy baseline ", eur->delta.baselineTick);
+      } else if (eur->delta.tick > m_snapshotAck.enemyTick) {
+        auto snapshot = network::applyDelta(baseline, eur->delta);
+
+        m_serverClock.onSnapshot(snapshot.tick);
+        m_enemyBuffer.push(snapshot.tick, snapshot);
+        m_enemySnapshots.push(std::move(snapshot));
+        m_snapshotAck.enemyTick = eur->delta.tick;
+        m_shouldAckSnapshots = true;
       }
     } else if (auto *ufr =
                    std::get_if<network::UpdateFireballsResponse>(&packet)) {
-
-      m_level.fireballs.clear();
-      for (const auto &fireball : ufr->fireballs) {
-        m_level.fireballs.push_back(Fireball(fireball.pos, fireball.direction));
+      const auto *baseline =
+          m_fireballSnapshots.find(ufr->delta.baselineTick);
+
+      if (ufr->delta.baselineTick != 0 && baseline == nullptr) {
+        LOG_DEBUG("Missing fireball baseline ", ufr->delta.baselineTick);
+      } else if (ufr->delta.tick > m_snapshotAck.fireballTick) {
+        auto snapshot = network::applyDelta(baseline, ufr->delta);
+
+        m_serverClock.onSnapshot(snapshot.tick);
+        m_fireballBuffer.push(snapshot.tick, snapshot);
+        m_fireballSnapshots.push(std::move(snapshot));
+        m_snapshotAck.fireballTick = ufr->delta.tick;
+        m_shouldAckSnapshots = true;
       }
     } else if (auto *bhr = std::get_if<network::BaseHitResponse>(&packet)) {
       m_level.base.healthbar.health = bhr->newHealth;
@@ -287,6 +288,7 @@ void ClientGameScene::update(float dt) {
     } else if (auto *pdr =
                    std::get_if<network::PlayerDisconnectedResponse>(&packet)) {
       m_otherPlayers.erase(m_otherPlayers.find(pdr->playerID));
+      m_otherPlayerTracks.erase(pdr->playerID);
 
     } else {
       LOG_DEBUG("Unknown packet with index: ", packet.index());
@@ -294,147 +296,121 @@ void ClientGameScene::update(float dt) {
     }
   }
 
-  m_player.update();
-  m_level.update(dt);
-}
-void ClientGameScene::draw() {
-  if (m_isInitialized) {
-    m_level.draw(m_window);
-    m_player.draw(m_window);
-
-    for (const auto &e : m_otherPlayers) {
-      e.second.draw(m_window);
-    }
-
-  } else {
-    ui::Text("Waiting for initialization...");
+  if (m_shouldAckSnapshots) {
+    m_client->send(m_snapshotAck);
+    m_shouldAckSnapshots = false;
   }
-}
-
-ServerGameScene::ServerGameScene(std::shared_ptr<network::Server> server,
-                                 SCENE_PARAMS)
-    : SCENE_CONSTRUCTOR, m_server(server), m_level(Level::Map1Data, true) {
-
-  LOG_INFO("Server game scene");
 
-  m_server->sendAll(network::StartGameResponse{});
-
-  for (const auto &client : m_server->getClients()) {
-    m_players[client.fd] = Player(client.fd);
-    m_players[client.fd].rect.setPosition(m_level.getPlayerStartPos());
-  }
-
-  m_server->setOnDisconnectCallback([this](int32_t playerID) {
-    LOG_INFO("Player disconnected ", playerID, " disconnected from lobby");
-    m_players.erase(m_players.find(playerID));
-    m_server->sendAll(
-        network::PlayerDisconnectedResponse{.playerID = playerID});
-  });
+  m_serverClock.advance(dt);
+  updateRemoteEntities();
 }
+void ClientGameScene::predictMove(Direction direction) {
+  if (!m_isInitialized)
+    return;
 
-ServerGameScene::~ServerGameScene() {}
-
-void ServerGameScene::update(float dt) {
-
-  while (auto sockmsg = m_server->pollMessage()) {
-    auto [socket, packet] = *sockmsg;
-
-    if (auto *grr = std::get_if<network::GameReadyRequest>(&packet)) {
-      LOG_INFO("Sending initalization packet");
-      const Player &p1 = m_players[socket->fd];
-
-      ASSERT(m_players.size() == 2);
-
-      std::array<Player, 2> plrs;
+  const network::PlayerMoveRequest input{.direction = direction,
+                                         .sequence = ++m_inputSequence};
+  m_level.movePlayer(m_player, direction);
+  m_pendingInputs.push_back(input);
+  m_client->send(input);
+}
 
-      int idx = 0;
+void ClientGameScene::reconcile(sf::Vector2f serverPos,
+                                uint32_t lastSequence) {
+  while (!m_pendingInputs.empty() &&
+         m_pendingInputs.front().sequence <= lastSequence)
+    m_pendingInputs.pop_front();
+
+  // The server position is authoritative. The inputs it hasn't seen yet are
+  // applied on top of it again
+  m_player.rect.setPosition(serverPos);
+  for (const auto &input : m_pendingInputs)
+    m_level.movePlayer(m_player, input.direction);
+}
 
-      Player p2;
-      for (auto &p : m_players) {
-        if (p.second.id == p1.id)
-          continue;
-        p2 = p.second;
-      }
+void ClientGameScene::updateRemoteEntities() {
+  if (!m_serverClock.isStarted())
+    return;
 
-      m_server->send(socket, network::GameReadyResponse{
-                                 .thisPlayerID = p1.id,
-                                 .thisPlayerPos = p1.rect.getPosition(),
-                                 .otherID = p2.id,
-                                 .otherPlayerPos = p2.rect.getPosition(),
-                                 .map = m_level.getMapData(),
-                             });
-      LOG_INFO("Initialization packet sent");
-    } else if (auto *pmr = std::get_if<network::PlayerMoveRequest>(&packet)) {
-
-      Player &p = m_players[socket->fd];
-
-      // if (m_level.canMove(p, toVec(pmr->direction))) {
-      p.rect.move(toVec(pmr->direction));
-      auto e = m_server->sendAll(network::PlayerMoveResponse{
-          .playerID = p.id, .newPos = p.rect.getPosition()});
-      //}
-    } else if (auto *fsr = std::get_if<network::FireballShotRequest>(&packet)) {
-      ASSERT(m_players.find(fsr->playerID) != m_players.end());
-      m_level.fireballs.push_back(
-          Fireball(fsr->fireball.pos, fsr->fireball.direction));
-      // m_server->sendAll(network::{
-      //     .pos = fsr->pos, .direction = fsr->direction});
-    } else {
-      LOG_ERROR("Unknown packet encountered with index:", packet.index());
-      ASSERT(false && "look debug msg before");
-    }
+  const float interval = m_serverClock.getInterval();
+  const double renderTick =
+      m_serverClock.getTick() - INTERPOLATION_DELAY / interval;
+  const double maxExtrapolation = MAX_EXTRAPOLATION / interval;
+
+  // Entities are matched by id so the ones still alive are updated in place.
+  // The sampled entities are sorted by id
+  if (auto enemies = m_enemyBuffer.sample(renderTick, maxExtrapolation)) {
+    m_level.enemies.removeIf([&](uint32_t i) {
+      return !std::ranges::binary_search(
+          enemies->entities, m_level.enemies.ids()[i], {}, &Enemy::DTO::id);
+    });
+
+    for (const auto &enemy : enemies->entities)
+      m_level.enemies.assign(enemy);
   }
 
-  m_level.update(dt);
+  if (auto fireballs = m_fireballBuffer.sample(renderTick, maxExtrapolation)) {
+    m_level.fireballs.removeIf([&](uint32_t i) {
+      return !std::ranges::binary_search(fireballs->entities,
+                                         m_level.fireballs.ids()[i], {},
+                                         &Fireball::DTO::id);
+    });
 
-  m_level.handleFireballHits();
-  if (m_level.handleBaseHits()) {
-    if (m_level.base.healthbar.health <= 0) {
-      m_server->sendAll(network::GameOverResponse{.isWon = false});
-      m_sceneManager.popScene();
-    } else
-      m_server->sendAll(
-          network::BaseHitResponse{.newHealth = m_level.base.healthbar.health});
+    for (const auto &fireball : fireballs->entities)
+      m_level.fireballs.assign(fireball);
   }
 
-  if (m_level.isLevelFinished()) {
-    m_server->sendAll(network::GameOverResponse{.isWon = true});
-    m_sceneManager.popScene();
-    return;
+  // Players move in single steps so they are never extrapolated - it would
+  // overshoot when they stop
+  for (const auto &[id, track] : m_otherPlayerTracks) {
+    auto player = m_otherPlayers.find(id);
+    auto pos = track.sample(renderTick, 0.0);
+    if (player != m_otherPlayers.end() && pos)
+      player->second.rect.setPosition(*pos);
   }
+}
 
-  // Sending updated enemies to the clients
+void ClientGameScene::fixedUpdate(float dt) {
+  if (!m_isInitialized)
+    return;
 
-  m_fullSyncTimer += dt;
-  if (m_fullSyncTimer > 0.06f) {
-    m_fullSyncTimer = 0;
-    std::vector<Enemy::DTO> enemyDTOs;
-    enemyDTOs.reserve(m_level.enemies.size());
+  // Remote entities only move with the snapshots of the server
+  m_player.update();
+}
+void ClientGameScene::draw(float alpha) {
+  if (m_isInitialized) {
+    m_level.draw(m_window, m_batch, alpha);
+    m_player.draw(m_batch);
 
-    for (const auto &enemy : m_level.enemies) {
-      enemyDTOs.push_back(Enemy::DTO{.pos = enemy.rect.getPosition(),
-                                     .destination = enemy.destination,
-                                     .health = enemy.healthBar.health});
+    for (const auto &e : m_otherPlayers) {
+      e.second.draw(m_batch);
     }
+    m_batch.flush(m_window);
 
-    m_server->sendAll(network::EnemyUpdateResponse(enemyDTOs));
+  } else {
+    ui::Text("Waiting for initialization...");
+  }
+}
 
-    std::vector<Fireball::DTO> fireballDTOs;
-    fireballDTOs.reserve(m_level.fireballs.size());
+ServerGameScene::ServerGameScene(std::shared_ptr<network::Server> server,
+                                 uint32_t tickRate, SCENE_PARAMS)
+    : SCENE_CONSTRUCTOR, m_game(server, tickRate) {
 
-    for (const auto &fireball : m_level.fireballs) {
-      fireballDTOs.push_back(Fireball::DTO{
-          .pos = fireball.rect.getPosition(),
-          .direction = fireball.direction,
-      });
-    }
+  LOG_INFO("Server game scene");
+}
 
-    m_server->sendAll(network::UpdateFireballsResponse(fireballDTOs));
-  }
+ServerGameScene::~ServerGameScene() {}
+
+void ServerGameScene::update(float dt) {}
+void ServerGameScene::fixedUpdate(float dt) {
+  if (!m_game.update(dt))
+    m_sceneManager.popScene();
 }
-void ServerGameScene::draw() {
-  m_level.draw(m_window);
-  for (const auto &p : m_players) {
-    p.second.draw(m_window);
+
+void ServerGameScene::draw(float alpha) {
+  m_game.getLevel().draw(m_window, m_batch, alpha);
+  for (const Player &p : m_game.getPlayers()) {
+    p.draw(m_batch);
   }
+  m_batch.flush(m_window);
 }
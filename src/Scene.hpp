@@ -1,8 +1,12 @@
 #pragma once
 
+#include "ServerGame.hpp"
 #include "game/Player.hpp"
+#include "game/SpriteBatch.hpp"
 #include "network/client.hpp"
+#include "network/interpolation.hpp"
 #include "network/server.hpp"
+#include <deque>
 #include <memory>
 #include <stack>
 #include <unordered_map>
@@ -18,9 +22,13 @@ struct Scene {
   Scene(SCENE_PARAMS);
   virtual ~Scene() = default;
 
+  // Called once per frame with the frame time (input, network, UI)
   virtual void update(float dt) = 0;
+  // Called for every simulation tick with the fixed tick time
+  virtual void fixedUpdate(float dt) {};
   virtual void resume() {};
-  virtual void draw() = 0;
+  // alpha in [0, 1) is the part of a tick passed since the last one
+  virtual void draw(float alpha) = 0;
 
 protected:
   SceneManager &m_sceneManager;
@@ -46,15 +54,17 @@ private:
 class ConnectClientScene : public Scene {
 
 public:
-  ConnectClientScene(const char *ip, uint16_t port, SCENE_PARAMS);
+  ConnectClientScene(const char *ip, uint16_t port,
+                     network::SocketType transport, SCENE_PARAMS);
   ~ConnectClientScene();
 
   void update(float dt) override;
   void resume() override;
-  void draw() override;
+  void draw(float alpha) override;
 
   const char *targetIP;
   const uint16_t targetPort;
+  const network::SocketType transport;
 
 private:
   std::shared_ptr<network::Client> m_client;
@@ -70,25 +80,24 @@ private:
 class ConnectServerScene : public Scene {
 
 public:
-  ConnectServerScene(const char *ip, uint16_t port, SCENE_PARAMS);
+  ConnectServerScene(const char *ip, uint16_t port,
+                     network::SocketType transport, uint32_t tickRate,
+                     SCENE_PARAMS);
   ~ConnectServerScene();
 
   void update(float dt) override;
   void resume() override;
-  void draw() override;
-
-  bool allPlayersReady() const;
+  void draw(float alpha) override;
 
   const char *bindIP;
   const uint16_t bindPort;
+  const network::SocketType transport;
+  const uint32_t tickRate;
 
 private:
   std::shared_ptr<network::Server> m_server;
+  ServerLobby m_lobby;
   bool m_isBound = false;
-
-  std::unordered_map<int32_t, bool> m_lobbyMembers;
-
-private:
 };
 
 class ClientGameScene : public Scene {
@@ -97,33 +106,67 @@ public:
   ~ClientGameScene();
 
   void update(float dt) override;
-  void draw() override;
+  void fixedUpdate(float dt) override;
+  void draw(float alpha) override;
 
 private:
+  // Moves the player locally and sends the move to the server
+  void predictMove(Direction direction);
+  // Resets the player to the position sent by the server and replays the
+  // moves it hasn't processed yet
+  void reconcile(sf::Vector2f serverPos, uint32_t lastSequence);
+  // Places the enemies, fireballs and other players where they were
+  // INTERPOLATION_DELAY ago according to the received snapshots
+  void updateRemoteEntities();
+
+  // Remote entities are drawn this many seconds behind the newest snapshot
+  // so there is usually a newer one to interpolate towards
+  static constexpr float INTERPOLATION_DELAY = 0.12f;
+  // Longest time a late snapshot is covered by extrapolation
+  static constexpr float MAX_EXTRAPOLATION = 0.25f;
+
   std::shared_ptr<network::Client> m_client;
   Level m_level;
   Player m_player;
-  std::unordered_map<uint8_t, Player> m_otherPlayers;
+  std::unordered_map<EntityID, Player> m_otherPlayers;
 
   bool m_isInitialized = false;
 
+  // Moves sent to the server but not yet confirmed by a PlayerMoveResponse
+  std::deque<network::PlayerMoveRequest> m_pendingInputs;
+  uint32_t m_inputSequence = 0;
+
+  // Applied snapshots kept as baselines for the next deltas
+  network::SnapshotHistory<Enemy::DTO> m_enemySnapshots;
+  network::SnapshotHistory<Fireball::DTO> m_fireballSnapshots;
+  network::SnapshotAckRequest m_snapshotAck{};
+  bool m_shouldAckSnapshots = false;
+
+  network::SnapshotClock m_serverClock;
+  network::InterpolationBuffer<network::Snapshot<Enemy::DTO>> m_enemyBuffer;
+  network::InterpolationBuffer<network::Snapshot<Fireball::DTO>>
+      m_fireballBuffer;
+  std::unordered_map<EntityID, network::InterpolationBuffer<sf::Vector2f>>
+      m_otherPlayerTracks;
+
   float m_playerSyncTimer = 0.f;
   float FULL_SYNC_THRESHOLD = 1.f;
+
+  // Entities of the frame, drawn over the map with one call
+  SpriteBatch m_batch;
 };
 
 class ServerGameScene : public Scene {
 public:
-  ServerGameScene(std::shared_ptr<network::Server> server, SCENE_PARAMS);
+  ServerGameScene(std::shared_ptr<network::Server> server, uint32_t tickRate,
+                  SCENE_PARAMS);
   ~ServerGameScene();
 
   void update(float dt) override;
-  void draw() override;
+  void fixedUpdate(float dt) override;
+  void draw(float alpha) override;
 
 private:
-  std::shared_ptr<network::Server> m_server;
-  Level m_level;
-
-  std::unordered_map<int32_t, Player> m_players;
-
-  float m_fullSyncTimer = 0.f;
+  ServerGame m_game;
+  SpriteBatch m_batch;
 };
@@ -0,0 +1,277 @@
+#include "ServerGame.hpp"
+#include "FrameArena.hpp"
+#include "debug.hpp"
+#include "logging.hpp"
+#include "network/packet.hpp"
+#include <algorithm>
+#include <cmath>
+
+ServerLobby::ServerLobby(std::shared_ptr<network::Server> server)
+    : m_server(server) {
+  setOnDisconnect();
+}
+
+void ServerLobby::setOnDisconnect() {
+  m_server->setOnDisconnectCallback([this](int32_t playerID) {
+    LOG_INFO("Player disconnected ", playerID, " disconnected from lobby");
+    m_lobbyMembers.erase(playerID);
+  });
+}
+
+void ServerLobby::resume() {
+  setOnDisconnect();
+
+  for (auto [p, r] : m_lobbyMembers) {
+    m_lobbyMembers[p] = false;
+  }
+
+  m_server->sendAll(network::JoinLobbyResponse(m_lobbyMembers));
+}
+
+bool ServerLobby::update() {
+
+  m_server->poll();
+
+  while (auto sockmsg = m_server->pollMessage()) {
+    auto &[socket, msg] = *sockmsg;
+    if (auto *jlr = std::get_if<network::JoinLobbyRequest>(&msg)) {
+      LOG_INFO("Received JoinLobbyRequest");
+      m_lobbyMembers[socket->fd] = false;
+      m_server->sendAll(network::JoinLobbyResponse(m_lobbyMembers));
+    } else if (auto *lrr = std::get_if<network::LobbyReadyRequst>(&msg)) {
+      m_lobbyMembers[socket->fd] = lrr->isReady;
+      m_server->sendAll(network::LobbyReadyResponse{.playerID = socket->fd,
+                                                    .isReady = lrr->isReady});
+    } else {
+      LOG_ERROR("Unknown packet (variant index:", msg.index(), ")");
+    }
+  }
+
+  m_server->flush();
+
+  return m_lobbyMembers.size() > 0 && allPlayersReady();
+}
+
+bool ServerLobby::allPlayersReady() const {
+  for (auto [p, ready] : m_lobbyMembers) {
+    if (!ready)
+      return false;
+  }
+  return true;
+}
+
+const std::unordered_map<int32_t, bool> &ServerLobby::getMembers() const {
+  return m_lobbyMembers;
+}
+
+ServerGame::ServerGame(std::shared_ptr<network::Server> server,
+                       uint32_t tickRate)
+    : m_server(server), m_level(Level::Map1Data, true),
+      m_ticksPerSnapshot(std::max<uint32_t>(
+          1, static_cast<uint32_t>(std::ceil(SNAPSHOT_INTERVAL * tickRate)))),
+      m_snapshotInterval(static_cast<float>(m_ticksPerSnapshot) / tickRate) {
+
+  m_server->sendAll(network::StartGameResponse{});
+
+  for (const auto &client : m_server->getClients()) {
+    Player &player = m_players.insert(Player());
+    player.rect.setPosition(m_level.getPlayerStartPos());
+    m_playerIDs[client.fd] = player.id;
+  }
+
+  m_server->setOnDisconnectCallback([this](int32_t fd) {
+    LOG_INFO("Player disconnected ", fd, " disconnected from lobby");
+    m_snapshotAcks.erase(fd);
+
+    auto it = m_playerIDs.find(fd);
+    if (it == m_playerIDs.end())
+      return;
+    const EntityID playerID = it->second;
+    m_players.remove(playerID);
+    m_playerIDs.erase(it);
+    m_server->sendAll(
+        network::PlayerDisconnectedResponse{.playerID = playerID});
+  });
+}
+
+ServerGame::~ServerGame() {
+  LOG_INFO("Snapshot bytes sent: ", m_snapshotBytesSent,
+           " saved by delta compression: ", m_snapshotBytesSaved);
+}
+
+const Level &ServerGame::getLevel() const { return m_level; }
+
+const SlotMap<Player> &ServerGame::getPlayers() const { return m_players; }
+
+Player *ServerGame::findPlayer(int32_t fd) {
+  auto it = m_playerIDs.find(fd);
+  return it == m_playerIDs.end() ? nullptr : m_players.find(it->second);
+}
+
+bool ServerGame::update(float dt) {
+
+  m_server->poll();
+  handlePackets();
+
+  m_level.update(dt);
+
+  m_level.handleFireballHits();
+  if (m_level.handleBaseHits()) {
+    if (m_level.base.healthbar.health <= 0) {
+      m_server->sendAll(network::GameOverResponse{.isWon = false});
+      m_server->flush();
+      return false;
+    } else
+      m_server->sendAll(
+          network::BaseHitResponse{.newHealth = m_level.base.healthbar.health});
+  }
+
+  if (m_level.isLevelFinished()) {
+    m_server->sendAll(network::GameOverResponse{.isWon = true});
+    m_server->flush();
+    return false;
+  }
+
+  // Sending updated enemies to the clients
+
+  if (++m_ticksSinceSnapshot >= m_ticksPerSnapshot) {
+    m_ticksSinceSnapshot = 0;
+    ++m_snapshotTick;
+
+    // Written over the oldest snapshots of the history, reusing their memory
+    auto &enemies = m_enemySnapshots.emplace(m_snapshotTick);
+    for (uint32_t i = 0; i < m_level.enemies.size(); ++i)
+      enemies.entities.push_back(m_level.enemies.toDTO(i));
+
+    auto &fireballs = m_fireballSnapshots.emplace(m_snapshotTick);
+    for (uint32_t i = 0; i < m_level.fireballs.size(); ++i)
+      fireballs.entities.push_back(m_level.fireballs.toDTO(i));
+
+    // Snapshots are diffed by id. The registry iterates in storage order
+    std::ranges::sort(enemies.entities, {}, &Enemy::DTO::id);
+    std::ranges::sort(fireballs.entities, {}, &Fireball::DTO::id);
+
+    sendSnapshots();
+  }
+
+  m_server->flush();
+  return true;
+}
+
+void ServerGame::handlePackets() {
+  while (auto sockmsg = m_server->pollMessage()) {
+    auto &[socket, packet] = *sockmsg;
+
+    if (auto *grr = std::get_if<network::GameReadyRequest>(&packet)) {
+      LOG_INFO("Sending initalization packet");
+      const Player *p1 = findPlayer(socket->fd);
+      if (p1 == nullptr) {
+        LOG_ERROR("GameReadyRequest from a client without a player");
+        continue;
+      }
+
+      ASSERT(m_players.size() == 2);
+
+      Player p2;
+      for (const Player &p : m_players) {
+        if (p.id == p1->id)
+          continue;
+        p2 = p;
+      }
+
+      const Level::MapData &map = m_level.getMapData();
+
+      network::GameReadyResponse response;
+      response.thisPlayerID = p1->id;
+      response.thisPlayerPos = p1->rect.getPosition();
+      response.otherID = p2.id;
+      response.otherPlayerPos = p2.rect.getPosition();
+      response.snapshotInterval = m_snapshotInterval;
+      response.mapID = map.id;
+      response.mapHash = Level::hashMap(map);
+
+      // Tiles are only sent to clients that don't have the map yet
+      const bool isCached = std::ranges::any_of(
+          grr->cachedMaps, [&](const network::CachedMap &cached) {
+            return cached.id == response.mapID &&
+                   cached.hash == response.mapHash;
+          });
+      if (!isCached) {
+        response.map = network::MapBufferPool::acquire();
+        *response.map = map;
+      }
+
+      m_server->send(socket, std::move(response));
+      LOG_INFO("Initialization packet sent");
+    } else if (auto *pmr = std::get_if<network::PlayerMoveRequest>(&packet)) {
+
+      Player *p = findPlayer(socket->fd);
+      if (p == nullptr)
+        continue;
+
+      // Answered even when the move is blocked so the client can drop the
+      // input it predicted
+      m_level.movePlayer(*p, pmr->direction);
+      m_server->sendAll(network::PlayerMoveResponse(
+          p->id, p->rect.getPosition(), pmr->sequence));
+    } else if (auto *sar = std::get_if<network::SnapshotAckRequest>(&packet)) {
+      // Only snapshots still in the history can be used as a baseline
+      auto &ack = m_snapshotAcks[socket->fd];
+      if (sar->enemyTick > ack.enemyTick &&
+          m_enemySnapshots.find(sar->enemyTick))
+        ack.enemyTick = sar->enemyTick;
+      if (sar->fireballTick > ack.fireballTick &&
+          m_fireballSnapshots.find(sar->fireballTick))
+        ack.fireballTick = sar->fireballTick;
+    } else if (auto *fsr = std::get_if<network::FireballShotRequest>(&packet)) {
+      ASSERT(m_players.contains(fsr->playerID));
+      m_level.spawnFireball(fsr->fireball.pos, fsr->fireball.direction);
+      // m_server->sendAll(network::{
+      //     .pos = fsr->pos, .direction = fsr->direction});
+    } else {
+      LOG_ERROR("Unknown packet encountered with index:", packet.index());
+      ASSERT(false && "look debug msg before");
+    }
+  }
+}
+
+void ServerGame::sendSnapshots() {
+  const auto &enemies = *m_enemySnapshots.find(m_snapshotTick);
+  const auto &fireballs = *m_fireballSnapshots.find(m_snapshotTick);
+
+  constexpr auto enemyEncoding =
+      network::encodingOf<network::EnemyUpdateResponse>();
+  constexpr auto fireballEncoding =
+      network::encodingOf<network::UpdateFireballsResponse>();
+
+  const size_t fullSize =
+      network::fullSnapshotSize(enemies, enemyEncoding) +
+      network::fullSnapshotSize(fireballs, fireballEncoding);
+
+  // Every client gets the changes since the last snapshot it acknowledged.
+  // A client without a usable baseline gets everything
+  for (const auto &[fd, playerID] : m_playerIDs) {
+    network::Socket *client = m_server->findClient(fd);
+    if (client == nullptr)
+      continue;
+
+    // The deltas are gone once encoded, they live in the frame arena
+    const auto &ack = m_snapshotAcks[fd];
+    network::EnemyUpdateResponse enemyUpdate(
+        network::makeDelta(m_enemySnapshots.find(ack.enemyTick), enemies,
+                           &FrameArena::get()));
+    network::UpdateFireballsResponse fireballUpdate(
+        network::makeDelta(m_fireballSnapshots.find(ack.fireballTick),
+                           fireballs, &FrameArena::get()));
+
+    const size_t size = enemyUpdate.delta.serializedSize(enemyEncoding) +
+                        fireballUpdate.delta.serializedSize(fireballEncoding);
+    m_snapshotBytesSent += size;
+    if (size < fullSize)
+      m_snapshotBytesSaved += fullSize - size;
+
+    // Moved so the packets keep the arena memory instead of copying it
+    m_server->send(client, std::move(enemyUpdate));
+    m_server->send(client, std::move(fireballUpdate));
+  }
+}
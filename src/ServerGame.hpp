@@ -0,0 +1,78 @@
+#pragma once
+
+#include "game/Level.hpp"
+#include "game/Player.hpp"
+#include "network/server.hpp"
+#include "network/snapshot.hpp"
+#include <memory>
+#include <unordered_map>
+
+// Server side logic without any rendering. Shared by the server scenes of the
+// application and by the dedicated (headless) server
+
+class ServerLobby {
+public:
+  explicit ServerLobby(std::shared_ptr<network::Server> server);
+  ~ServerLobby() = default;
+
+  // Called when the lobby is shown again after a game. Every member has to
+  // ready up again
+  void resume();
+
+  // Handles the lobby packets. Returns true once every member is ready
+  bool update();
+
+  bool allPlayersReady() const;
+  const std::unordered_map<int32_t, bool> &getMembers() const;
+
+private:
+  void setOnDisconnect();
+
+  std::shared_ptr<network::Server> m_server;
+  std::unordered_map<int32_t, bool> m_lobbyMembers;
+};
+
+class ServerGame {
+public:
+  ServerGame(std::shared_ptr<network::Server> server, uint32_t tickRate);
+  ~ServerGame();
+
+  // Runs one simulation tick of dt seconds. Returns false when the game is
+  // over
+  bool update(float dt);
+
+  // Minimum time between the snapshots sent to the clients. The real
+  // interval is a whole number of ticks
+  static constexpr float SNAPSHOT_INTERVAL = 0.06f;
+
+  const Level &getLevel() const;
+  const SlotMap<Player> &getPlayers() const;
+
+private:
+  void handlePackets();
+  // Player of the client with the socket. nullptr when it has none
+  Player *findPlayer(int32_t fd);
+  // Sends the snapshots of the current tick to the clients
+  void sendSnapshots();
+
+  std::shared_ptr<network::Server> m_server;
+  Level m_level;
+
+  SlotMap<Player> m_players;
+  // Player of every client by socket descriptor
+  std::unordered_map<int32_t, EntityID> m_playerIDs;
+
+  // Counted in ticks so the snapshot rate doesn't depend on the frame time
+  uint32_t m_ticksPerSnapshot;
+  uint32_t m_ticksSinceSnapshot = 0;
+  float m_snapshotInterval;
+
+  network::SnapshotTick m_snapshotTick = 0;
+  network::SnapshotHistory<Enemy::DTO> m_enemySnapshots;
+  network::SnapshotHistory<Fireball::DTO> m_fireballSnapshots;
+  // Newest snapshots acknowledged by each client
+  std::unordered_map<int32_t, network::SnapshotAckRequest> m_snapshotAcks;
+  // Bytes not sent thanks to delta compression (vs. full snapshots)
+  uint64_t m_snapshotBytesSaved = 0;
+  uint64_t m_snapshotBytesSent = 0;
+};
@@ -1,9 +1,12 @@
 #pragma once
 
 #ifdef DEBUG_BUILD
+#include "logging.hpp"
 #include <iostream>
 
 inline void __assertFail(const char *file, int line, const char *expression) {
+  // So the messages before it are printed first
+  logging::flush();
   std::cout << "ASSERTION FAILED\n"
             << file << ":" << line << " Expression: " << expression << '\n';
   exit(-1);
@@ -1,23 +1,18 @@
 #include "Base.hpp"
 #include "../logging.hpp"
 #include "Level.hpp"
-#include <SFML/Window/Mouse.hpp>
 
 Base::Base(sf::Vector2f pos) : healthbar(this->rect.getGlobalBounds(), 100) {
   this->rect.setPosition(pos);
   this->rect.setSize({Level::TILE_SIZE, Level::TILE_SIZE});
-  this->rect.setFillColor(sf::Color::Blue);
 
   this->healthbar.update(this->rect.getGlobalBounds());
 
   m_dmgCooldown = 0.f;
 }
 
-void Base::update(float dt) {
-  m_dmgCooldown -= dt;
-
-  this->healthbar.update(this->rect.getGlobalBounds());
-}
+// The base doesn't move, the bar is placed with it in loadLevel
+void Base::update(float dt) { m_dmgCooldown -= dt; }
 
 void Base::damage() {
 
@@ -28,8 +23,3 @@ void Base::damage() {
     LOG_INFO("Dealing damage to base");
   }
 }
-
-void Base::draw(sf::RenderWindow &window) const {
-  window.draw(this->rect);
-  this->healthbar.draw(window);
-}
@@ -1,7 +1,8 @@
 #pragma once
+#include "Body.hpp"
 #include "HealthBar.hpp"
-#include <SFML/Graphics/RectangleShape.hpp>
-#include <SFML/Graphics/RenderWindow.hpp>
+
+class SpriteBatch;
 
 struct Base {
 
@@ -10,10 +11,10 @@ struct Base {
   ~Base() = default;
 
   void update(float dt);
-  void draw(sf::RenderWindow &window) const;
+  void draw(SpriteBatch &batch) const;
   void damage();
 
-  sf::RectangleShape rect;
+  RectBody rect;
   HealthBar healthbar;
 
 private:
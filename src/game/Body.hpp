@@ -0,0 +1,28 @@
+#pragma once
+
+#include <SFML/Graphics/Rect.hpp>
+#include <SFML/System/Vector2.hpp>
+
+// Geometry of the players, tiles and the base (enemies and fireballs are in
+// EntityArrays). Only what the simulation needs - the shapes are built from
+// it when drawing, so the dedicated server doesn't depend on SFML::Graphics.
+// Mirrors the sf::Shape functions the game used
+
+struct Body {
+  sf::Vector2f getPosition() const { return m_position; }
+  void setPosition(sf::Vector2f position) { m_position = position; }
+  void move(sf::Vector2f offset) { m_position += offset; }
+
+protected:
+  sf::Vector2f m_position;
+};
+
+struct RectBody : Body {
+  sf::Vector2f getSize() const { return m_size; }
+  void setSize(sf::Vector2f size) { m_size = size; }
+
+  sf::FloatRect getGlobalBounds() const { return {m_position, m_size}; }
+
+private:
+  sf::Vector2f m_size;
+};
@@ -0,0 +1,131 @@
+#include "CollisionMap.hpp"
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+// std::floor and std::ceil are library calls without SSE4.1
+int32_t floorToInt(float value) {
+  const int32_t i = static_cast<int32_t>(value);
+  return i > value ? i - 1 : i;
+}
+int32_t ceilToInt(float value) {
+  const int32_t i = static_cast<int32_t>(value);
+  return i < value ? i + 1 : i;
+}
+
+/**
+ * Sweep along one axis. "start" and "size" are the box on that axis and
+ * isLineBlocked(i) tells if the row or column i is blocked where the box
+ * spans it. Walks the lines the leading edge crosses, nearest first
+ **/
+template <typename F>
+float sweepAxis(float start, float size, float delta, float tileSize,
+                F &&isLineBlocked) {
+  if (delta > 0.f) {
+    const float edge = start + size;
+    for (int32_t i = ceilToInt(edge / tileSize); i * tileSize < edge + delta;
+         ++i) {
+      if (isLineBlocked(i))
+        return i * tileSize - edge;
+    }
+  } else if (delta < 0.f) {
+    const float edge = start;
+    for (int32_t i = floorToInt(edge / tileSize) - 1;
+         (i + 1) * tileSize > edge + delta; --i) {
+      if (isLineBlocked(i))
+        return (i + 1) * tileSize - edge;
+    }
+  }
+  return delta;
+}
+
+// Tiles spanned by [start, start + size). A box ending on the edge of a
+// tile doesn't overlap it
+std::pair<int32_t, int32_t> tileSpan(float start, float size,
+                                     float tileSize) {
+  return {floorToInt(start / tileSize),
+          ceilToInt((start + size) / tileSize) - 1};
+}
+
+} // namespace
+
+CollisionMap::CollisionMap(uint32_t width, uint32_t height, float tileSize)
+    : m_width(width), m_height(height), m_wordsPerRow((width + 63) / 64),
+      m_tileSize(tileSize), m_bits(m_wordsPerRow * height, 0) {}
+
+void CollisionMap::build(const std::vector<uint8_t> &blocked) {
+  std::fill(m_bits.begin(), m_bits.end(), 0);
+  for (uint32_t y = 0; y < m_height; ++y) {
+    for (uint32_t x = 0; x < m_width; ++x) {
+      if (blocked[y * m_width + x])
+        m_bits[y * m_wordsPerRow + x / 64] |= uint64_t(1) << (x % 64);
+    }
+  }
+}
+
+bool CollisionMap::isBlocked(int32_t x, int32_t y) const {
+  return isRowBlocked(y, x, x);
+}
+
+bool CollisionMap::isRowBlocked(int32_t y, int32_t minX, int32_t maxX) const {
+  if (minX > maxX)
+    return false;
+  if (y < 0 || y >= static_cast<int32_t>(m_height) || minX < 0 ||
+      maxX >= static_cast<int32_t>(m_width))
+    return true;
+
+  // Whole words at once
+  const uint64_t *row = &m_bits[y * m_wordsPerRow];
+  for (int32_t word = minX / 64; word <= maxX / 64; ++word) {
+    const int32_t low = std::max(minX, word * 64) - word * 64;
+    const int32_t high = std::min(maxX, word * 64 + 63) - word * 64;
+    const uint64_t mask = (~uint64_t(0) >> (63 - (high - low))) << low;
+    if (row[word] & mask)
+      return true;
+  }
+  return false;
+}
+
+bool CollisionMap::isColumnBlocked(int32_t x, int32_t minY,
+                                   int32_t maxY) const {
+  for (int32_t y = minY; y <= maxY; ++y) {
+    if (isRowBlocked(y, x, x))
+      return true;
+  }
+  return false;
+}
+
+bool CollisionMap::overlaps(sf::FloatRect box) const {
+  const auto [minX, maxX] = tileSpan(box.position.x, box.size.x, m_tileSize);
+  const auto [minY, maxY] = tileSpan(box.position.y, box.size.y, m_tileSize);
+  for (int32_t y = minY; y <= maxY; ++y) {
+    if (isRowBlocked(y, minX, maxX))
+      return true;
+  }
+  return false;
+}
+
+float CollisionMap::sweepX(sf::FloatRect box, float dx) const {
+  const auto [minY, maxY] = tileSpan(box.position.y, box.size.y, m_tileSize);
+  return sweepAxis(box.position.x, box.size.x, dx, m_tileSize,
+                   [&](int32_t x) { return isColumnBlocked(x, minY, maxY); });
+}
+
+float CollisionMap::sweepY(sf::FloatRect box, float dy) const {
+  const auto [minX, maxX] = tileSpan(box.position.x, box.size.x, m_tileSize);
+  return sweepAxis(box.position.y, box.size.y, dy, m_tileSize,
+                   [&](int32_t y) { return isRowBlocked(y, minX, maxX); });
+}
+
+sf::Vector2f CollisionMap::move(sf::FloatRect box, sf::Vector2f delta,
+                                bool &hit) const {
+  // The y sweep starts where the x one ended so corners can't be skipped
+  sf::Vector2f moved;
+  moved.x = sweepX(box, delta.x);
+  box.position.x += moved.x;
+  moved.y = sweepY(box, delta.y);
+
+  hit = moved != delta;
+  return moved;
+}
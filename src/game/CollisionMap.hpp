@@ -0,0 +1,50 @@
+#pragma once
+
+#include <SFML/Graphics/Rect.hpp>
+#include <SFML/System/Vector2.hpp>
+#include <cstdint>
+#include <vector>
+
+/**
+ * One bit per tile, set for the tiles that can't be entered. Everything
+ * outside of the map is blocked too. Boxes are swept through it one axis at
+ * a time, only looking at the rows or columns of tiles they cross, so a move
+ * costs a few bit tests per tile crossed.
+ *
+ * Boxes collide with the tiles they would overlap - touching is fine. Tiles
+ * a box already overlaps are ignored so it can always move out of them.
+ **/
+class CollisionMap {
+public:
+  CollisionMap() = default;
+  CollisionMap(uint32_t width, uint32_t height, float tileSize);
+
+  // "blocked" has one value per tile, row by row
+  void build(const std::vector<uint8_t> &blocked);
+
+  bool isBlocked(int32_t x, int32_t y) const;
+  // True when the box overlaps a blocked tile
+  bool overlaps(sf::FloatRect box) const;
+
+  // How far the box gets along one axis before it touches a blocked tile.
+  // Between 0 and delta
+  float sweepX(sf::FloatRect box, float dx) const;
+  float sweepY(sf::FloatRect box, float dy) const;
+
+  // Moves the box along x and then along y, stopping on blocked tiles.
+  // Returns how far it got. "hit" is set when a tile stopped it
+  sf::Vector2f move(sf::FloatRect box, sf::Vector2f delta, bool &hit) const;
+
+private:
+  // Whether any tile in [min, max] of the row (column) is blocked. Tiles
+  // outside of the map are
+  bool isRowBlocked(int32_t y, int32_t minX, int32_t maxX) const;
+  bool isColumnBlocked(int32_t x, int32_t minY, int32_t maxY) const;
+
+  uint32_t m_width = 0;
+  uint32_t m_height = 0;
+  uint32_t m_wordsPerRow = 0;
+  float m_tileSize = 1.f;
+
+  std::vector<uint64_t> m_bits;
+};
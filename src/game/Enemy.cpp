@@ -1,32 +1,53 @@
 #include "Enemy.hpp"
 #include "HealthBar.hpp"
-#include "Level.hpp"
+#include "Kernels.hpp"
 
-Enemy::Enemy(sf::Vector2f startPos, sf::Vector2f destination)
-    : rect(), healthBar({startPos, {Level::TILE_SIZE, Level::TILE_SIZE}}, 100) {
-  this->rect.setPosition(startPos);
-  this->rect.setRadius(Level::TILE_SIZE / 2.f);
-  this->rect.setFillColor(sf::Color::Magenta);
-
-  this->destination = destination;
+EntityID EnemyArrays::insert(sf::Vector2f pos, sf::Vector2f destination) {
+  EntityID id = 0;
+  const uint32_t i = insertSlot(id);
+  setPosition(i, pos);
+  destX[i] = destination.x;
+  destY[i] = destination.y;
+  setHealth(i, Enemy::MAX_HEALTH);
+  stopped[i] = false;
+  return id;
 }
-Enemy::~Enemy() {}
-
-void Enemy::draw(sf::RenderWindow &window) const {
 
-  window.draw(this->rect);
-  this->healthBar.draw(window);
+void EnemyArrays::assign(const Enemy::DTO &dto) {
+  const uint32_t i = assignSlot(dto.id);
+  setPosition(i, dto.pos);
+  destX[i] = dto.destination.x;
+  destY[i] = dto.destination.y;
+  // A new slot starts at 0 health with an empty bar
+  if (health[i] != dto.health)
+    setHealth(i, dto.health);
 }
 
-void Enemy::update(float dt) {
+void EnemyArrays::setHealth(uint32_t i, int value) {
+  health[i] = value;
+  barWidth[i] = HealthBar::fillWidth(value, Enemy::MAX_HEALTH);
+}
 
-  sf::Vector2f direction =
-      (this->destination - this->rect.getPosition()).normalized();
+void EnemyArrays::update(float dt) {
+  kernels::steer(posX.data(), posY.data(), destX.data(), destY.data(),
+                 stopped.data(), size(), Enemy::SPEED * dt);
+}
 
-  this->rect.move(direction * dt * 20.f);
+void EnemyArrays::followField(const FlowField &field) {
+  // Positions are the top left corners, the field works with the centers
+  for (size_t i = 0; i < size(); ++i) {
+    const sf::Vector2f waypoint =
+        field.getWaypoint({posX[i] + Enemy::RADIUS, posY[i] + Enemy::RADIUS});
+    destX[i] = waypoint.x - Enemy::RADIUS;
+    destY[i] = waypoint.y - Enemy::RADIUS;
+  }
+}
 
-  this->healthBar.update({this->rect.getPosition(),
-                          {this->rect.getRadius(), this->rect.getRadius()}});
+Enemy::DTO EnemyArrays::toDTO(uint32_t i) const {
+  return {.id = ids()[i],
+          .pos = getPosition(i),
+          .destination = {destX[i], destY[i]},
+          .health = health[i]};
 }
 
 EnemySpawner::EnemySpawner(uint32_t enemiesToSpawn, float spawnDelaySeconds,
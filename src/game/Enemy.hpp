@@ -1,32 +1,63 @@
 #pragma once
-#include "HealthBar.hpp"
-#include <SFML/Graphics.hpp>
-#include <SFML/Graphics/RenderWindow.hpp>
-#include <SFML/Window.hpp>
+#include "EntityArrays.hpp"
+#include "FlowField.hpp"
 #include <atomic>
 #include <functional>
 
 struct Level;
+class SpriteBatch;
 
 struct Enemy {
-
-  Enemy(sf::Vector2f startPos, sf::Vector2f destination);
-  ~Enemy();
-
-  void draw(sf::RenderWindow &window) const;
-  void update(float dt);
-
-  sf::CircleShape rect;
-  sf::Vector2f destination;
-  HealthBar healthBar;
+  // Half of a tile
+  static constexpr float RADIUS = 8.f;
+  // Pixels per second
+  static constexpr float SPEED = 20.f;
+  static constexpr int MAX_HEALTH = 100;
 
   struct DTO {
+    EntityID id;
     sf::Vector2f pos;
     sf::Vector2f destination;
     int health;
   };
 };
 
+// Every enemy of a level. Ids are given by "insert" and identify the enemies
+// in the snapshots
+struct EnemyArrays : EntityArrays<EnemyArrays> {
+
+  EntityID insert(sf::Vector2f pos, sf::Vector2f destination);
+  // Stores the enemy under the id given by the server
+  void assign(const Enemy::DTO &dto);
+  // Changes the health and the health bar with it
+  void setHealth(uint32_t i, int value);
+
+  // Points the destination of every enemy at the next tile of the field
+  void followField(const FlowField &field);
+  // Moves the enemies that aren't stopped towards their destination
+  void update(float dt);
+  void draw(SpriteBatch &batch, float alpha = 1.f) const;
+
+  sf::FloatRect getBounds(uint32_t i) const {
+    return {getPosition(i), {2 * Enemy::RADIUS, 2 * Enemy::RADIUS}};
+  }
+  Enemy::DTO toDTO(uint32_t i) const;
+
+  template <typename F> void forEachColumn(F &&f) {
+    f(posX), f(posY), f(prevX), f(prevY);
+    f(destX), f(destY), f(health), f(barWidth), f(stopped);
+  }
+
+  std::vector<float> destX, destY;
+  // Changed through setHealth, so the health bar follows
+  std::vector<int> health;
+  // Width of the filled part of the health bar. Only changes with the
+  // health, the drawing doesn't work it out every frame
+  std::vector<float> barWidth;
+  // Enemies touching the base don't move. Set by the level every tick
+  std::vector<uint8_t> stopped;
+};
+
 struct EnemySpawner {
   EnemySpawner(uint32_t enemiesToSpawn, float spawnDelaySeconds,
                std::function<void(void)> spawnCallback);
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <SFML/Graphics/Rect.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "Kernels.hpp"
+#include "SlotMap.hpp"
+
+/**
+ * Simulation state of one kind of entity as a structure of arrays - one
+ * vector per field and the same index in every vector is the same entity.
+ * Updates walk only the fields they use. Ids are kept by a SlotTable so they
+ * stay valid when entities move around in the arrays.
+ *
+ * Every entity has a position (the top left corner of its bounds) and the
+ * position at the start of the tick for the drawing. Derived adds its own
+ * vectors and calls the given function with each of them, these included, in
+ * "forEachColumn".
+ *
+ * Removed entities leave their slot and their place in the arrays for the
+ * next ones, so spawning and despawning only allocate when there are more
+ * entities (or higher slots) than ever before. The arrays and the slot table
+ * then grow together by whole chunks.
+ **/
+template <typename Derived> class EntityArrays {
+public:
+  // The arrays grow by at least this many entities at a time
+  static constexpr size_t CHUNK = 256;
+
+  bool contains(EntityID id) const { return m_slots.contains(id); }
+  // Index of the entity in the arrays. The id must be valid
+  uint32_t find(EntityID id) const { return m_slots.find(id); }
+
+  // Returns false when the id is stale
+  bool remove(EntityID id) {
+    const auto hole = m_slots.remove(id);
+    if (!hole)
+      return false;
+
+    derived().forEachColumn([hole](auto &column) {
+      column[*hole] = column.back();
+      column.pop_back();
+    });
+    return true;
+  }
+
+  // Removes every entity whose index matches the predicate
+  template <typename F> void removeIf(F &&predicate) {
+    for (size_t i = size(); i-- > 0;) {
+      if (predicate(static_cast<uint32_t>(i)))
+        remove(ids()[i]);
+    }
+  }
+
+  // Removes every entity whose position is outside of the area
+  void removeOutside(sf::FloatRect area) {
+    m_outside.resize(size());
+    const size_t count = kernels::findOutside(posX.data(), posY.data(), size(),
+                                              area, m_outside.data());
+    // From the back - removal only moves entities from behind the hole
+    for (size_t i = count; i-- > 0;)
+      remove(ids()[m_outside[i]]);
+  }
+
+  // Keeps the generations so the old ids stay stale
+  void clear() {
+    while (size() > 0)
+      remove(ids().back());
+  }
+
+  // Room for n entities without allocating
+  void reserve(size_t n) {
+    if (n <= m_capacity)
+      return;
+    derived().forEachColumn([n](auto &column) { column.reserve(n); });
+    m_slots.reserve(n);
+    m_outside.reserve(n);
+    m_capacity = n;
+  }
+  size_t capacity() const { return m_capacity; }
+
+  size_t size() const { return m_slots.size(); }
+  bool empty() const { return size() == 0; }
+  // Id of every entity, in the order of the arrays
+  const std::vector<EntityID> &ids() const { return m_slots.getIDs(); }
+
+  sf::Vector2f getPosition(uint32_t i) const { return {posX[i], posY[i]}; }
+  // Teleports the entity - it won't be interpolated from the old position
+  void setPosition(uint32_t i, sf::Vector2f pos) {
+    posX[i] = prevX[i] = pos.x;
+    posY[i] = prevY[i] = pos.y;
+  }
+
+  // Remembers the positions at the start of a simulation tick
+  void savePositions() {
+    prevX = posX;
+    prevY = posY;
+  }
+  // Position between the previous (alpha = 0) and the current tick (1)
+  sf::Vector2f getInterpolatedPosition(uint32_t i, float alpha) const {
+    return {prevX[i] + (posX[i] - prevX[i]) * alpha,
+            prevY[i] + (posY[i] - prevY[i]) * alpha};
+  }
+
+  std::vector<float> posX, posY;
+  std::vector<float> prevX, prevY;
+
+protected:
+  // Makes room for a new entity at the end of the arrays and returns its
+  // index. The derived class fills the columns
+  uint32_t insertSlot(EntityID &id) {
+    // The table adds the id (and maybe a slot) right away, so the room has
+    // to be there before
+    grow(std::max(size(), m_slots.getSlotCount()) + 1);
+    id = m_slots.insert();
+    return append();
+  }
+
+  // Same for an id given by the server. Returns the index of the entity
+  // when it already exists
+  uint32_t assignSlot(EntityID id) {
+    // The slots up to the one of the server are added at once
+    grow(std::max<size_t>(size() + 1, SlotTable::indexOf(id) + 1));
+    bool placed = false;
+    const uint32_t index = m_slots.assign(id, placed);
+    return placed ? append() : index;
+  }
+
+private:
+  Derived &derived() { return static_cast<Derived &>(*this); }
+
+  // Room for "needed" entities and slots
+  void grow(size_t needed) {
+    if (needed <= m_capacity)
+      return;
+    // Half of what there is, so the copying stays linear in the end
+    const size_t step =
+        std::max(CHUNK, (m_capacity / 2 + CHUNK - 1) / CHUNK * CHUNK);
+    reserve(std::max(m_capacity + step, (needed + CHUNK - 1) / CHUNK * CHUNK));
+  }
+
+  uint32_t append() {
+    derived().forEachColumn([](auto &column) { column.emplace_back(); });
+    return static_cast<uint32_t>(size() - 1);
+  }
+
+  SlotTable m_slots;
+  // Scratch space of removeOutside
+  std::vector<uint32_t> m_outside;
+  // Entities the arrays have room for
+  size_t m_capacity = 0;
+};
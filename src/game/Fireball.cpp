@@ -1,24 +1,38 @@
 #include "Fireball.hpp"
-#include "Level.hpp"
+#include "Kernels.hpp"
 
-#include "../debug.hpp"
+EntityID FireballArrays::insert(sf::Vector2f pos, sf::Vector2f direction) {
+  EntityID id = 0;
+  const uint32_t i = insertSlot(id);
+  setPosition(i, pos);
+  dirX[i] = direction.x;
+  dirY[i] = direction.y;
+  return id;
+}
 
-Fireball::Fireball() { direction = {0.f, 0.f}; }
+void FireballArrays::assign(const Fireball::DTO &dto) {
+  const uint32_t i = assignSlot(dto.id);
+  setPosition(i, dto.pos);
+  dirX[i] = dto.direction.x;
+  dirY[i] = dto.direction.y;
+}
 
-Fireball::Fireball(sf::Vector2f startPos, sf::Vector2f direction)
-    : rect(), direction(direction) {
-  rect.setPosition(startPos);
-  rect.setRadius(Level::TILE_SIZE / 2.f);
+void FireballArrays::update(float dt) {
+  kernels::integrate(posX.data(), posY.data(), dirX.data(), dirY.data(),
+                     size(), Fireball::SPEED * dt);
 }
 
-void Fireball::update(float dt) {
-  sf::Vector2f vel = direction * dt * 100.f;
-  this->rect.setPosition(this->rect.getPosition() + vel);
+void FireballArrays::removeWallHits(const CollisionMap &walls) {
+  removeIf([&](uint32_t i) {
+    const sf::FloatRect start = {{prevX[i], prevY[i]}, getBounds(i).size};
+    bool hit = false;
+    walls.move(start, {posX[i] - prevX[i], posY[i] - prevY[i]}, hit);
+    return hit;
+  });
 }
 
-void Fireball::draw(sf::RenderWindow &window) const {
-  window.draw(this->rect);
-  DEBUG_OUTLINE(
-      window, this->rect.getPosition(),
-      sf::Vector2f(this->rect.getRadius() * 2, this->rect.getRadius() * 2));
+Fireball::DTO FireballArrays::toDTO(uint32_t i) const {
+  return {.id = ids()[i],
+          .pos = getPosition(i),
+          .direction = {dirX[i], dirY[i]}};
 }
@@ -1,23 +1,46 @@
 #pragma once
 
-#include <SFML/Graphics/CircleShape.hpp>
-#include <SFML/Graphics/RectangleShape.hpp>
-#include <SFML/Graphics/RenderWindow.hpp>
 #include <SFML/System/Vector2.hpp>
 
-struct Fireball {
-  Fireball();
-  Fireball(sf::Vector2f startPos, sf::Vector2f direction);
-  ~Fireball() = default;
+#include "CollisionMap.hpp"
+#include "EntityArrays.hpp"
 
-  void update(float dt);
-  void draw(sf::RenderWindow &window) const;
+class SpriteBatch;
 
-  sf::CircleShape rect;
-  sf::Vector2f direction;
+struct Fireball {
+  // Half of a tile
+  static constexpr float RADIUS = 8.f;
+  // Pixels per second
+  static constexpr float SPEED = 100.f;
 
   struct DTO {
+    EntityID id;
     sf::Vector2f pos;
     sf::Vector2f direction;
   };
 };
+
+// Every fireball of a level. Ids are given by "insert" and identify the
+// fireballs in the snapshots
+struct FireballArrays : EntityArrays<FireballArrays> {
+
+  EntityID insert(sf::Vector2f pos, sf::Vector2f direction);
+  // Stores the fireball under the id given by the server
+  void assign(const Fireball::DTO &dto);
+
+  void update(float dt);
+  // Removes the fireballs that ran into a wall since the start of the tick
+  void removeWallHits(const CollisionMap &walls);
+  void draw(SpriteBatch &batch, float alpha = 1.f) const;
+
+  sf::FloatRect getBounds(uint32_t i) const {
+    return {getPosition(i), {2 * Fireball::RADIUS, 2 * Fireball::RADIUS}};
+  }
+  Fireball::DTO toDTO(uint32_t i) const;
+
+  template <typename F> void forEachColumn(F &&f) {
+    f(posX), f(posY), f(prevX), f(prevY), f(dirX), f(dirY);
+  }
+
+  std::vector<float> dirX, dirY;
+};
@@ -0,0 +1,120 @@
+#include "FlowField.hpp"
+#include <algorithm>
+#include <cmath>
+
+FlowField::FlowField(uint32_t width, uint32_t height, float tileSize)
+    : m_width(width), m_height(height), m_tileSize(tileSize),
+      m_distances(width * height, NO_PATH),
+      m_waypoints(width * height) {}
+
+void FlowField::build(const std::vector<uint8_t> &blocked,
+                      std::span<const sf::Vector2u> targets) {
+  std::fill(m_distances.begin(), m_distances.end(), NO_PATH);
+
+  std::vector<uint32_t> queue;
+  queue.reserve(m_distances.size());
+  for (sf::Vector2u target : targets) {
+    const uint32_t index = target.y * m_width + target.x;
+    if (target.x < m_width && target.y < m_height && !blocked[index] &&
+        m_distances[index] != 0) {
+      m_distances[index] = 0;
+      queue.push_back(index);
+    }
+  }
+
+  // Plain BFS over the 4 neighbours
+  for (size_t head = 0; head < queue.size(); ++head) {
+    const uint32_t index = queue[head];
+    const uint32_t x = index % m_width;
+    const uint32_t y = index / m_width;
+
+    auto visit = [&](uint32_t neighbour) {
+      if (blocked[neighbour] || m_distances[neighbour] != NO_PATH)
+        return;
+      m_distances[neighbour] = m_distances[index] + 1;
+      queue.push_back(neighbour);
+    };
+    if (x > 0)
+      visit(index - 1);
+    if (x + 1 < m_width)
+      visit(index + 1);
+    if (y > 0)
+      visit(index - m_width);
+    if (y + 1 < m_height)
+      visit(index + m_width);
+  }
+
+  auto distanceAt = [this](int32_t x, int32_t y) {
+    if (x < 0 || y < 0 || x >= static_cast<int32_t>(m_width) ||
+        y >= static_cast<int32_t>(m_height))
+      return NO_PATH;
+    return m_distances[y * m_width + x];
+  };
+
+  // Picking the closest neighbour of every tile. Orthogonal ones first so
+  // ties don't go diagonal
+  constexpr int32_t OFFSETS[8][2] = {{1, 0},  {-1, 0}, {0, 1},  {0, -1},
+                                     {1, 1},  {1, -1}, {-1, 1}, {-1, -1}};
+  for (uint32_t index = 0; index < m_distances.size(); ++index) {
+    const int32_t x = index % m_width;
+    const int32_t y = index / m_width;
+
+    int32_t bestX = x, bestY = y;
+    uint16_t best = m_distances[index];
+    for (const auto &[dx, dy] : OFFSETS) {
+      const uint16_t distance = distanceAt(x + dx, y + dy);
+      if (distance >= best)
+        continue;
+      // Going diagonally past a wall would clip its corner
+      if (dx != 0 && dy != 0 &&
+          (distanceAt(x + dx, y) == NO_PATH ||
+           distanceAt(x, y + dy) == NO_PATH))
+        continue;
+      best = distance;
+      bestX = x + dx;
+      bestY = y + dy;
+    }
+
+    m_waypoints[index] = tileCenter(bestY * m_width + bestX);
+  }
+}
+
+uint16_t FlowField::getDistance(sf::Vector2u tile) const {
+  if (tile.x >= m_width || tile.y >= m_height)
+    return NO_PATH;
+  return m_distances[tile.y * m_width + tile.x];
+}
+
+sf::Vector2f FlowField::getWaypoint(sf::Vector2f pos) const {
+  const uint32_t index = tileIndexOf(pos);
+  const sf::Vector2f center = tileCenter(index);
+  const sf::Vector2f next = m_waypoints[index];
+
+  // Distance from the line through both centers (times the length of
+  // "heading"). Zero when the next tile is the same one
+  const sf::Vector2f offset = pos - center;
+  const sf::Vector2f heading = next - center;
+  const float cross = offset.cross(heading);
+  if (cross * cross > ALIGNMENT * ALIGNMENT * heading.lengthSquared())
+    return center;
+  return next;
+}
+
+sf::Vector2f FlowField::getDirection(sf::Vector2f pos) const {
+  const sf::Vector2f toWaypoint = getWaypoint(pos) - pos;
+  const float length = toWaypoint.length();
+  return length > 0.f ? toWaypoint / length : sf::Vector2f{};
+}
+
+uint32_t FlowField::tileIndexOf(sf::Vector2f pos) const {
+  auto tile = [this](float coordinate, uint32_t count) {
+    const float t = std::floor(coordinate / m_tileSize);
+    return static_cast<uint32_t>(std::clamp(t, 0.f, count - 1.f));
+  };
+  return tile(pos.y, m_height) * m_width + tile(pos.x, m_width);
+}
+
+sf::Vector2f FlowField::tileCenter(uint32_t index) const {
+  return {(index % m_width + 0.5f) * m_tileSize,
+          (index / m_width + 0.5f) * m_tileSize};
+}
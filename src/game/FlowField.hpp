@@ -0,0 +1,59 @@
+#pragma once
+
+#include <SFML/System/Vector2.hpp>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/**
+ * Distances to a set of target tiles over a grid of tiles, found with one
+ * breadth first search. Every tile also knows the neighbour to go to next
+ * (diagonals only when they don't cut a blocked corner), so any number of
+ * entities can walk to the targets around walls with one lookup each.
+ *
+ * Rebuilt when the tiles or the targets change.
+ **/
+class FlowField {
+public:
+  static constexpr uint16_t NO_PATH = 0xFFFF;
+
+  FlowField() = default;
+  FlowField(uint32_t width, uint32_t height, float tileSize);
+
+  // "blocked" has one value per tile, row by row. Non zero tiles can't be
+  // entered
+  void build(const std::vector<uint8_t> &blocked,
+             std::span<const sf::Vector2u> targets);
+
+  // Number of steps to the closest target. NO_PATH when walled off
+  uint16_t getDistance(sf::Vector2u tile) const;
+
+  // Entities off the line between two tile centers by more than this go to
+  // the center of their tile first
+  static constexpr float ALIGNMENT = 0.01f;
+
+  /**
+   * Point to walk to from "pos". It's the center of the next tile, but an
+   * entity that isn't lined up with it (it came from another direction)
+   * first goes to the center of its tile. So entities as big as a tile
+   * turn on the tile centers and don't clip the corners of walls.
+   * The center of the tile of "pos" on a target or when no target can be
+   * reached
+   **/
+  sf::Vector2f getWaypoint(sf::Vector2f pos) const;
+  // Unit vector towards the waypoint. Zero when there is none
+  sf::Vector2f getDirection(sf::Vector2f pos) const;
+
+private:
+  // Index of the tile of the point. Points outside are clamped to the grid
+  uint32_t tileIndexOf(sf::Vector2f pos) const;
+  sf::Vector2f tileCenter(uint32_t index) const;
+
+  uint32_t m_width = 0;
+  uint32_t m_height = 0;
+  float m_tileSize = 1.f;
+
+  std::vector<uint16_t> m_distances;
+  // Center of the next tile of every tile
+  std::vector<sf::Vector2f> m_waypoints;
+};
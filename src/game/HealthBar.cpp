@@ -1,6 +1,6 @@
 #include "HealthBar.hpp"
 #include "Level.hpp"
-#include <SFML/Graphics/RenderWindow.hpp>
+#include <algorithm>
 
 const float HealthBar::MAX_WIDTH = Level::TILE_SIZE;
 const float HealthBar::HEIGHT = 3.f;
@@ -10,11 +10,6 @@ HealthBar::HealthBar(sf::FloatRect parent, int maxHealth) {
   this->maxHealth = maxHealth;
   this->health = maxHealth;
 
-  this->rect.setSize({MAX_WIDTH, HEIGHT});
-  this->rect.setFillColor(sf::Color::Green);
-  this->rectBG.setSize({MAX_WIDTH, HEIGHT});
-  this->rectBG.setFillColor(sf::Color::Red);
-
   update(parent);
 }
 
@@ -25,13 +20,9 @@ void HealthBar::update(sf::FloatRect parent) {
   pos.x += parent.size.x / 2;
   pos.x -= MAX_WIDTH / 2;
 
-  this->rect.setPosition(pos);
-  this->rectBG.setPosition(pos);
-
-  this->rect.setSize({(health * 1.f / maxHealth) * MAX_WIDTH, HEIGHT});
+  this->bounds = {pos, {MAX_WIDTH, HEIGHT}};
 }
 
-void HealthBar::draw(sf::RenderWindow &window) const {
-  window.draw(this->rectBG);
-  window.draw(this->rect);
+float HealthBar::fillWidth(int health, int maxHealth) {
+  return std::clamp(health * 1.f / maxHealth, 0.f, 1.f) * MAX_WIDTH;
 }
@@ -1,6 +1,7 @@
 #pragma once
-#include <SFML/Graphics/RectangleShape.hpp>
-#include <SFML/Graphics/RenderWindow.hpp>
+#include <SFML/Graphics/Rect.hpp>
+
+class SpriteBatch;
 
 struct HealthBar {
 
@@ -9,13 +10,16 @@ struct HealthBar {
   ~HealthBar() = default;
 
   void update(sf::FloatRect parentPos);
-  void draw(sf::RenderWindow &window) const;
+  void draw(SpriteBatch &batch) const;
+
+  // Width of the filled part of a bar
+  static float fillWidth(int health, int maxHealth);
 
   int health;
   int maxHealth;
 
-  sf::RectangleShape rect;
-  sf::RectangleShape rectBG;
+  // Whole bar, drawn above the parent
+  sf::FloatRect bounds;
 
   static const float MAX_WIDTH;
   static const float HEIGHT;
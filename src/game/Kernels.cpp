@@ -0,0 +1,308 @@
+#include "Kernels.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+#include "../logging.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KERNELS_X86
+#include <immintrin.h>
+#endif
+
+namespace kernels {
+
+namespace {
+
+// Scalar versions. Also used for the tails of the vector versions
+
+void steerScalar(float *posX, float *posY, const float *destX,
+                 const float *destY, const uint8_t *stopped, size_t begin,
+                 size_t count, float step) {
+  for (size_t i = begin; i < count; ++i) {
+    const float dx = destX[i] - posX[i];
+    const float dy = destY[i] - posY[i];
+    const float length = std::sqrt(dx * dx + dy * dy);
+    // sf::Vector2f::normalized asserts on a zero vector
+    const bool moving = !stopped[i] & (length > 0.f);
+    // Stops on the destination instead of going past it
+    const float scale = moving ? std::min(step, length) / length : 0.f;
+
+    posX[i] += dx * scale;
+    posY[i] += dy * scale;
+  }
+}
+
+void integrateScalar(float *posX, float *posY, const float *dirX,
+                     const float *dirY, size_t begin, size_t count,
+                     float step) {
+  for (size_t i = begin; i < count; ++i) {
+    posX[i] += dirX[i] * step;
+    posY[i] += dirY[i] * step;
+  }
+}
+
+size_t findOutsideScalar(const float *posX, const float *posY, size_t begin,
+                         size_t count, sf::FloatRect area, uint32_t *outside) {
+  const float minX = area.position.x, maxX = minX + area.size.x;
+  const float minY = area.position.y, maxY = minY + area.size.y;
+
+  size_t found = 0;
+  for (size_t i = begin; i < count; ++i) {
+    if (!(posX[i] >= minX && posX[i] <= maxX && posY[i] >= minY &&
+          posY[i] <= maxY))
+      outside[found++] = static_cast<uint32_t>(i);
+  }
+  return found;
+}
+
+#ifdef KERNELS_X86
+
+// Indices of the set bits of a lane mask
+size_t appendLanes(uint32_t mask, size_t base, uint32_t *outside) {
+  size_t found = 0;
+  while (mask != 0) {
+    outside[found++] = static_cast<uint32_t>(base + std::countr_zero(mask));
+    mask &= mask - 1;
+  }
+  return found;
+}
+
+// SSE2 is always there on x86_64, the attribute is for 32 bit builds
+
+__attribute__((target("sse2"))) void
+steerSSE2(float *posX, float *posY, const float *destX, const float *destY,
+          const uint8_t *stopped, size_t count, float step) {
+  const __m128 stepV = _mm_set1_ps(step);
+  const __m128 zero = _mm_setzero_ps();
+
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const __m128 px = _mm_loadu_ps(posX + i);
+    const __m128 py = _mm_loadu_ps(posY + i);
+    const __m128 dx = _mm_sub_ps(_mm_loadu_ps(destX + i), px);
+    const __m128 dy = _mm_sub_ps(_mm_loadu_ps(destY + i), py);
+    const __m128 length =
+        _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+
+    // 4 stop flags widened to 32 bit lanes
+    int32_t flags = 0;
+    std::memcpy(&flags, stopped + i, 4);
+    __m128i wide = _mm_cvtsi32_si128(flags);
+    wide = _mm_unpacklo_epi8(wide, _mm_setzero_si128());
+    wide = _mm_unpacklo_epi16(wide, _mm_setzero_si128());
+    const __m128 notStopped =
+        _mm_castsi128_ps(_mm_cmpeq_epi32(wide, _mm_setzero_si128()));
+
+    const __m128 moving = _mm_and_ps(notStopped, _mm_cmpgt_ps(length, zero));
+    // Lanes with a zero length divide by zero, the mask throws them away
+    const __m128 scale = _mm_and_ps(
+        moving, _mm_div_ps(_mm_min_ps(length, stepV), length));
+
+    _mm_storeu_ps(posX + i, _mm_add_ps(px, _mm_mul_ps(dx, scale)));
+    _mm_storeu_ps(posY + i, _mm_add_ps(py, _mm_mul_ps(dy, scale)));
+  }
+  steerScalar(posX, posY, destX, destY, stopped, i, count, step);
+}
+
+__attribute__((target("sse2"))) void
+integrateSSE2(float *posX, float *posY, const float *dirX, const float *dirY,
+              size_t count, float step) {
+  const __m128 stepV = _mm_set1_ps(step);
+
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const __m128 vx = _mm_mul_ps(_mm_loadu_ps(dirX + i), stepV);
+    const __m128 vy = _mm_mul_ps(_mm_loadu_ps(dirY + i), stepV);
+    _mm_storeu_ps(posX + i, _mm_add_ps(_mm_loadu_ps(posX + i), vx));
+    _mm_storeu_ps(posY + i, _mm_add_ps(_mm_loadu_ps(posY + i), vy));
+  }
+  integrateScalar(posX, posY, dirX, dirY, i, count, step);
+}
+
+__attribute__((target("sse2"))) size_t
+findOutsideSSE2(const float *posX, const float *posY, size_t count,
+                sf::FloatRect area, uint32_t *outside) {
+  const __m128 minX = _mm_set1_ps(area.position.x);
+  const __m128 maxX = _mm_set1_ps(area.position.x + area.size.x);
+  const __m128 minY = _mm_set1_ps(area.position.y);
+  const __m128 maxY = _mm_set1_ps(area.position.y + area.size.y);
+
+  size_t found = 0;
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const __m128 x = _mm_loadu_ps(posX + i);
+    const __m128 y = _mm_loadu_ps(posY + i);
+    const __m128 in =
+        _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(x, minX), _mm_cmple_ps(x, maxX)),
+                   _mm_and_ps(_mm_cmpge_ps(y, minY), _mm_cmple_ps(y, maxY)));
+    found += appendLanes(~_mm_movemask_ps(in) & 0xF, i, outside + found);
+  }
+  return found +
+         findOutsideScalar(posX, posY, i, count, area, outside + found);
+}
+
+__attribute__((target("avx2"))) void
+steerAVX2(float *posX, float *posY, const float *destX, const float *destY,
+          const uint8_t *stopped, size_t count, float step) {
+  const __m256 stepV = _mm256_set1_ps(step);
+  const __m256 zero = _mm256_setzero_ps();
+
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m256 px = _mm256_loadu_ps(posX + i);
+    const __m256 py = _mm256_loadu_ps(posY + i);
+    const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(destX + i), px);
+    const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(destY + i), py);
+    const __m256 length = _mm256_sqrt_ps(
+        _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+
+    // 8 stop flags widened to 32 bit lanes
+    const __m256i wide = _mm256_cvtepu8_epi32(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i *>(stopped + i)));
+    const __m256 notStopped = _mm256_castsi256_ps(
+        _mm256_cmpeq_epi32(wide, _mm256_setzero_si256()));
+
+    const __m256 moving = _mm256_and_ps(
+        notStopped, _mm256_cmp_ps(length, zero, _CMP_GT_OQ));
+    // Lanes with a zero length divide by zero, the mask throws them away
+    const __m256 scale = _mm256_and_ps(
+        moving, _mm256_div_ps(_mm256_min_ps(length, stepV), length));
+
+    _mm256_storeu_ps(posX + i, _mm256_add_ps(px, _mm256_mul_ps(dx, scale)));
+    _mm256_storeu_ps(posY + i, _mm256_add_ps(py, _mm256_mul_ps(dy, scale)));
+  }
+  steerScalar(posX, posY, destX, destY, stopped, i, count, step);
+}
+
+__attribute__((target("avx2"))) void
+integrateAVX2(float *posX, float *posY, const float *dirX, const float *dirY,
+              size_t count, float step) {
+  const __m256 stepV = _mm256_set1_ps(step);
+
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m256 vx = _mm256_mul_ps(_mm256_loadu_ps(dirX + i), stepV);
+    const __m256 vy = _mm256_mul_ps(_mm256_loadu_ps(dirY + i), stepV);
+    _mm256_storeu_ps(posX + i, _mm256_add_ps(_mm256_loadu_ps(posX + i), vx));
+    _mm256_storeu_ps(posY + i, _mm256_add_ps(_mm256_loadu_ps(posY + i), vy));
+  }
+  integrateScalar(posX, posY, dirX, dirY, i, count, step);
+}
+
+__attribute__((target("avx2"))) size_t
+findOutsideAVX2(const float *posX, const float *posY, size_t count,
+                sf::FloatRect area, uint32_t *outside) {
+  const __m256 minX = _mm256_set1_ps(area.position.x);
+  const __m256 maxX = _mm256_set1_ps(area.position.x + area.size.x);
+  const __m256 minY = _mm256_set1_ps(area.position.y);
+  const __m256 maxY = _mm256_set1_ps(area.position.y + area.size.y);
+
+  size_t found = 0;
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m256 x = _mm256_loadu_ps(posX + i);
+    const __m256 y = _mm256_loadu_ps(posY + i);
+    // Ordered compares - NaN is outside, same as the scalar version
+    const __m256 in = _mm256_and_ps(
+        _mm256_and_ps(_mm256_cmp_ps(x, minX, _CMP_GE_OQ),
+                      _mm256_cmp_ps(x, maxX, _CMP_LE_OQ)),
+        _mm256_and_ps(_mm256_cmp_ps(y, minY, _CMP_GE_OQ),
+                      _mm256_cmp_ps(y, maxY, _CMP_LE_OQ)));
+    found += appendLanes(~_mm256_movemask_ps(in) & 0xFF, i, outside + found);
+  }
+  return found +
+         findOutsideScalar(posX, posY, i, count, area, outside + found);
+}
+
+#endif
+
+Isa detectIsa() {
+#ifdef KERNELS_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return Isa::AVX2;
+  if (__builtin_cpu_supports("sse2"))
+    return Isa::SSE2;
+#endif
+  return Isa::Scalar;
+}
+
+Isa &currentIsa() {
+  static Isa isa = [] {
+    const Isa detected = getSupportedIsa();
+    LOG_INFO("Simulation kernels use ", getIsaName(detected));
+    return detected;
+  }();
+  return isa;
+}
+
+} // namespace
+
+Isa getSupportedIsa() {
+  static const Isa supported = detectIsa();
+  return supported;
+}
+
+Isa getIsa() { return currentIsa(); }
+
+void setIsa(Isa isa) {
+  currentIsa() = std::min(isa, getSupportedIsa());
+}
+
+const char *getIsaName(Isa isa) {
+  switch (isa) {
+  case Isa::Scalar:
+    return "scalar";
+  case Isa::SSE2:
+    return "SSE2";
+  case Isa::AVX2:
+    return "AVX2";
+  }
+  return "unknown";
+}
+
+void steer(float *posX, float *posY, const float *destX, const float *destY,
+           const uint8_t *stopped, size_t count, float step) {
+  switch (currentIsa()) {
+#ifdef KERNELS_X86
+  case Isa::AVX2:
+    return steerAVX2(posX, posY, destX, destY, stopped, count, step);
+  case Isa::SSE2:
+    return steerSSE2(posX, posY, destX, destY, stopped, count, step);
+#endif
+  default:
+    return steerScalar(posX, posY, destX, destY, stopped, 0, count, step);
+  }
+}
+
+void integrate(float *posX, float *posY, const float *dirX, const float *dirY,
+               size_t count, float step) {
+  switch (currentIsa()) {
+#ifdef KERNELS_X86
+  case Isa::AVX2:
+    return integrateAVX2(posX, posY, dirX, dirY, count, step);
+  case Isa::SSE2:
+    return integrateSSE2(posX, posY, dirX, dirY, count, step);
+#endif
+  default:
+    return integrateScalar(posX, posY, dirX, dirY, 0, count, step);
+  }
+}
+
+size_t findOutside(const float *posX, const float *posY, size_t count,
+                   sf::FloatRect area, uint32_t *outside) {
+  switch (currentIsa()) {
+#ifdef KERNELS_X86
+  case Isa::AVX2:
+    return findOutsideAVX2(posX, posY, count, area, outside);
+  case Isa::SSE2:
+    return findOutsideSSE2(posX, posY, count, area, outside);
+#endif
+  default:
+    return findOutsideScalar(posX, posY, 0, count, area, outside);
+  }
+}
+
+} // namespace kernels
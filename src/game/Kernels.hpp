@@ -0,0 +1,42 @@
+#pragma once
+
+#include <SFML/Graphics/Rect.hpp>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Batch kernels over the arrays of EntityArrays. Each one has a scalar, an
+ * SSE2 and an AVX2 version, the best one supported by the CPU is picked on
+ * the first call. The vector versions do the same operations in the same
+ * order as the scalar one (no FMA), so all of them give bit exact results.
+ **/
+namespace kernels {
+
+enum class Isa : uint8_t { Scalar, SSE2, AVX2 };
+
+// Best instruction set supported by the CPU
+Isa getSupportedIsa();
+// Instruction set used by the kernels
+Isa getIsa();
+// Forces the kernels to use an instruction set (at most the supported one).
+// For comparing the versions
+void setIsa(Isa isa);
+const char *getIsaName(Isa isa);
+
+// Moves every entity "step" towards its destination, at most up to it.
+// Stopped ones and the ones already at their destination stay
+void steer(float *posX, float *posY, const float *destX, const float *destY,
+           const uint8_t *stopped, size_t count, float step);
+
+// pos += dir * step
+void integrate(float *posX, float *posY, const float *dirX, const float *dirY,
+               size_t count, float step);
+
+// Writes the indices of the positions outside of the area (the edges are
+// inside, NaN is outside) to "outside" in increasing order and returns how
+// many there are.
+// "outside" must have room for "count" indices
+size_t findOutside(const float *posX, const float *posY, size_t count,
+                   sf::FloatRect area, uint32_t *outside);
+
+} // namespace kernels
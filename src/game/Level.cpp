@@ -1,6 +1,6 @@
 #include <SFML/Graphics/Rect.hpp>
-#include <SFML/Graphics/RectangleShape.hpp>
 #include <SFML/System/Vector2.hpp>
+#include <algorithm>
 #include <array>
 #include <cstring>
 
@@ -14,34 +14,12 @@ Tile::Tile(float x, float y, float tileSize, TileType type)
     : rect(), type(type) {
 
   this->rect.setSize({tileSize, tileSize});
-  this->rect.setPosition({x, y});
-  this->rect.setFillColor(getColor(type));
-
   this->update(x, y, type);
 }
 
 void Tile::update(float x, float y, TileType type) {
   this->type = type;
   this->rect.setPosition({x, y});
-  this->rect.setFillColor(getColor(type));
-}
-
-sf::Color Tile::getColor(TileType type) {
-  switch (type) {
-  case TileType::Ground:
-    return sf::Color(88, 57, 39);
-  case TileType::Wall:
-    return sf::Color(120, 120, 120);
-  case TileType::PlayerStart:
-    return sf::Color::Green;
-  case TileType::EnemySpawner:
-    return sf::Color(180, 120, 120);
-  case TileType::Base:
-    return sf::Color::Blue;
-  case TileType::Count:
-    UNREACHABLE;
-  }
-  UNREACHABLE;
 }
 
 Level::Level() : tiles{} {
@@ -55,23 +33,6 @@ Level::Level(const MapData &tilemap, bool isServer)
 }
 Level::~Level() { LOG_INFO("Destroying level"); }
 
-void Level::draw(sf::RenderWindow &window) const {
-
-  for (const auto &tile : this->tiles) {
-    window.draw(tile.rect);
-  }
-
-  for (const auto &e : enemies) {
-    e.draw(window);
-  }
-
-  for (const auto &f : fireballs) {
-    f.draw(window);
-  }
-
-  base.draw(window);
-}
-
 void Level::loadLevel(const Level::MapData &data) {
   ASSERT(this->tiles.max_size() == data.tiles.max_size());
 
@@ -80,6 +41,7 @@ void Level::loadLevel(const Level::MapData &data) {
   LOG_DEBUG("Loading level: ", (int)data.id);
 
   sf::Vector2f basePos;
+  std::vector<sf::Vector2u> baseTiles;
 
   for (int i = 0; i < tiles.max_size(); ++i) {
     const int col = i % MAP_WIDTH;
@@ -92,6 +54,7 @@ void Level::loadLevel(const Level::MapData &data) {
     this->base = Base({x * 1.f, y * 1.f});
   }
 
+  ++m_tilesRevision;
   for (int i = 0; i < tiles.max_size(); ++i) {
 
     const int col = i % MAP_WIDTH;
@@ -108,88 +71,95 @@ void Level::loadLevel(const Level::MapData &data) {
       if (this->isServer) {
         spawners.push_back(EnemySpawner(2, 3.f, [this, x, y, basePos]() {
           LOG_DEBUG("Spawning enemy at x: ", x, " y: ", y);
-          enemies.push_back(Enemy({x * 1.f, y * 1.f}, basePos));
+          enemies.insert({x * 1.f, y * 1.f}, basePos);
         }));
       }
     } else if (tile == TileType::Base) {
+      baseTiles.push_back({static_cast<unsigned int>(col),
+                           static_cast<unsigned int>(row)});
       this->base.rect.setPosition(
           {static_cast<float>(x), static_cast<float>(y)});
       this->base.healthbar.update(this->base.rect.getGlobalBounds());
     }
   }
 
+  // Enemies walk to the base around the walls
+  const std::vector<uint8_t> blocked = getBlockedTiles();
+  this->baseField.build(blocked, baseTiles);
+  this->walls.build(blocked);
+
   LOG_DEBUG("Level loaded");
 }
 
 void Level::update(float dt) {
 
+  // Start of the tick - the drawing interpolates from here
+  enemies.savePositions();
+  fireballs.savePositions();
+
   this->base.update(dt);
 
   for (auto &s : spawners) {
     s.update(dt);
   }
 
-  for (auto &e : enemies) {
-    if (base.rect.getGlobalBounds().findIntersection(
-            e.rect.getGlobalBounds())) {
-      // enemy not moving
-      e.update(0);
-    } else {
-      e.update(dt);
-    }
-  }
+  // Enemies at the base (marked by the last updateContacts) don't move
+  enemies.followField(baseField);
+  enemies.update(dt);
+  fireballs.update(dt);
 
-  for (auto &f : fireballs) {
-    f.update(dt);
-  }
+  // Removing fireball that are out of the map (or NaN, the position comes
+  // from the clients). The walls only handle positions in the map
+  fireballs.removeOutside(
+      {{0.f, 0.f}, {MAP_WIDTH * TILE_SIZE, MAP_HEIGHT * TILE_SIZE}});
+  fireballs.removeWallHits(walls);
 
-  // Removing fireball that are out of the map
-  fireballs.resize(std::distance(
-      fireballs.begin(),
-      std::remove_if(fireballs.begin(), fireballs.end(), [](Fireball &f) {
-        sf::Vector2f pos = f.rect.getPosition();
-        return (pos.x < 0 || pos.x > MAP_WIDTH * TILE_SIZE || pos.y < 0 ||
-                pos.y > MAP_WIDTH * TILE_SIZE);
-      })));
+  updateContacts();
 }
 
-constexpr sf::Vector2u
-Level::calculateTileFromPosition(const sf::Vector2f pos) const {
-  const int tx = pos.x / Level::TILE_SIZE;
-  const int ty = pos.y / Level::TILE_SIZE;
+void Level::updateContacts() {
+  m_enemyGrid.clear();
+  for (uint32_t i = 0; i < enemies.size(); ++i)
+    m_enemyGrid.insert(enemies.ids()[i], enemies.getBounds(i));
+  m_enemyGrid.build();
+
+  // Room for a contact of every entity, so the lists only allocate when the
+  // entity arrays grow
+  m_fireballContacts.reserve(fireballs.capacity());
+  m_baseContacts.reserve(enemies.capacity());
+
+  // A fireball only ever hits one enemy so one contact is enough
+  m_fireballContacts.clear();
+  for (uint32_t i = 0; i < fireballs.size(); ++i) {
+    const EntityID enemy = m_enemyGrid.findFirst(
+        fireballs.getBounds(i), [](EntityID) { return true; });
+    if (enemy != 0)
+      m_fireballContacts.push_back({fireballs.ids()[i], enemy});
+  }
 
-  ASSERT(tx >= 0 && tx < Level::MAP_WIDTH && "X Tile position within map");
-  ASSERT(ty >= 0 && ty < Level::MAP_HEIGHT && "Y Tile position within map");
+  m_baseContacts.clear();
+  m_enemyGrid.query(base.rect.getGlobalBounds(),
+                    [this](EntityID enemy, const sf::FloatRect &) {
+                      m_baseContacts.push_back(enemy);
+                      return true;
+                    });
+  std::ranges::sort(m_baseContacts);
 
-  return {static_cast<unsigned int>(pos.x / Level::TILE_SIZE),
-          static_cast<unsigned int>(pos.y / Level::TILE_SIZE)};
+  for (EntityID enemy : m_baseContacts)
+    enemies.stopped[enemies.find(enemy)] = true;
 }
 
 bool Level::canMove(const Player &player, sf::Vector2f posDelta) const {
+  bool hit = false;
+  walls.move(player.rect.getGlobalBounds(), posDelta, hit);
+  return !hit;
+}
 
-  const sf::Vector2f newPos = player.rect.getPosition() + posDelta;
-  const sf::Vector2u newTilePos = calculateTileFromPosition(newPos);
-
-  for (int i = -1; i < 2; ++i) {
-    for (int j = -1; j < 2; ++j) {
-      if (i == 0 && j == 0)
-        continue;
-      sf::Vector2u tilePos = {newTilePos.x + j, newTilePos.y + i};
-      if (tilePos.x < 0 || tilePos.x >= MAP_WIDTH || tilePos.y < 0 ||
-          tilePos.y >= MAP_HEIGHT)
-        continue;
-
-      const Tile &tile = tiles[tilePos.y * MAP_WIDTH + tilePos.x];
-
-      if (tile.type == TileType::Wall &&
-          tile.rect.getGlobalBounds().findIntersection(
-              {newPos, player.rect.getSize()})) {
-        LOG_DEBUG("Collision found with: ", tilePos.x, ", ", tilePos.y);
-        return false;
-      }
-    }
-  }
-  return true;
+bool Level::movePlayer(Player &player, Direction direction) const {
+  bool hit = false;
+  player.rect.move(
+      walls.move(player.rect.getGlobalBounds(), toVec(direction), hit));
+  return !hit;
 }
 
 bool Level::isLevelFinished() const {
@@ -207,29 +177,36 @@ bool Level::isLevelFinished() const {
 
 void Level::handleFireballHits() {
 
-  for (int f = fireballs.size() - 1; f >= 0; --f) {
-
-    for (int e = enemies.size() - 1; e >= 0; --e) {
-      if (enemies[e].rect.getGlobalBounds().findIntersection(
-              fireballs[f].rect.getGlobalBounds())) {
-
-        enemies[e].healthBar.health -= 10;
-        LOG_INFO("Enemy hit. health left: ", enemies[e].healthBar.health);
+  // A fireball hits at most one enemy and disappears
+  for (const Contact &contact : m_fireballContacts) {
+    if (!fireballs.contains(contact.fireball))
+      continue;
+
+    // The enemy of the contact was killed by an earlier fireball. The grid is
+    // still the one of the contacts, it only has to skip the dead enemies
+    EntityID enemyID = contact.enemy;
+    if (!enemies.contains(enemyID)) {
+      enemyID = m_enemyGrid.findFirst(
+          fireballs.getBounds(fireballs.find(contact.fireball)),
+          [this](EntityID id) { return enemies.contains(id); });
+      if (enemyID == 0)
+        continue;
+    }
 
-        if (enemies[e].healthBar.health <= 0)
-          enemies.erase(enemies.begin() + e);
+    const uint32_t enemy = enemies.find(enemyID);
+    enemies.setHealth(enemy, enemies.health[enemy] - 10);
+    LOG_INFO("Enemy hit. health left: ", enemies.health[enemy]);
 
-        fireballs.erase(fireballs.begin() + f);
-        break;
-      }
-    }
+    if (enemies.health[enemy] <= 0)
+      enemies.remove(enemyID);
+    fireballs.remove(contact.fireball);
   }
+  m_fireballContacts.clear();
 }
 
 bool Level::handleBaseHits() {
-  for (const Enemy &enemy : enemies) {
-    if (enemy.rect.getGlobalBounds().findIntersection(
-            this->base.rect.getGlobalBounds())) {
+  for (EntityID enemy : m_baseContacts) {
+    if (enemies.contains(enemy)) {
       base.damage();
       return true;
     }
@@ -237,6 +214,11 @@ bool Level::handleBaseHits() {
   return false;
 }
 
+void Level::spawnFireball(sf::Vector2f pos, sf::Vector2f direction) {
+  fireballs.insert(pos - sf::Vector2f{Fireball::RADIUS, Fireball::RADIUS},
+                   direction);
+}
+
 constexpr std::array<TileType, Level::MAP_WIDTH * Level::MAP_HEIGHT>
 idsToTypes(const std::array<int, Level::MAP_HEIGHT * Level::MAP_HEIGHT> &ids) {
   std::array<TileType, Level::MAP_WIDTH * Level::MAP_HEIGHT> arr{};
@@ -249,6 +231,19 @@ idsToTypes(const std::array<int, Level::MAP_HEIGHT * Level::MAP_HEIGHT> &ids) {
   return arr;
 }
 
+FlowField Level::makeFlowField(std::span<const sf::Vector2u> targets) const {
+  FlowField field(MAP_WIDTH, MAP_HEIGHT, TILE_SIZE);
+  field.build(getBlockedTiles(), targets);
+  return field;
+}
+
+std::vector<uint8_t> Level::getBlockedTiles() const {
+  std::vector<uint8_t> blocked(tiles.size());
+  for (size_t i = 0; i < tiles.size(); ++i)
+    blocked[i] = tiles[i].type == TileType::Wall;
+  return blocked;
+}
+
 sf::Vector2f Level::getPlayerStartPos() const {
 
   int i = 0;
@@ -273,6 +268,41 @@ const Level::MapData &Level::getMapData() const {
   UNREACHABLE;
 }
 
+uint64_t Level::hashMap(const MapData &data) {
+  // FNV-1a
+  uint64_t hash = 0xcbf29ce484222325;
+  auto add = [&hash](uint8_t byte) {
+    hash ^= byte;
+    hash *= 0x100000001b3;
+  };
+
+  add(data.id);
+  for (TileType tile : data.tiles)
+    add(static_cast<uint8_t>(tile));
+
+  return hash;
+}
+
+static std::vector<Level::MapData> &mapCache() {
+  static std::vector<Level::MapData> maps = {Level::Map1Data};
+  return maps;
+}
+
+const std::vector<Level::MapData> &Level::getCachedMaps() { return mapCache(); }
+
+const Level::MapData *Level::findCachedMap(uint8_t id, uint64_t hash) {
+  for (const MapData &map : mapCache()) {
+    if (map.id == id && hashMap(map) == hash)
+      return &map;
+  }
+  return nullptr;
+}
+
+void Level::cacheMap(const MapData &data) {
+  if (findCachedMap(data.id, hashMap(data)) == nullptr)
+    mapCache().push_back(data);
+}
+
 // clang-format off
 const Level::MapData Level::Map1Data = {
    .id = 0,
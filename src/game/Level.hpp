@@ -1,13 +1,24 @@
 #pragma once
 
-#include <SFML/Graphics/RectangleShape.hpp>
-#include <SFML/Graphics/RenderWindow.hpp>
+#include <SFML/Graphics/Color.hpp>
+#include <SFML/Graphics/RenderTarget.hpp>
+#include <array>
 #include <cstdint>
+#include <memory>
+#include <vector>
 
 #include "Base.hpp"
+#include "Body.hpp"
+#include "CollisionMap.hpp"
 #include "Enemy.hpp"
 #include "Fireball.hpp"
+#include "FlowField.hpp"
 #include "Player.hpp"
+#include "SlotMap.hpp"
+#include "SpatialHash.hpp"
+
+class SpriteBatch;
+class TileLayer;
 
 enum class TileType : int {
   //
@@ -29,7 +40,7 @@ struct Tile {
   // Sets the
   void update(float x, float y, TileType type);
 
-  sf::RectangleShape rect;
+  RectBody rect;
   TileType type;
 
   static sf::Color getColor(TileType type);
@@ -57,33 +68,81 @@ struct Level {
   Level(const MapData &initalMap, bool isServer);
   ~Level();
 
-  void draw(sf::RenderWindow &window) const;
+  // alpha in [0, 1] interpolates the moving entities between the last two
+  // simulation ticks
+  void draw(sf::RenderTarget &target, SpriteBatch &batch,
+            float alpha = 1.f) const;
   void loadLevel(const MapData &data);
   void update(float dt);
   bool canMove(const Player &player, sf::Vector2f posDelta) const;
+  // Moves the player one step, or up to the wall in the way. Returns false
+  // when a wall stopped it. The server and the client prediction both move
+  // players through here so they agree
+  bool movePlayer(Player &player, Direction direction) const;
 
   bool isLevelFinished() const;
 
+  // Both consume the contacts found at the end of the last update
   void handleFireballHits();
   bool handleBaseHits();
 
-  constexpr sf::Vector2u
-  calculateTileFromPosition(const sf::Vector2f pos) const;
+  // Spawns a fireball centered on pos with a new entity id
+  void spawnFireball(sf::Vector2f pos, sf::Vector2f direction);
+
+  // Field leading to the target tiles around the walls. For targets other
+  // than the base, e.g. players
+  FlowField makeFlowField(std::span<const sf::Vector2u> targets) const;
 
   sf::Vector2f getPlayerStartPos() const;
   const MapData &getMapData() const;
 
+  // Hash of the map contents. A client only reuses its cached copy of a map
+  // when the hash matches the one of the server
+  static uint64_t hashMap(const MapData &data);
+  // Maps known by this process. Starts with the built-in maps and grows with
+  // the maps received from servers
+  static const std::vector<MapData> &getCachedMaps();
+  static const MapData *findCachedMap(uint8_t id, uint64_t hash);
+  static void cacheMap(const MapData &data);
+
   uint8_t m_currentMapID = 0;
 
   const static MapData Map1Data;
 
   std::array<Tile, MAP_WIDTH * MAP_HEIGHT> tiles;
   std::vector<EnemySpawner> spawners;
-  std::vector<Enemy> enemies;
-  std::vector<Fireball> fireballs;
+  // Ids are unique per kind of entity
+  EnemyArrays enemies;
+  FireballArrays fireballs;
 
   Base base;
+  // Leads the enemies to the base. Built with the map
+  FlowField baseField{MAP_WIDTH, MAP_HEIGHT, TILE_SIZE};
+  // Walls of the map, stop the players and the fireballs
+  CollisionMap walls{MAP_WIDTH, MAP_HEIGHT, TILE_SIZE};
 
 private:
+  struct Contact {
+    EntityID fireball;
+    EntityID enemy;
+  };
+
+  // Finds the fireballs and the base touching enemies through the grid
+  void updateContacts();
+  // One value per tile, non zero for walls
+  std::vector<uint8_t> getBlockedTiles() const;
+
   bool isServer;
+
+  SpatialHash m_enemyGrid{MAP_WIDTH, MAP_HEIGHT, TILE_SIZE};
+  // Fireballs touching an enemy, with the first enemy found
+  std::vector<Contact> m_fireballContacts;
+  // Enemies touching the base. Sorted
+  std::vector<EntityID> m_baseContacts;
+
+  // Bumped whenever the tiles change so the layer gets rebuilt
+  uint32_t m_tilesRevision = 0;
+  // Tiles as one mesh. Made by the first draw - the server never draws.
+  // Shared so the server doesn't need the complete type to destroy it
+  mutable std::shared_ptr<TileLayer> m_tileLayer;
 };
@@ -1,11 +1,11 @@
 #pragma once
 
-#include <SFML/Graphics/RectangleShape.hpp>
-#include <SFML/Graphics/RenderWindow.hpp>
-
 #include "../debug.hpp"
+#include "Body.hpp"
+#include "SlotMap.hpp"
 
 class GameWorld;
+class SpriteBatch;
 
 enum class Direction { Up, Down, Left, Right };
 
@@ -27,11 +27,12 @@ constexpr sf::Vector2f toVec(Direction dir) {
 struct Player {
 
   Player();
-  Player(int32_t id);
+  Player(EntityID id);
 
-  void draw(sf::RenderWindow &window) const;
+  void draw(SpriteBatch &batch) const;
   void update();
 
-  sf::RectangleShape rect;
-  int32_t id;
+  RectBody rect;
+  // Given by the player registry of the server
+  EntityID id;
 };
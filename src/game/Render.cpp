@@ -0,0 +1,94 @@
+// Drawing of the game objects. Kept apart from the simulation so the
+// dedicated server can be built without SFML::Graphics - the objects only
+// store their geometry and the shapes are built here
+#include <SFML/Graphics/RenderTarget.hpp>
+
+#include "../debug.hpp"
+#include "Base.hpp"
+#include "Enemy.hpp"
+#include "Fireball.hpp"
+#include "HealthBar.hpp"
+#include "Level.hpp"
+#include "Player.hpp"
+#include "SpriteBatch.hpp"
+#include "TileLayer.hpp"
+
+sf::Color Tile::getColor(TileType type) {
+  switch (type) {
+  case TileType::Ground:
+    return sf::Color(88, 57, 39);
+  case TileType::Wall:
+    return sf::Color(120, 120, 120);
+  case TileType::PlayerStart:
+    return sf::Color::Green;
+  case TileType::EnemySpawner:
+    return sf::Color(180, 120, 120);
+  case TileType::Base:
+    return sf::Color::Blue;
+  case TileType::Count:
+    UNREACHABLE;
+  }
+  UNREACHABLE;
+}
+
+void HealthBar::draw(SpriteBatch &batch) const {
+  batch.addRect(bounds, sf::Color::Red);
+  batch.addRect({bounds.position, {fillWidth(health, maxHealth), HEIGHT}},
+                sf::Color::Green);
+}
+
+void Player::draw(SpriteBatch &batch) const {
+  batch.addRect(rect.getGlobalBounds(), sf::Color::Red);
+  DEBUG_ONLY(batch.addOutline(rect.getGlobalBounds(), 1.f, sf::Color::Red));
+}
+
+void EnemyArrays::draw(SpriteBatch &batch, float alpha) const {
+  // Where HealthBar::update puts the bar for a parent of RADIUS by RADIUS
+  const sf::Vector2f barOffset = {Enemy::RADIUS / 2 - HealthBar::MAX_WIDTH / 2,
+                                  -HealthBar::HEIGHT};
+  const sf::Vector2f barSize = {HealthBar::MAX_WIDTH, HealthBar::HEIGHT};
+
+  for (uint32_t i = 0; i < size(); ++i) {
+    const sf::Vector2f pos = getInterpolatedPosition(i, alpha);
+    batch.addCircle(pos, Enemy::RADIUS, sf::Color::Magenta);
+
+    // The bar follows the interpolated position too, its fill is only
+    // worked out when the health changes
+    const sf::Vector2f barPos = pos + barOffset;
+    batch.addRect({barPos, barSize}, sf::Color::Red);
+    batch.addRect({barPos, {barWidth[i], HealthBar::HEIGHT}},
+                  sf::Color::Green);
+  }
+}
+
+void FireballArrays::draw(SpriteBatch &batch, float alpha) const {
+  for (uint32_t i = 0; i < size(); ++i) {
+    const sf::Vector2f pos = getInterpolatedPosition(i, alpha);
+    batch.addCircle(pos, Fireball::RADIUS, sf::Color::White);
+    DEBUG_ONLY(batch.addOutline(
+        {pos, {Fireball::RADIUS * 2, Fireball::RADIUS * 2}}, 1.f,
+        sf::Color::Red));
+  }
+}
+
+void Base::draw(SpriteBatch &batch) const {
+  batch.addRect(rect.getGlobalBounds(), sf::Color::Blue);
+  this->healthbar.draw(batch);
+}
+
+void Level::draw(sf::RenderTarget &target, SpriteBatch &batch,
+                 float alpha) const {
+
+  // The map doesn't change between frames, it has its own mesh. Drawn right
+  // away, everything else goes on top of it with the batch
+  if (!m_tileLayer)
+    m_tileLayer = std::make_shared<TileLayer>();
+  if (m_tileLayer->getRevision() != m_tilesRevision)
+    m_tileLayer->build(this->tiles, m_tilesRevision);
+  m_tileLayer->draw(target);
+
+  enemies.draw(batch, alpha);
+  fireballs.draw(batch, alpha);
+
+  base.draw(batch);
+}
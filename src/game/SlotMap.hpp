@@ -0,0 +1,246 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "../debug.hpp"
+
+// Stable id of an entity. The low GENERATION_BITS are the generation of the
+// slot, the rest is the index of the slot. Ids of removed entities never
+// match a later entity in the same slot (until the generation wraps).
+// 0 is never a valid id
+typedef uint32_t EntityID;
+
+/**
+ * Maps generational ids to indices of densely stored values. The values live
+ * in arrays kept by the user (one array or one per field) - the table only
+ * tells where. Removal expects the last value to be moved into the hole, so
+ * the order of the values isn't the order of insertion.
+ **/
+class SlotTable {
+public:
+  static constexpr uint32_t GENERATION_BITS = 8;
+  static constexpr uint32_t MAX_SLOTS = 1u << (32 - GENERATION_BITS);
+
+  static constexpr uint32_t indexOf(EntityID id) {
+    return id >> GENERATION_BITS;
+  }
+  static constexpr uint32_t generationOf(EntityID id) {
+    return id & ((1u << GENERATION_BITS) - 1);
+  }
+  static constexpr EntityID makeID(uint32_t index, uint32_t generation) {
+    return (index << GENERATION_BITS) | generation;
+  }
+
+  // Id of a new value. It goes at the end of the arrays
+  EntityID insert() {
+    uint32_t index = 0;
+    while (!m_freeSlots.empty() && m_slots[m_freeSlots.back()].occupied)
+      popFreeSlot(); // Taken by "assign" while it was free
+
+    if (m_freeSlots.empty()) {
+      ASSERT(m_slots.size() < MAX_SLOTS);
+      index = static_cast<uint32_t>(m_slots.size());
+      m_slots.push_back({});
+    } else {
+      index = popFreeSlot();
+    }
+
+    const EntityID id = makeID(index, m_slots[index].generation);
+    place(index, id);
+    return id;
+  }
+
+  /**
+   * Takes an id given by someone else (the client mirrors the entities of
+   * the server). Returns where its value is. "placed" is true when the slot
+   * was free - the value goes at the end of the arrays. Otherwise whatever
+   * was in the slot is to be replaced
+   **/
+  uint32_t assign(EntityID id, bool &placed) {
+    const uint32_t index = indexOf(id);
+    if (index >= m_slots.size()) {
+      const auto first = static_cast<uint32_t>(m_slots.size());
+      m_slots.resize(index + 1);
+      // The ones skipped over are free
+      for (uint32_t i = first; i < index; ++i)
+        pushFreeSlot(i);
+    }
+
+    Slot &slot = m_slots[index];
+    slot.generation = generationOf(id);
+    placed = !slot.occupied;
+    if (placed)
+      place(index, id);
+    else
+      m_ids[slot.denseIndex] = id;
+    return slot.denseIndex;
+  }
+
+  // Returns where the value was - the last value has to be moved there and
+  // the arrays shrunk by one. nullopt when the id is stale
+  std::optional<uint32_t> remove(EntityID id) {
+    if (!contains(id))
+      return std::nullopt;
+
+    Slot &slot = m_slots[indexOf(id)];
+    const uint32_t hole = slot.denseIndex;
+    m_ids[hole] = m_ids.back();
+    m_slots[indexOf(m_ids[hole])].denseIndex = hole;
+    m_ids.pop_back();
+
+    slot.occupied = false;
+    slot.generation = nextGeneration(slot.generation);
+    // Still listed when "assign" took it while it was free
+    if (!slot.listed)
+      pushFreeSlot(indexOf(id));
+    return hole;
+  }
+
+  bool contains(EntityID id) const {
+    const uint32_t index = indexOf(id);
+    return index < m_slots.size() && m_slots[index].occupied &&
+           m_slots[index].generation == generationOf(id);
+  }
+
+  // Position of the value in the arrays. The id must be valid
+  uint32_t find(EntityID id) const {
+    ASSERT(contains(id));
+    return m_slots[indexOf(id)].denseIndex;
+  }
+
+  // Id of every value, in the order of the arrays
+  const std::vector<EntityID> &getIDs() const { return m_ids; }
+  size_t size() const { return m_ids.size(); }
+
+  size_t getSlotCount() const { return m_slots.size(); }
+
+  // Room for n values in n slots without allocating
+  void reserve(size_t n) {
+    m_slots.reserve(n);
+    m_ids.reserve(n);
+    m_freeSlots.reserve(n);
+  }
+
+private:
+  struct Slot {
+    uint32_t denseIndex = 0;
+    // Starts at 1 so no id is 0
+    uint32_t generation = 1;
+    bool occupied = false;
+    // In m_freeSlots
+    bool listed = false;
+  };
+
+  static constexpr uint32_t nextGeneration(uint32_t generation) {
+    const uint32_t next = (generation + 1) & ((1u << GENERATION_BITS) - 1);
+    return next == 0 ? 1 : next;
+  }
+
+  // A slot is listed once at most, so there are never more free slots than
+  // slots
+  void pushFreeSlot(uint32_t index) {
+    m_slots[index].listed = true;
+    m_freeSlots.push_back(index);
+  }
+  uint32_t popFreeSlot() {
+    const uint32_t index = m_freeSlots.back();
+    m_freeSlots.pop_back();
+    m_slots[index].listed = false;
+    return index;
+  }
+
+  void place(uint32_t index, EntityID id) {
+    Slot &slot = m_slots[index];
+    slot.occupied = true;
+    slot.denseIndex = static_cast<uint32_t>(m_ids.size());
+    m_ids.push_back(id);
+  }
+
+  std::vector<Slot> m_slots;
+  std::vector<EntityID> m_ids;
+  // Unoccupied slots. May hold slots taken by "assign" in the meantime
+  std::vector<uint32_t> m_freeSlots;
+};
+
+/**
+ * Generational slot map. Values are stored densely (iteration is a walk over
+ * a vector) and the ids point at slots which point into the dense array, so
+ * insert, remove and find are O(1) and ids stay valid when other values move.
+ * Removal moves the last value into the hole - the order of iteration isn't
+ * the order of insertion.
+ *
+ * T must have an "EntityID id" member - it is set by insert.
+ **/
+template <typename T> class SlotMap {
+public:
+  // Returns the stored value with its new id
+  T &insert(T value) {
+    value.id = m_table.insert();
+    m_dense.push_back(std::move(value));
+    return m_dense.back();
+  }
+
+  /**
+   * Stores the value under an id given by someone else (the client mirrors
+   * the entities of the server). Whatever was in the slot is replaced
+   **/
+  T &assign(EntityID id, T value) {
+    bool placed = false;
+    const uint32_t index = m_table.assign(id, placed);
+    value.id = id;
+    if (placed)
+      return m_dense.emplace_back(std::move(value));
+    m_dense[index] = std::move(value);
+    return m_dense[index];
+  }
+
+  // Returns false when the id is stale
+  bool remove(EntityID id) {
+    const auto hole = m_table.remove(id);
+    if (!hole)
+      return false;
+    if (*hole != m_dense.size() - 1)
+      m_dense[*hole] = std::move(m_dense.back());
+    m_dense.pop_back();
+    return true;
+  }
+
+  // Removes every value matching the predicate
+  template <typename F> void removeIf(F &&predicate) {
+    for (size_t i = m_dense.size(); i-- > 0;) {
+      if (predicate(m_dense[i]))
+        remove(m_dense[i].id);
+    }
+  }
+
+  bool contains(EntityID id) const { return m_table.contains(id); }
+
+  T *find(EntityID id) {
+    return contains(id) ? &m_dense[m_table.find(id)] : nullptr;
+  }
+  const T *find(EntityID id) const {
+    return contains(id) ? &m_dense[m_table.find(id)] : nullptr;
+  }
+
+  // Keeps the generations so the old ids stay stale
+  void clear() {
+    while (!m_dense.empty())
+      remove(m_dense.back().id);
+  }
+
+  size_t size() const { return m_dense.size(); }
+  bool empty() const { return m_dense.empty(); }
+  void reserve(size_t n) { m_dense.reserve(n); }
+
+  auto begin() { return m_dense.begin(); }
+  auto end() { return m_dense.end(); }
+  auto begin() const { return m_dense.begin(); }
+  auto end() const { return m_dense.end(); }
+
+private:
+  std::vector<T> m_dense;
+  SlotTable m_table;
+};
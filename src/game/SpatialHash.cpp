@@ -0,0 +1,67 @@
+#include "SpatialHash.hpp"
+#include "../debug.hpp"
+#include <algorithm>
+#include <limits>
+
+SpatialHash::SpatialHash(uint32_t width, uint32_t height, float cellSize)
+    : m_width(width), m_height(height), m_cellSize(cellSize),
+      m_inverseCellSize(1.f / cellSize), m_cellStart(width * height + 1, 0) {
+  ASSERT(width <= std::numeric_limits<uint16_t>::max() &&
+         height <= std::numeric_limits<uint16_t>::max() &&
+         "Cells of an entry fit 16 bits");
+}
+
+void SpatialHash::clear() { m_pending.clear(); }
+
+void SpatialHash::insert(EntityID id, sf::FloatRect bounds) {
+  const CellRange cells = cellsOf(bounds);
+  m_pending.push_back({id, bounds, static_cast<uint16_t>(cells.minX),
+                       static_cast<uint16_t>(cells.minY),
+                       static_cast<uint16_t>(cells.maxX),
+                       static_cast<uint16_t>(cells.maxY)});
+}
+
+SpatialHash::CellRange SpatialHash::cellsOf(sf::FloatRect bounds) const {
+  // Truncating is flooring once the negative values are clamped to 0.
+  // std::floor is a library call on the baseline x86-64 target. NaN ends up
+  // in the first cell
+  auto cell = [this](float coordinate, uint32_t count) {
+    const float c = coordinate * m_inverseCellSize;
+    if (!(c >= 0.f))
+      return 0u;
+    return static_cast<uint32_t>(std::min(c, count - 1.f));
+  };
+
+  return {.minX = cell(bounds.position.x, m_width),
+          .minY = cell(bounds.position.y, m_height),
+          .maxX = cell(bounds.position.x + bounds.size.x, m_width),
+          .maxY = cell(bounds.position.y + bounds.size.y, m_height)};
+}
+
+void SpatialHash::build() {
+  std::fill(m_cellStart.begin(), m_cellStart.end(), 0);
+
+  // Counting the entries of every cell (shifted by one for the prefix sum)
+  for (const Entry &entry : m_pending) {
+    for (uint32_t y = entry.minY; y <= entry.maxY; ++y)
+      for (uint32_t x = entry.minX; x <= entry.maxX; ++x)
+        ++m_cellStart[y * m_width + x + 1];
+  }
+
+  for (size_t c = 1; c < m_cellStart.size(); ++c)
+    m_cellStart[c] += m_cellStart[c - 1];
+
+  m_entries.resize(m_cellStart.back());
+
+  // Filling every cell from its start. The starts are shifted while filling
+  // and restored after
+  for (const Entry &entry : m_pending) {
+    for (uint32_t y = entry.minY; y <= entry.maxY; ++y)
+      for (uint32_t x = entry.minX; x <= entry.maxX; ++x)
+        m_entries[m_cellStart[y * m_width + x]++] = entry;
+  }
+
+  for (size_t c = m_cellStart.size() - 1; c > 0; --c)
+    m_cellStart[c] = m_cellStart[c - 1];
+  m_cellStart[0] = 0;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <SFML/Graphics/Rect.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "SlotMap.hpp"
+
+/**
+ * Broad phase for the collisions: a uniform grid of cells (the tiles of the
+ * level) with the bounds of every inserted entity stored in each cell it
+ * overlaps. Bounds outside of the grid are clamped into the border cells.
+ *
+ * Filled with insert and then build, which sorts the entries by cell into one
+ * array (counting sort) so a cell is a contiguous range. Rebuilt every tick -
+ * the arrays keep their capacity so it doesn't allocate once warmed up.
+ **/
+class SpatialHash {
+public:
+  SpatialHash() = default;
+  SpatialHash(uint32_t width, uint32_t height, float cellSize);
+
+  void clear();
+  void insert(EntityID id, sf::FloatRect bounds);
+  void build();
+
+  // Calls visit(id, bounds) once for every entity overlapping the bounds
+  // until it returns false. Must be built
+  template <typename F> void query(sf::FloatRect bounds, F &&visit) const;
+
+  // First entity overlapping the bounds that matches the predicate. 0 when
+  // there is none
+  template <typename F>
+  EntityID findFirst(sf::FloatRect bounds, F &&predicate) const;
+
+  size_t size() const { return m_pending.size(); }
+
+private:
+  struct CellRange {
+    uint32_t minX, minY, maxX, maxY;
+  };
+  struct Entry {
+    EntityID id;
+    sf::FloatRect bounds;
+    // Cells of the entity, so build doesn't work them out again
+    uint16_t minX, minY, maxX, maxY;
+  };
+
+  CellRange cellsOf(sf::FloatRect bounds) const;
+
+  uint32_t m_width = 0;
+  uint32_t m_height = 0;
+  float m_cellSize = 1.f;
+  float m_inverseCellSize = 1.f;
+
+  std::vector<Entry> m_pending;
+  // Entries of cell c are m_entries[m_cellStart[c], m_cellStart[c + 1])
+  std::vector<uint32_t> m_cellStart;
+  std::vector<Entry> m_entries;
+};
+
+template <typename F>
+void SpatialHash::query(sf::FloatRect bounds, F &&visit) const {
+  const CellRange cells = cellsOf(bounds);
+
+  for (uint32_t y = cells.minY; y <= cells.maxY; ++y) {
+    for (uint32_t x = cells.minX; x <= cells.maxX; ++x) {
+      const uint32_t cell = y * m_width + x;
+
+      for (uint32_t i = m_cellStart[cell]; i < m_cellStart[cell + 1]; ++i) {
+        const Entry &entry = m_entries[i];
+
+        // A pair shares up to 4 cells. It's only reported by the one with the
+        // top left corner of the overlap - the first cell both are in
+        if (x != std::max<uint32_t>(entry.minX, cells.minX) ||
+            y != std::max<uint32_t>(entry.minY, cells.minY))
+          continue;
+
+        if (entry.bounds.findIntersection(bounds) &&
+            !visit(entry.id, entry.bounds))
+          return;
+      }
+    }
+  }
+}
+
+template <typename F>
+EntityID SpatialHash::findFirst(sf::FloatRect bounds, F &&predicate) const {
+  EntityID found = 0;
+  query(bounds, [&](EntityID id, const sf::FloatRect &) {
+    if (predicate(id))
+      found = id;
+    return found == 0;
+  });
+  return found;
+}
@@ -0,0 +1,72 @@
+#include "SpriteBatch.hpp"
+#include <cmath>
+#include <numbers>
+
+namespace {
+
+// Nothing is textured, the texture coordinates stay zero
+sf::Vertex vertex(sf::Vector2f position, sf::Color color) {
+  return {position, color, {}};
+}
+
+} // namespace
+
+SpriteBatch::SpriteBatch() {
+  // Same points as sf::CircleShape, starting at the top
+  for (size_t i = 0; i < CIRCLE_POINTS; ++i) {
+    const float angle = i * 2 * std::numbers::pi_v<float> / CIRCLE_POINTS -
+                        std::numbers::pi_v<float> / 2;
+    m_circle[i] = {1.f + std::cos(angle), 1.f + std::sin(angle)};
+  }
+}
+
+void SpriteBatch::addRect(sf::FloatRect rect, sf::Color color) {
+  const sf::Vector2f topLeft = rect.position;
+  const sf::Vector2f topRight = topLeft + sf::Vector2f{rect.size.x, 0.f};
+  const sf::Vector2f bottomLeft = topLeft + sf::Vector2f{0.f, rect.size.y};
+  const sf::Vector2f bottomRight = topLeft + rect.size;
+
+  const size_t first = m_vertices.size();
+  m_vertices.resize(first + 6);
+  sf::Vertex *quad = &m_vertices[first];
+  quad[0] = vertex(topLeft, color);
+  quad[1] = vertex(topRight, color);
+  quad[2] = vertex(bottomLeft, color);
+  quad[3] = vertex(bottomLeft, color);
+  quad[4] = vertex(topRight, color);
+  quad[5] = vertex(bottomRight, color);
+}
+
+void SpriteBatch::addCircle(sf::Vector2f pos, float radius, sf::Color color) {
+  const sf::Vector2f center = pos + sf::Vector2f{radius, radius};
+
+  const size_t first = m_vertices.size();
+  m_vertices.resize(first + CIRCLE_POINTS * 3);
+  sf::Vertex *triangle = &m_vertices[first];
+  for (size_t i = 0; i < CIRCLE_POINTS; ++i, triangle += 3) {
+    const sf::Vector2f &next = m_circle[i + 1 == CIRCLE_POINTS ? 0 : i + 1];
+    triangle[0] = vertex(center, color);
+    triangle[1] = vertex(pos + m_circle[i] * radius, color);
+    triangle[2] = vertex(pos + next * radius, color);
+  }
+}
+
+void SpriteBatch::addOutline(sf::FloatRect rect, float thickness,
+                             sf::Color color) {
+  const sf::Vector2f pos = rect.position;
+  const sf::Vector2f size = rect.size;
+  addRect({pos, {size.x, thickness}}, color);
+  addRect({{pos.x, pos.y + size.y - thickness}, {size.x, thickness}}, color);
+  addRect({{pos.x, pos.y + thickness}, {thickness, size.y - 2 * thickness}},
+          color);
+  addRect({{pos.x + size.x - thickness, pos.y + thickness},
+           {thickness, size.y - 2 * thickness}},
+          color);
+}
+
+void SpriteBatch::flush(sf::RenderTarget &target) {
+  if (!m_vertices.empty())
+    target.draw(m_vertices.data(), m_vertices.size(),
+                sf::PrimitiveType::Triangles);
+  m_vertices.clear();
+}
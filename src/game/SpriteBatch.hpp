@@ -0,0 +1,43 @@
+#pragma once
+
+#include <SFML/Graphics/Color.hpp>
+#include <SFML/Graphics/Rect.hpp>
+#include <SFML/Graphics/RenderTarget.hpp>
+#include <SFML/Graphics/Vertex.hpp>
+#include <array>
+#include <vector>
+
+/**
+ * Collects the shapes of a frame as triangles and draws them all with one
+ * call. Nothing is textured, so one array holds every shape and the order of
+ * the adds is the order they are drawn in.
+ *
+ * The vertices are kept between frames, so after the first few frames
+ * nothing is allocated.
+ *
+ * Client only, the dedicated server never draws.
+ **/
+class SpriteBatch {
+public:
+  // Points on the edge of a circle. The entities are a few pixels wide,
+  // more points don't make them any rounder
+  static constexpr size_t CIRCLE_POINTS = 16;
+
+  SpriteBatch();
+
+  void addRect(sf::FloatRect rect, sf::Color color);
+  // Like sf::CircleShape "pos" is the top left corner of the bounding box
+  void addCircle(sf::Vector2f pos, float radius, sf::Color color);
+  // Border of the rect, drawn inside it
+  void addOutline(sf::FloatRect rect, float thickness, sf::Color color);
+
+  // Draws everything added since the last flush
+  void flush(sf::RenderTarget &target);
+
+  size_t getVertexCount() const { return m_vertices.size(); }
+
+private:
+  std::vector<sf::Vertex> m_vertices;
+  // Points of the unit circle centered at (1, 1)
+  std::array<sf::Vector2f, CIRCLE_POINTS> m_circle;
+};
@@ -0,0 +1,60 @@
+#include "TileLayer.hpp"
+#include "../logging.hpp"
+#include "Level.hpp"
+
+TileLayer::TileLayer()
+    : m_vertices(sf::PrimitiveType::Triangles),
+      m_buffer(sf::PrimitiveType::Triangles, sf::VertexBuffer::Usage::Static),
+      m_useBuffer(sf::VertexBuffer::isAvailable()) {
+  if (!m_useBuffer)
+    LOG_INFO("Vertex buffers not available, tiles are drawn from memory");
+}
+
+void TileLayer::build(std::span<const Tile> tiles, uint32_t revision) {
+  m_revision = revision;
+
+  m_vertices.resize(tiles.size() * 6);
+  for (size_t i = 0; i < tiles.size(); ++i) {
+    const sf::FloatRect bounds = tiles[i].rect.getGlobalBounds();
+    const sf::Color color = Tile::getColor(tiles[i].type);
+
+    const sf::Vector2f topLeft = bounds.position;
+    const sf::Vector2f topRight = topLeft + sf::Vector2f{bounds.size.x, 0.f};
+    const sf::Vector2f bottomLeft = topLeft + sf::Vector2f{0.f, bounds.size.y};
+    const sf::Vector2f bottomRight = topLeft + bounds.size;
+
+    // Untextured, the texture coordinates stay zero
+    auto vertex = [color](sf::Vector2f position) {
+      return sf::Vertex{position, color, {}};
+    };
+    sf::Vertex *quad = &m_vertices[i * 6];
+    quad[0] = vertex(topLeft);
+    quad[1] = vertex(topRight);
+    quad[2] = vertex(bottomLeft);
+    quad[3] = vertex(bottomLeft);
+    quad[4] = vertex(topRight);
+    quad[5] = vertex(bottomRight);
+  }
+
+  if (!m_useBuffer)
+    return;
+
+  // The array stays as the fallback when the upload fails
+  if (m_buffer.getVertexCount() != m_vertices.getVertexCount() &&
+      !m_buffer.create(m_vertices.getVertexCount())) {
+    LOG_ERROR("Couldn't create the tile vertex buffer");
+    m_useBuffer = false;
+    return;
+  }
+  if (!m_buffer.update(&m_vertices[0])) {
+    LOG_ERROR("Couldn't upload the tiles to the vertex buffer");
+    m_useBuffer = false;
+  }
+}
+
+void TileLayer::draw(sf::RenderTarget &target) const {
+  if (m_useBuffer)
+    target.draw(m_buffer);
+  else
+    target.draw(m_vertices);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <SFML/Graphics/RenderTarget.hpp>
+#include <SFML/Graphics/VertexArray.hpp>
+#include <SFML/Graphics/VertexBuffer.hpp>
+#include <cstdint>
+#include <span>
+
+struct Tile;
+
+/**
+ * All the tiles of a map as one mesh (two triangles per tile), drawn with a
+ * single draw call. Kept in a vertex buffer on the GPU when the driver
+ * supports them, in a vertex array otherwise. Only rebuilt when the tiles
+ * change - the level bumps its revision then.
+ *
+ * Client only, the dedicated server never draws.
+ **/
+class TileLayer {
+public:
+  TileLayer();
+
+  void build(std::span<const Tile> tiles, uint32_t revision);
+  void draw(sf::RenderTarget &target) const;
+
+  // Revision of the tiles it was built from
+  uint32_t getRevision() const { return m_revision; }
+
+private:
+  sf::VertexArray m_vertices;
+  sf::VertexBuffer m_buffer;
+  bool m_useBuffer;
+  uint32_t m_revision = 0;
+};
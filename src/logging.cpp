@@ -0,0 +1,320 @@
+#include "logging.hpp"
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace logging {
+namespace {
+
+using internal::ArgType;
+using internal::MAX_RECORD_BYTES;
+
+constexpr size_t RING_BYTES = 64 * 1024;
+static_assert(std::has_single_bit(RING_BYTES));
+static_assert(MAX_RECORD_BYTES <= RING_BYTES);
+
+// How long the background thread sleeps when there was nothing to write
+constexpr auto IDLE_SLEEP = std::chrono::milliseconds(1);
+
+/**
+ * Byte ring of one thread. The owning thread is the only producer and the
+ * background thread the only consumer, so the two positions are all the
+ * synchronization there is. Positions only grow, the index into the buffer
+ * is the position modulo its size.
+ **/
+struct Ring {
+  // Copies the record in. False when there isn't room for it
+  bool tryPush(const std::byte *record, size_t size) {
+    const size_t head = m_head.load(std::memory_order_relaxed);
+    if (head + size - m_cachedTail > RING_BYTES) {
+      // Only look at the consumer's side when the old value says it's full
+      m_cachedTail = m_tail.load(std::memory_order_acquire);
+      if (head + size - m_cachedTail > RING_BYTES)
+        return false;
+    }
+    copyIn(head, record, size);
+    m_head.store(head + size, std::memory_order_release);
+    return true;
+  }
+
+  // Calls f(record, size) for every record pushed so far
+  template <typename F> bool drain(F &&f) {
+    const size_t head = m_head.load(std::memory_order_acquire);
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail == head)
+      return false;
+
+    std::byte record[MAX_RECORD_BYTES];
+    while (tail != head) {
+      uint16_t size = 0;
+      copyOut(tail, reinterpret_cast<std::byte *>(&size), sizeof(size));
+      copyOut(tail, record, size);
+      f(record, size);
+      tail += size;
+    }
+    m_tail.store(tail, std::memory_order_release);
+    return true;
+  }
+
+  // Set when the owning thread exits. Removed once it's drained
+  std::atomic<bool> closed = false;
+
+private:
+  void copyIn(size_t position, const std::byte *src, size_t size) {
+    const size_t index = position & (RING_BYTES - 1);
+    const size_t first = std::min(size, RING_BYTES - index);
+    std::memcpy(m_data + index, src, first);
+    std::memcpy(m_data, src + first, size - first);
+  }
+
+  void copyOut(size_t position, std::byte *dest, size_t size) const {
+    const size_t index = position & (RING_BYTES - 1);
+    const size_t first = std::min(size, RING_BYTES - index);
+    std::memcpy(dest, m_data + index, first);
+    std::memcpy(dest + first, m_data, size - first);
+  }
+
+  // Separate cache lines so the two threads don't fight over them
+  alignas(64) std::atomic<size_t> m_head = 0;
+  size_t m_cachedTail = 0;
+  alignas(64) std::atomic<size_t> m_tail = 0;
+  alignas(64) std::byte m_data[RING_BYTES];
+};
+
+void appendPrefix(std::string &out, Level level) {
+  switch (level) {
+  case Level::Debug:
+    out += "[\033[33mDEBUG\033[0m] ";
+    break;
+  case Level::Info:
+    out += "[\033[34mINFO\033[0m] ";
+    break;
+  case Level::Error:
+    out += "[\033[31mERROR\033[0m] ";
+    break;
+  }
+}
+
+template <typename T> void appendNumber(std::string &out, T value) {
+  char buffer[32];
+  std::to_chars_result result;
+  if constexpr (std::is_floating_point_v<T>)
+    // Same as the default formatting of std::cout (%g)
+    result = std::to_chars(buffer, buffer + sizeof(buffer), value,
+                           std::chars_format::general, 6);
+  else
+    result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+  out.append(buffer, result.ptr);
+}
+
+// Turns the record into the line std::cout used to print
+void format(std::string &out, const std::byte *record, size_t size) {
+  size_t offset = sizeof(uint16_t);
+  auto read = [&]<typename T>(T &value) {
+    std::memcpy(&value, record + offset, sizeof(T));
+    offset += sizeof(T);
+  };
+
+  Level level;
+  read(level);
+  appendPrefix(out, level);
+
+  while (offset < size) {
+    ArgType type;
+    read(type);
+    switch (type) {
+    case ArgType::Int: {
+      int64_t value;
+      read(value);
+      appendNumber(out, value);
+      break;
+    }
+    case ArgType::Uint: {
+      uint64_t value;
+      read(value);
+      appendNumber(out, value);
+      break;
+    }
+    case ArgType::Float: {
+      double value;
+      read(value);
+      appendNumber(out, value);
+      break;
+    }
+    case ArgType::Char: {
+      char value;
+      read(value);
+      out += value;
+      break;
+    }
+    case ArgType::String: {
+      uint16_t length;
+      read(length);
+      out.append(reinterpret_cast<const char *>(record + offset), length);
+      offset += length;
+      break;
+    }
+    }
+  }
+  out += '\n';
+}
+
+// Used when the background thread is gone (static destruction) or the
+// thread's ring is (thread exit)
+void writeNow(const std::byte *record, size_t size) {
+  std::string line;
+  format(line, record, size);
+  std::fwrite(line.data(), 1, line.size(), stdout);
+  std::fflush(stdout);
+}
+
+enum class State : uint8_t { NotStarted, Running, Stopped };
+constinit std::atomic<State> g_state = State::NotStarted;
+
+class Logger {
+public:
+  Logger() : m_thread([this](std::stop_token stop) { run(stop); }) {
+    g_state.store(State::Running);
+  }
+
+  ~Logger() {
+    // Anything logged from now on is written right away
+    g_state.store(State::Stopped);
+    m_thread.request_stop();
+    m_thread.join();
+  }
+
+  static Logger &get() {
+    static Logger logger;
+    return logger;
+  }
+
+  Ring *addRing() {
+    std::lock_guard lock(m_ringsMutex);
+    return m_rings.emplace_back(std::make_unique<Ring>()).get();
+  }
+
+  void push(Ring &ring, const std::byte *record, size_t size) {
+    while (!ring.tryPush(record, size)) {
+      if (m_policy.load(std::memory_order_relaxed) == OverflowPolicy::Drop) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      std::this_thread::yield();
+    }
+  }
+
+  void setPolicy(OverflowPolicy policy) { m_policy.store(policy); }
+
+  void flush() {
+    // The second pass from now started after everything was pushed
+    const uint64_t target = m_passes.load(std::memory_order_acquire) + 2;
+    while (m_passes.load(std::memory_order_acquire) < target)
+      std::this_thread::yield();
+  }
+
+private:
+  void run(std::stop_token stop) {
+    while (!stop.stop_requested()) {
+      if (!drain())
+        std::this_thread::sleep_for(IDLE_SLEEP);
+    }
+    drain();
+  }
+
+  // Formats and writes everything in the rings. False when they were empty
+  bool drain() {
+    bool any = false;
+    {
+      std::lock_guard lock(m_ringsMutex);
+      for (size_t i = 0; i < m_rings.size();) {
+        // Read before draining - a closed ring gets nothing new afterwards
+        const bool closed = m_rings[i]->closed.load(std::memory_order_acquire);
+        any |= m_rings[i]->drain([this](const std::byte *record, size_t size) {
+          format(m_output, record, size);
+        });
+
+        if (closed) {
+          m_rings[i] = std::move(m_rings.back());
+          m_rings.pop_back();
+        } else {
+          ++i;
+        }
+      }
+    }
+
+    if (const uint64_t dropped = m_dropped.exchange(0)) {
+      appendPrefix(m_output, Level::Error);
+      m_output += "Log is full, dropped ";
+      appendNumber(m_output, dropped);
+      m_output += " messages\n";
+    }
+
+    if (!m_output.empty()) {
+      std::fwrite(m_output.data(), 1, m_output.size(), stdout);
+      std::fflush(stdout);
+      m_output.clear();
+    }
+    m_passes.fetch_add(1, std::memory_order_release);
+    return any;
+  }
+
+  std::mutex m_ringsMutex;
+  std::vector<std::unique_ptr<Ring>> m_rings;
+  std::atomic<OverflowPolicy> m_policy = OverflowPolicy::Block;
+  std::atomic<uint64_t> m_dropped = 0;
+  // Drains done by the background thread
+  std::atomic<uint64_t> m_passes = 0;
+  // Only touched by the background thread
+  std::string m_output;
+  // Last so it starts after the rest is constructed
+  std::jthread m_thread;
+};
+
+// Ring of the calling thread, created by its first message
+struct RingHandle {
+  ~RingHandle();
+  Ring *ring = nullptr;
+};
+
+// Trivially destructible, so it can still be read after the handle is gone
+thread_local bool t_exited = false;
+thread_local RingHandle t_handle;
+
+RingHandle::~RingHandle() {
+  t_exited = true;
+  if (ring != nullptr && g_state.load() == State::Running)
+    ring->closed.store(true, std::memory_order_release);
+}
+
+} // namespace
+
+void setOverflowPolicy(OverflowPolicy policy) {
+  Logger::get().setPolicy(policy);
+}
+
+void flush() {
+  if (g_state.load() == State::Running)
+    Logger::get().flush();
+}
+
+namespace internal {
+
+void push(const std::byte *record, size_t size) {
+  if (t_exited || g_state.load(std::memory_order_relaxed) == State::Stopped)
+    return writeNow(record, size);
+
+  Logger &logger = Logger::get();
+  if (t_handle.ring == nullptr)
+    t_handle.ring = logger.addRing();
+  logger.push(*t_handle.ring, record, size);
+}
+
+} // namespace internal
+} // namespace logging
@@ -1,23 +1,161 @@
 #pragma once
-#include <cstdio>
-#include <iostream>
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+/**
+ * Asynchronous logging. The calling thread only packs the level and the
+ * arguments into a small binary record and copies it into its own ring
+ * buffer - no formatting, no locks and no system calls. A background thread
+ * drains the rings, formats the records and writes them in batches.
+ *
+ * Messages of one thread keep their order. Messages of different threads
+ * are only ordered by when the background thread gets to them.
+ **/
+namespace logging {
+
+enum class Level : uint8_t { Debug, Info, Error };
+
+// Messages below it are compiled out. Debug messages only exist in debug
+// builds anyway
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 0
+#endif
+constexpr Level MIN_LEVEL = static_cast<Level>(LOG_MIN_LEVEL);
+
+// What the caller does when its ring is full
+enum class OverflowPolicy : uint8_t {
+  // Waits for the background thread to make room. Nothing is lost
+  Block,
+  // Throws the message away. The number of dropped messages is logged later
+  Drop,
+};
+
+void setOverflowPolicy(OverflowPolicy policy);
+// Waits until everything logged so far by any thread is written
+void flush();
+
+namespace internal {
+
+enum class ArgType : uint8_t { Int, Uint, Float, Char, String };
+
+// Longest record, strings are cut to fit
+constexpr size_t MAX_RECORD_BYTES = 512;
+
+/**
+ * Record layout: size (uint16, the whole record) | level | arguments.
+ * Every argument is its type followed by the value. Strings are copied as
+ * their length (uint16) and bytes
+ **/
+struct RecordWriter {
+  explicit RecordWriter(Level level) {
+    m_size = sizeof(uint16_t);
+    put(level);
+  }
+
+  template <typename T> void add(const T &value) {
+    if constexpr (std::is_same_v<T, bool>) {
+      // Printed as 0/1 like std::cout does
+      putArg(ArgType::Int, static_cast<int64_t>(value));
+    } else if constexpr (std::is_same_v<T, char> ||
+                         std::is_same_v<T, signed char> ||
+                         std::is_same_v<T, unsigned char>) {
+      putArg(ArgType::Char, static_cast<char>(value));
+    } else if constexpr (std::signed_integral<T>) {
+      putArg(ArgType::Int, static_cast<int64_t>(value));
+    } else if constexpr (std::unsigned_integral<T>) {
+      putArg(ArgType::Uint, static_cast<uint64_t>(value));
+    } else if constexpr (std::floating_point<T>) {
+      putArg(ArgType::Float, static_cast<double>(value));
+    } else if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+      putString(std::string_view(value));
+    } else {
+      // Anything else streamable is formatted right away
+      std::ostringstream stream;
+      stream << value;
+      putString(stream.view());
+    }
+  }
+
+  const std::byte *data() {
+    const auto size = static_cast<uint16_t>(m_size);
+    std::memcpy(m_buffer, &size, sizeof(size));
+    return m_buffer;
+  }
+  size_t size() const { return m_size; }
+
+private:
+  template <typename T> void put(const T &value) {
+    if (m_size + sizeof(T) > MAX_RECORD_BYTES) {
+      m_full = true;
+      return;
+    }
+    std::memcpy(m_buffer + m_size, &value, sizeof(T));
+    m_size += sizeof(T);
+  }
+
+  template <typename T> void putArg(ArgType type, const T &value) {
+    if (m_full || m_size + 1 + sizeof(T) > MAX_RECORD_BYTES) {
+      m_full = true;
+      return;
+    }
+    put(type);
+    put(value);
+  }
+
+  void putString(std::string_view s) {
+    constexpr size_t HEADER = 1 + sizeof(uint16_t);
+    if (m_full || m_size + HEADER > MAX_RECORD_BYTES) {
+      m_full = true;
+      return;
+    }
+    const auto length = static_cast<uint16_t>(
+        std::min(s.size(), MAX_RECORD_BYTES - m_size - HEADER));
+    put(ArgType::String);
+    put(length);
+    std::memcpy(m_buffer + m_size, s.data(), length);
+    m_size += length;
+  }
+
+  std::byte m_buffer[MAX_RECORD_BYTES];
+  size_t m_size;
+  bool m_full = false;
+};
+
+// Copies the record into the ring of the calling thread
+void push(const std::byte *record, size_t size);
+
+} // namespace internal
+
+template <typename... ARGS> void write(Level level, const ARGS &...args) {
+  internal::RecordWriter record(level);
+  (record.add(args), ...);
+  internal::push(record.data(), record.size());
+}
+
+} // namespace logging
 
 // Debug logging available only in debug compile
 #ifdef DEBUG_BUILD
 #define LOG_DEBUG(...)                                                         \
-  log("[", "\033[33m", "DEBUG", "\033[0m", "] ", __FILE_NAME__, ':', __LINE__, \
-      " ", __VA_ARGS__)
+  LOG_AT(logging::Level::Debug, __FILE_NAME__, ':', __LINE__, " ", __VA_ARGS__)
 #else
 #define LOG_DEBUG(...)
 
 #endif
 
 // These represent log messages
-#define LOG_ERROR(...)                                                         \
-  log("[", "\033[31m", "ERROR", "\033[0m", "] ", __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(logging::Level::Error, __VA_ARGS__)
 
-#define LOG_INFO(...) log("[", "\033[34m", "INFO", "\033[0m", "] ", __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(logging::Level::Info, __VA_ARGS__)
 
-template <typename... ARGS> constexpr void log(ARGS... args) {
-  (std::cout << ... << args) << std::endl;
-}
+// The arguments aren't even evaluated below the minimum level
+#define LOG_AT(level, ...)                                                     \
+  ((level) >= logging::MIN_LEVEL ? logging::write((level), __VA_ARGS__)        \
+                                 : void())
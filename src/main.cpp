@@ -1,7 +1,24 @@
+#ifdef HEADLESS_SERVER
+#include "DedicatedServer.hpp"
+#else
 #include "Application.hpp"
+#include <cstring>
+#endif
 
 int main(int argc, char *argv[]) {
 
+#ifdef HEADLESS_SERVER
+  DedicatedServer server(argc, argv);
+  return server.run();
+#else
+  // "udp" anywhere in the arguments switches the transport
+  network::SocketType transport = network::SocketType::TCP;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "udp") == 0)
+      transport = network::SocketType::UDP;
+  }
+
   Application app(argc, argv);
-  app.run(argc > 1 && argv[1][0] == 's');
+  app.run(argc > 1 && argv[1][0] == 's', transport);
+#endif
 }
@@ -0,0 +1,247 @@
+#pragma once
+
+#include <SFML/System/Vector2.hpp>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+#include <string>
+#include <string_view>
+
+namespace network {
+
+/**
+ * How the fields of a packet are written.
+ * Raw keeps full precision (floats and ints as they are).
+ * Quantized packs them into fewer bits:
+ *  - coordinates: 16 bit fixed point over [COORDINATE_MIN, COORDINATE_MAX)
+ *    with a step of 1/64 px. Error <= 1/128 px, values outside are clamped.
+ *    NaN is sent as 0
+ *  - directions: unit vectors as a 12 bit angle. Error <= pi/4096 rad
+ *    (~0.044 deg). A zero vector or one with NaN is sent as (1, 0)
+ *  - health: a byte clamped to [0, 255]
+ **/
+enum class Encoding : uint8_t { Raw, Quantized };
+
+namespace internal {
+
+// The map is 512x512 px. The margin covers entities that left it
+constexpr float COORDINATE_MIN = -256.f;
+constexpr float COORDINATE_MAX = 768.f;
+constexpr uint32_t COORDINATE_BITS = 16;
+constexpr uint32_t ANGLE_BITS = 12;
+constexpr uint32_t HEALTH_BITS = 8;
+
+// Writes values of arbitrary bit width (least significant bits first)
+struct BitWriter {
+  explicit BitWriter(std::string &dest) : m_dest(dest) {}
+
+  // Writes the lowest "bits" (<= 32) bits of the value
+  void write(uint32_t value, uint32_t bits) {
+    if (bits < 32)
+      value &= (1u << bits) - 1;
+    m_scratch |= static_cast<uint64_t>(value) << m_bits;
+    m_bits += bits;
+    while (m_bits >= 8) {
+      m_dest.push_back(static_cast<char>(m_scratch & 0xFF));
+      m_scratch >>= 8;
+      m_bits -= 8;
+    }
+  }
+
+  // Groups of "groupBits" bits, each followed by a continuation bit
+  void writeVarBits(uint32_t value, uint32_t groupBits) {
+    const uint32_t limit = 1u << groupBits;
+    while (value >= limit) {
+      write((value & (limit - 1)) | limit, groupBits + 1);
+      value >>= groupBits;
+    }
+    write(value, groupBits + 1);
+  }
+
+  // 7 bits per group with a continuation bit. Small values take a byte
+  void writeVarUint(uint32_t value) { writeVarBits(value, 7); }
+
+  // Pads the last byte with zeros. Must be called after the last write
+  void flush() {
+    if (m_bits > 0)
+      write(0, 8 - m_bits);
+  }
+
+  static constexpr uint32_t varUintBits(uint32_t value) {
+    uint32_t bits = 8;
+    for (; value >= 0x80; value >>= 7)
+      bits += 8;
+    return bits;
+  }
+
+private:
+  std::string &m_dest;
+  uint64_t m_scratch = 0;
+  uint32_t m_bits = 0;
+};
+
+// Bounds checked reader of data written by BitWriter. Like Reader a read past
+// the end puts it in the failed state
+struct BitReader {
+  explicit BitReader(std::string_view data) : m_data(data) {}
+
+  bool read(uint32_t &out, uint32_t bits) {
+    while (m_bits < bits) {
+      if (m_offset == m_data.size()) {
+        m_failed = true;
+        return false;
+      }
+      m_scratch |= static_cast<uint64_t>(
+                       static_cast<uint8_t>(m_data[m_offset++]))
+                   << m_bits;
+      m_bits += 8;
+    }
+
+    out = static_cast<uint32_t>(m_scratch & ((uint64_t(1) << bits) - 1));
+    m_scratch >>= bits;
+    m_bits -= bits;
+    return true;
+  }
+
+  bool readVarBits(uint32_t &out, uint32_t groupBits) {
+    const uint32_t limit = 1u << groupBits;
+    out = 0;
+    for (uint32_t shift = 0; shift < 32; shift += groupBits) {
+      uint32_t group = 0;
+      if (!read(group, groupBits + 1))
+        return false;
+      out |= (group & (limit - 1)) << shift;
+      if ((group & limit) == 0)
+        return true;
+    }
+    m_failed = true;
+    return false;
+  }
+
+  bool readVarUint(uint32_t &out) { return readVarBits(out, 7); }
+
+  bool ok() const { return !m_failed; }
+  // True when only the padding of the last byte is left
+  bool finished() const {
+    return ok() && m_offset == m_data.size() && m_scratch == 0;
+  }
+
+private:
+  std::string_view m_data;
+  size_t m_offset = 0;
+  uint64_t m_scratch = 0;
+  uint32_t m_bits = 0;
+  bool m_failed = false;
+};
+
+inline void writeFloat(BitWriter &dest, float value) {
+  dest.write(std::bit_cast<uint32_t>(value), 32);
+}
+
+inline bool readFloat(BitReader &src, float &value) {
+  uint32_t bits = 0;
+  if (!src.read(bits, 32))
+    return false;
+  value = std::bit_cast<float>(bits);
+  return true;
+}
+
+inline void writeCoordinate(BitWriter &dest, float value, Encoding encoding) {
+  if (encoding == Encoding::Raw)
+    return writeFloat(dest, value);
+
+  // Converting NaN to an integer is undefined. Clients send positions too
+  if (std::isnan(value))
+    value = 0;
+
+  constexpr float steps = (1u << COORDINATE_BITS) - 1;
+  constexpr float scale = (1u << COORDINATE_BITS) /
+                          (COORDINATE_MAX - COORDINATE_MIN);
+  const float fixed = std::round((value - COORDINATE_MIN) * scale);
+  dest.write(static_cast<uint32_t>(std::clamp(fixed, 0.f, steps)),
+             COORDINATE_BITS);
+}
+
+inline bool readCoordinate(BitReader &src, float &value, Encoding encoding) {
+  if (encoding == Encoding::Raw)
+    return readFloat(src, value);
+
+  constexpr float step = (COORDINATE_MAX - COORDINATE_MIN) /
+                         (1u << COORDINATE_BITS);
+  uint32_t fixed = 0;
+  if (!src.read(fixed, COORDINATE_BITS))
+    return false;
+  value = COORDINATE_MIN + fixed * step;
+  return true;
+}
+
+inline void writePosition(BitWriter &dest, sf::Vector2f pos,
+                          Encoding encoding) {
+  writeCoordinate(dest, pos.x, encoding);
+  writeCoordinate(dest, pos.y, encoding);
+}
+
+inline bool readPosition(BitReader &src, sf::Vector2f &pos,
+                         Encoding encoding) {
+  return readCoordinate(src, pos.x, encoding) &&
+         readCoordinate(src, pos.y, encoding);
+}
+
+inline void writeDirection(BitWriter &dest, sf::Vector2f dir,
+                           Encoding encoding) {
+  if (encoding == Encoding::Raw)
+    return writePosition(dest, dir, encoding);
+
+  if (std::isnan(dir.x) || std::isnan(dir.y))
+    dir = {1, 0};
+
+  constexpr float steps = 1u << ANGLE_BITS;
+  const float turns =
+      std::atan2(dir.y, dir.x) / (2 * std::numbers::pi_v<float>);
+  const int32_t angle = static_cast<int32_t>(std::round(turns * steps));
+  // Negative angles wrap around thanks to the mask in "write"
+  dest.write(static_cast<uint32_t>(angle), ANGLE_BITS);
+}
+
+inline bool readDirection(BitReader &src, sf::Vector2f &dir,
+                          Encoding encoding) {
+  if (encoding == Encoding::Raw)
+    return readPosition(src, dir, encoding);
+
+  uint32_t angle = 0;
+  if (!src.read(angle, ANGLE_BITS))
+    return false;
+  const float radians =
+      angle * (2 * std::numbers::pi_v<float>) / (1u << ANGLE_BITS);
+  dir = {std::cos(radians), std::sin(radians)};
+  return true;
+}
+
+inline void writeHealth(BitWriter &dest, int health, Encoding encoding) {
+  if (encoding == Encoding::Raw)
+    return dest.write(static_cast<uint32_t>(health), 32);
+  dest.write(static_cast<uint32_t>(std::clamp(health, 0, 255)), HEALTH_BITS);
+}
+
+inline bool readHealth(BitReader &src, int &health, Encoding encoding) {
+  uint32_t value = 0;
+  if (!src.read(value, encoding == Encoding::Raw ? 32 : HEALTH_BITS))
+    return false;
+  health = static_cast<int>(value);
+  return true;
+}
+
+constexpr uint32_t positionBits(Encoding encoding) {
+  return encoding == Encoding::Raw ? 64 : 2 * COORDINATE_BITS;
+}
+constexpr uint32_t directionBits(Encoding encoding) {
+  return encoding == Encoding::Raw ? 64 : ANGLE_BITS;
+}
+constexpr uint32_t healthBits(Encoding encoding) {
+  return encoding == Encoding::Raw ? 32 : HEALTH_BITS;
+}
+
+} // namespace internal
+} // namespace network
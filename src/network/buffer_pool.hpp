@@ -0,0 +1,46 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+namespace network {
+
+/**
+ * Recycles the buffers of large packet payloads.
+ * Payloads too big to be kept inside the packet variant are held out of line
+ * by a Handle. When it's released the buffer goes back to the pool instead of
+ * being freed, so decoding the next such packet doesn't allocate.
+ * Not thread safe (the game is single threaded)
+ **/
+template <typename T, size_t MAX_FREE = 4> struct BufferPool {
+  struct Release {
+    void operator()(T *buffer) const {
+      auto &free = freeBuffers();
+      if (free.size() < MAX_FREE)
+        free.emplace_back(buffer);
+      else
+        delete buffer;
+    }
+  };
+
+  typedef std::unique_ptr<T, Release> Handle;
+
+  // Contents of a recycled buffer are left as they were
+  static Handle acquire() {
+    auto &free = freeBuffers();
+    if (free.empty())
+      return Handle(new T());
+
+    Handle buffer(free.back().release());
+    free.pop_back();
+    return buffer;
+  }
+
+private:
+  static std::vector<std::unique_ptr<T>> &freeBuffers() {
+    static std::vector<std::unique_ptr<T>> buffers;
+    return buffers;
+  }
+};
+
+} // namespace network
@@ -1,7 +1,9 @@
 #include <arpa/inet.h>
 #include <cstring>
 #include <netinet/in.h>
+#include <array>
 #include <optional>
+#include <poll.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 
@@ -21,33 +23,80 @@ Client::~Client() {
   }
 }
 
-bool Client::connect(const char *ipAddress, unsigned short port) {
-  auto result = Socket::create(ipAddress, port, SocketType::TCP, 0);
+// Exchanges Connect/Accept with the server to get the connection id.
+// Blocks for at most CONNECT_ATTEMPTS * CONNECT_TIMEOUT_MS
+static bool handshake(Socket &s) {
+  constexpr int CONNECT_ATTEMPTS = 10;
+  constexpr int CONNECT_TIMEOUT_MS = 100;
+
+  s.udp = std::make_shared<UdpConnection>(0);
+
+  for (int i = 0; i < CONNECT_ATTEMPTS; ++i) {
+    if (s.sendControl(internal::DatagramKind::Connect))
+      return false;
+
+    struct pollfd pfd = {.fd = s.fd, .events = POLLIN, .revents = 0};
+    if (::poll(&pfd, 1, CONNECT_TIMEOUT_MS) <= 0)
+      continue;
+
+    std::array<char, 512> buf;
+    const ssize_t bytesRead = ::recv(s.fd, buf.data(), buf.size(), 0);
+    if (bytesRead < 0)
+      continue;
+
+    internal::Reader reader(std::string_view(buf.data(), bytesRead));
+    auto header = internal::readDatagramHeader(reader);
+
+    if (header && header->kind == internal::DatagramKind::Accept) {
+      s.udp = std::make_shared<UdpConnection>(header->connection);
+      LOG_INFO("Connection accepted with id: ", header->connection);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool Client::connect(const char *ipAddress, unsigned short port,
+                     SocketType transport) {
+  auto result = Socket::create(ipAddress, port, transport, 0);
 
   if (!result)
     return false;
 
   Socket s = result.value();
   // Connecting to the server
+  // (for UDP it only fixes the peer address used by send/recv)
   if (::connect(s.fd, (const struct sockaddr *)&s.addr, s.addrlen) < 0) {
     LOG_ERROR("Couldn't connect to ", ipAddress, " with port ", port);
     return false;
   }
 
+  if (transport == SocketType::UDP && !handshake(s)) {
+    LOG_ERROR("Server ", ipAddress, ":", port, " didn't accept the connection");
+    s.close();
+    return false;
+  }
+
   // Setting the socket to run in non-blocking mode
   m_socket = s;
   if (!m_socket.setBlocking(false))
     return false;
 
+  if (!m_poller.add(m_socket.fd))
+    return false;
+
   return true;
 }
 
 std::optional<SocketError> Client::send(network::ClientPacket packet) {
 
-  auto msg = encodePacket(packet);
-  size_t len = msg.size();
+  m_socket.queue(std::make_shared<const std::string>(encodePacket(packet)),
+                 channelOf(packet));
 
-  auto error = m_socket.send(msg.c_str(), len);
+  // Client sends rarely so the queue is flushed right away.
+  // Anything left after a partial write is retried by the next send or poll
+  auto error = m_socket.flush();
   if (error) {
     return error.value();
   }
@@ -56,16 +105,11 @@ std::optional<SocketError> Client::send(network::ClientPacket packet) {
 }
 
 std::optional<SocketError> Client::receive() {
-  auto error = m_socket.receive();
+  auto error = m_socket.receive(&m_pollStats.syscalls);
 
-  while (auto packetWrapper = m_socket.nextMessage<network::ServerPacket>()) {
-
-    if (!packetWrapper.has_value()) {
-      LOG_ERROR("Couldn't decode server packet");
-      return std::nullopt;
-    }
-    m_incomingPackets.push(*packetWrapper);
-  }
+  // Frames that couldn't be decoded are skipped by nextMessage
+  while (auto packetWrapper = m_socket.nextMessage<network::ServerPacket>())
+    m_incomingPackets.push(std::move(*packetWrapper));
 
   if (error)
     return error;
@@ -73,18 +117,30 @@ std::optional<SocketError> Client::receive() {
   return std::nullopt;
 }
 
-std::optional<network::ServerPacket> Client::pollMessage() {
-  if (receive()) {
+const PollStats &Client::poll() {
+  m_pollStats = PollStats{};
+
+  auto events = m_poller.wait(0);
+  ++m_pollStats.syscalls;
+  m_pollStats.readyEvents = events.size();
+
+  if (!events.empty() && receive()) {
     LOG_ERROR("Receive failed");
   }
 
-  if (m_incomingPackets.empty()) {
-    return std::nullopt;
+  if (m_socket.needsFlush() && m_socket.flush(&m_pollStats.syscalls)) {
+    LOG_ERROR("Flushing pending data failed");
   }
 
-  const auto packet = m_incomingPackets.top();
-  m_incomingPackets.pop();
-  return packet.body;
+  return m_pollStats;
+}
+
+std::optional<network::ServerPacket> Client::pollMessage() {
+  auto packet = m_incomingPackets.pop();
+  if (!packet)
+    return std::nullopt;
+
+  return std::move(packet->body);
 }
 
 } // namespace network
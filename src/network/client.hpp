@@ -1,7 +1,8 @@
 #pragma once
 #include "packet.hpp"
+#include "poller.hpp"
+#include "message_queue.hpp"
 #include "socket.hpp"
-#include <queue>
 
 namespace network {
 struct Client {
@@ -10,18 +11,28 @@ public:
   Client();
   ~Client();
 
-  bool connect(const char *ipAddress, unsigned short port);
+  bool connect(const char *ipAddress, unsigned short port,
+               SocketType transport = SocketType::TCP);
   std::optional<SocketError> send(network::ClientPacket);
+
+  /**
+   * Reads the socket if epoll reports it as readable.
+   * Should be called once per tick before "pollMessage"
+   **/
+  const PollStats &poll();
+  // Returns the next message received during the last "poll"
   std::optional<network::ServerPacket> pollMessage();
 
+  const PollStats &getPollStats() const { return m_pollStats; }
+
 private:
   std::optional<SocketError> receive();
-  std::priority_queue<
-      internal::PacketWrapper<network::ServerPacket>,
-      std::vector<internal::PacketWrapper<network::ServerPacket>>,
-      internal::PacketCompare<network::ServerPacket>>
+  // Received packets in arrival order
+  MessageQueue<internal::PacketWrapper<network::ServerPacket>>
       m_incomingPackets;
   // client scoket description
   Socket m_socket;
+  Poller m_poller;
+  PollStats m_pollStats;
 };
 }; // namespace network
@@ -0,0 +1,157 @@
+#pragma once
+
+#include "snapshot.hpp"
+#include <SFML/System/Vector2.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <optional>
+
+namespace network {
+
+// Value between a (t = 0) and b (t = 1). t > 1 extrapolates
+inline sf::Vector2f interpolate(sf::Vector2f a, sf::Vector2f b, float t) {
+  return a + (b - a) * t;
+}
+
+inline Enemy::DTO interpolate(const Enemy::DTO &a, const Enemy::DTO &b,
+                              float t) {
+  Enemy::DTO result = b;
+  result.pos = interpolate(a.pos, b.pos, t);
+  return result;
+}
+
+inline Fireball::DTO interpolate(const Fireball::DTO &a, const Fireball::DTO &b,
+                                 float t) {
+  Fireball::DTO result = b;
+  result.pos = interpolate(a.pos, b.pos, t);
+  return result;
+}
+
+// Entities of b moved from where they were in a. Entities new in b stay where
+// b has them and the ones removed in b are gone
+template <typename DTO>
+Snapshot<DTO> interpolate(const Snapshot<DTO> &a, const Snapshot<DTO> &b,
+                          float t) {
+  Snapshot<DTO> result{.tick = b.tick};
+  result.entities.reserve(b.entities.size());
+
+  // Both are sorted by id
+  auto previous = a.entities.begin();
+  for (const DTO &entity : b.entities) {
+    while (previous != a.entities.end() && previous->id < entity.id)
+      ++previous;
+
+    if (previous != a.entities.end() && previous->id == entity.id)
+      result.entities.push_back(interpolate(*previous, entity, t));
+    else
+      result.entities.push_back(entity);
+  }
+  return result;
+}
+
+/**
+ * Client side estimate of the current server snapshot tick. It runs on the
+ * frame time and every received snapshot pulls it a bit towards its tick, so
+ * network jitter is smoothed out while the clocks don't drift apart.
+ **/
+class SnapshotClock {
+public:
+  // Errors larger than this (in ticks) are fixed by jumping to the tick
+  static constexpr double RESYNC_TICKS = 4.0;
+  // Part of the error corrected by every snapshot
+  static constexpr double CORRECTION = 0.1;
+
+  // Seconds between two snapshots of the server
+  void setInterval(float seconds) { m_interval = seconds; }
+  float getInterval() const { return m_interval; }
+
+  void advance(float dt) {
+    if (m_started)
+      m_tick += dt / m_interval;
+  }
+
+  // Only the newest snapshot so far corrects the clock
+  void onSnapshot(SnapshotTick tick) {
+    if (!m_started) {
+      m_tick = m_newestTick = tick;
+      m_started = true;
+      return;
+    }
+    if (tick <= m_newestTick)
+      return;
+    m_newestTick = tick;
+
+    const double error = tick - m_tick;
+    if (std::abs(error) > RESYNC_TICKS)
+      m_tick = tick;
+    else
+      m_tick += error * CORRECTION;
+  }
+
+  bool isStarted() const { return m_started; }
+  double getTick() const { return m_tick; }
+
+private:
+  float m_interval = 0.06f;
+  double m_tick = 0.0;
+  SnapshotTick m_newestTick = 0;
+  bool m_started = false;
+};
+
+/**
+ * Values received from the server keyed by the (fractional) snapshot tick
+ * they belong to. Sampled some time behind the newest one so there is
+ * almost always a value on both sides to interpolate between. When the
+ * sampled tick is past the newest value (late packets) it extrapolates from
+ * the last two, but only up to "maxExtrapolation" ticks - then it holds.
+ *
+ * T needs an "interpolate(const T &a, const T &b, float t)" overload
+ **/
+template <typename T> class InterpolationBuffer {
+public:
+  static constexpr size_t CAPACITY = 32;
+
+  // Values older than the newest one are dropped (reordered packets)
+  void push(double tick, T value) {
+    if (!m_samples.empty() && tick <= m_samples.back().tick)
+      return;
+    m_samples.push_back({tick, std::move(value)});
+    if (m_samples.size() > CAPACITY)
+      m_samples.pop_front();
+  }
+
+  // Returns nullopt before anything was received
+  std::optional<T> sample(double tick, double maxExtrapolation) const {
+    if (m_samples.empty())
+      return std::nullopt;
+    if (m_samples.size() == 1 || tick <= m_samples.front().tick)
+      return m_samples.front().value;
+
+    // First sample after the tick. The last two when there is none
+    auto next = std::upper_bound(
+        m_samples.begin(), m_samples.end(), tick,
+        [](double t, const Sample &sample) { return t < sample.tick; });
+    if (next == m_samples.end()) {
+      --next;
+      tick = std::min(tick, next->tick + maxExtrapolation);
+    }
+    const Sample &from = *(next - 1);
+
+    const float t =
+        static_cast<float>((tick - from.tick) / (next->tick - from.tick));
+    return interpolate(from.value, next->value, t);
+  }
+
+  void clear() { m_samples.clear(); }
+
+private:
+  struct Sample {
+    double tick;
+    T value;
+  };
+  std::deque<Sample> m_samples;
+};
+
+} // namespace network
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace network {
+
+/**
+ * FIFO of received messages.
+ * A ring buffer indexed by the sequence number of the message (its arrival
+ * order). Messages are moved in and out so nothing is copied, and the ring
+ * only grows when more messages are pending than it can hold
+ **/
+template <typename T> struct MessageQueue {
+  explicit MessageQueue(size_t initialCapacity = 64) {
+    size_t capacity = 1;
+    while (capacity < initialCapacity)
+      capacity <<= 1;
+    m_slots.resize(capacity);
+  }
+
+  void push(T &&message) {
+    if (size() == m_slots.size())
+      grow();
+    m_slots[m_tail & mask()] = std::move(message);
+    ++m_tail;
+  }
+
+  std::optional<T> pop() {
+    if (empty())
+      return std::nullopt;
+    std::optional<T> message(std::move(m_slots[m_head & mask()]));
+    ++m_head;
+    return message;
+  }
+
+  size_t size() const { return m_tail - m_head; }
+  bool empty() const { return m_head == m_tail; }
+
+private:
+  size_t mask() const { return m_slots.size() - 1; }
+
+  void grow() {
+    std::vector<T> slots(m_slots.size() * 2);
+    for (uint64_t seq = m_head; seq != m_tail; ++seq)
+      slots[seq & (slots.size() - 1)] = std::move(m_slots[seq & mask()]);
+    m_slots = std::move(slots);
+  }
+
+  // Capacity is a power of 2 so a sequence maps to a slot with a mask
+  std::vector<T> m_slots;
+  // Sequence of the oldest pending message and of the next pushed one
+  uint64_t m_head = 0;
+  uint64_t m_tail = 0;
+};
+
+} // namespace network
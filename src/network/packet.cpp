@@ -1,128 +1,327 @@
 #include "packet.hpp"
 #include <SFML/System/Vector2.hpp>
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <expected>
-#include <iomanip>
 #include <string>
 
 namespace network {
 
-void printBytes(std::string_view s) {
-
-  std::ios_base::fmtflags f(std::cout.flags());
-  std::cout << std::hex << std::setfill('0') << std::setw(2);
+// Wire sizes are part of the protocol. Changing one needs a VERSION bump
+static_assert(internal::wireSize<PlayerDisconnectedResponse>() == 4);
+static_assert(internal::wireSize<JoinLobbyRequest>() == 0);
+static_assert(internal::wireSize<LobbyReadyRequst>() == 1);
+static_assert(internal::wireSize<LobbyReadyResponse>() == 5);
+static_assert(internal::wireSize<StartGameResponse>() == 0);
+static_assert(internal::wireSize<PlayerMoveRequest>() == 8);
+static_assert(internal::wireSize<FireballShotRequest>() == 24);
+static_assert(internal::wireSize<SnapshotAckRequest>() == 8);
+static_assert(internal::wireSize<BaseHitResponse>() == 4);
+static_assert(internal::wireSize<GameOverResponse>() == 4);
+
+// Bytes as two hex digits each. Long ones are cut to fit a log record
+[[maybe_unused]] static std::string toHex(std::string_view s) {
+  constexpr char DIGITS[] = "0123456789abcdef";
+  std::string result;
+  result.reserve(s.size() * 3);
   for (char c : s) {
-    std::cout << ((uint32_t)c) % 256 << " ";
+    const auto byte = static_cast<uint8_t>(c);
+    result += DIGITS[byte >> 4];
+    result += DIGITS[byte & 0xF];
+    result += ' ';
   }
-  std::cout.flags(f);
-  std::cout << std::endl;
+  return result;
+}
+
+void printBytes([[maybe_unused]] std::string_view s) {
+  LOG_DEBUG(toHex(s));
 }
 
 JoinLobbyResponse::JoinLobbyResponse(
     std::unordered_map<int32_t, bool> lobbyPlayers)
     : lobbyPlayers(lobbyPlayers) {}
 
-std::string JoinLobbyResponse::serialize() const {
-  std::string s;
-
-  internal::appendBytes(s, this->lobbyPlayers.size());
+void JoinLobbyResponse::serialize(std::string &dest) const {
+  internal::appendBytes(dest, this->lobbyPlayers.size());
   for (auto [p, r] : this->lobbyPlayers) {
-    internal::appendBytes(s, p);
-    internal::appendBytes(s, r);
+    internal::appendBytes(dest, p);
+    internal::appendBytes(dest, r);
   }
-
-  return s;
 }
 
-void JoinLobbyResponse::deserialize(std::string_view body) {
+bool JoinLobbyResponse::deserialize(std::string_view body) {
 
   LOG_DEBUG("Deserializing JoinLobbyResponse body size: ", body.size());
 
-  this->lobbyPlayers = std::unordered_map<int32_t, bool>();
+  internal::Reader reader(body);
 
   size_t size = 0;
-  size_t offset = internal::readBytes(body, size);
+  if (!reader.read(size))
+    return false;
 
   LOG_DEBUG("Read size: ", size);
 
+  constexpr size_t ENTRY_SIZE = sizeof(int32_t) + sizeof(bool);
+  if (size > reader.remaining() / ENTRY_SIZE)
+    return false;
+
+  this->lobbyPlayers.clear();
+  this->lobbyPlayers.reserve(size);
+
   for (int i = 0; i < size; ++i) {
 
     int32_t p = -1;
     bool r = false;
 
-    offset += internal::readBytes(body.substr(offset, std::string::npos), p);
-    offset += internal::readBytes(body.substr(offset, std::string::npos), r);
+    reader.read(p);
+    reader.read(r);
 
     this->lobbyPlayers[p] = r;
   }
+
+  return reader.finished();
 }
 
-EnemyUpdateResponse::EnemyUpdateResponse(std::vector<Enemy::DTO> enemies)
-    : enemies(enemies) {}
-std::string EnemyUpdateResponse::serialize() const {
-  std::string s = internal::serialize(this->enemies);
-  return s;
+GameReadyRequest::GameReadyRequest(std::vector<CachedMap> cachedMaps)
+    : cachedMaps(std::move(cachedMaps)) {}
+
+void GameReadyRequest::serialize(std::string &dest) const {
+  ASSERT(cachedMaps.size() <= std::numeric_limits<uint8_t>::max());
+
+  internal::appendBytes(dest, static_cast<uint8_t>(cachedMaps.size()));
+  for (const CachedMap &map : cachedMaps) {
+    internal::appendBytes(dest, map.id);
+    internal::appendBytes(dest, map.hash);
+  }
+}
+
+bool GameReadyRequest::deserialize(std::string_view body) {
+  internal::Reader reader(body);
+
+  uint8_t count = 0;
+  if (!reader.read(count))
+    return false;
+
+  cachedMaps.resize(count);
+  for (CachedMap &map : cachedMaps) {
+    reader.read(map.id);
+    reader.read(map.hash);
+  }
+
+  return reader.finished();
 }
 
-void EnemyUpdateResponse::deserialize(const std::string_view body) {
+namespace internal {
+
+constexpr uint32_t TILE_BITS = 3;
+// Run lengths are written in groups of this many bits
+constexpr uint32_t RUN_GROUP_BITS = 3;
+static_assert(static_cast<int>(TileType::Count) <= (1 << TILE_BITS));
+
+// Writes the tiles as (type, run length) pairs
+static void writeTiles(BitWriter &dest, const Level::TileData &tiles) {
+  for (size_t i = 0; i < tiles.size();) {
+    size_t run = 1;
+    while (i + run < tiles.size() && tiles[i + run] == tiles[i])
+      ++run;
+
+    dest.write(static_cast<uint32_t>(tiles[i]), TILE_BITS);
+    dest.writeVarBits(run - 1, RUN_GROUP_BITS);
+    i += run;
+  }
+}
+
+static bool readTiles(BitReader &src, Level::TileData &tiles) {
+  for (size_t i = 0; i < tiles.size();) {
+    uint32_t type = 0;
+    uint32_t run = 0;
+    if (!src.read(type, TILE_BITS) || !src.readVarBits(run, RUN_GROUP_BITS))
+      return false;
+    ++run;
+
+    if (type >= static_cast<uint32_t>(TileType::Count) ||
+        run > tiles.size() - i) {
+      LOG_ERROR("Invalid tile run. type: ", type, " length: ", run);
+      return false;
+    }
+
+    std::fill_n(tiles.begin() + i, run, static_cast<TileType>(type));
+    i += run;
+  }
+  return true;
+}
+
+} // namespace internal
+
+void GameReadyResponse::serialize(std::string &dest) const {
+  internal::appendBytes(dest, thisPlayerID);
+  internal::appendBytes(dest, thisPlayerPos);
+  internal::appendBytes(dest, otherID);
+  internal::appendBytes(dest, otherPlayerPos);
+  internal::appendBytes(dest, snapshotInterval);
+  internal::appendBytes(dest, mapID);
+  internal::appendBytes(dest, mapHash);
+  internal::appendBytes(dest, static_cast<uint8_t>(map != nullptr));
+
+  if (map) {
+    // Dimensions let the client reject a map it can't load
+    internal::appendBytes(dest, static_cast<uint16_t>(Level::MAP_WIDTH));
+    internal::appendBytes(dest, static_cast<uint16_t>(Level::MAP_HEIGHT));
+
+    internal::BitWriter writer(dest);
+    internal::writeTiles(writer, map->tiles);
+    writer.flush();
+  }
+}
+
+bool GameReadyResponse::deserialize(std::string_view body) {
+  internal::Reader reader(body);
+
+  uint8_t hasMap = 0;
+  reader.read(thisPlayerID);
+  reader.read(thisPlayerPos);
+  reader.read(otherID);
+  reader.read(otherPlayerPos);
+  reader.read(snapshotInterval);
+  reader.read(mapID);
+  reader.read(mapHash);
+  if (!reader.read(hasMap))
+    return false;
+
+  if (!hasMap) {
+    map.reset();
+    return reader.finished();
+  }
+
+  uint16_t width = 0;
+  uint16_t height = 0;
+  if (!reader.read(width) || !reader.read(height))
+    return false;
+
+  if (width != Level::MAP_WIDTH || height != Level::MAP_HEIGHT) {
+    LOG_ERROR("Unsupported map size ", width, "x", height);
+    return false;
+  }
+
+  map = MapBufferPool::acquire();
+  map->id = mapID;
+
+  internal::BitReader tiles(*reader.take(reader.remaining()));
+  if (!internal::readTiles(tiles, map->tiles) || !tiles.finished())
+    return false;
+
+  if (Level::hashMap(*map) != mapHash) {
+    LOG_ERROR("Received map doesn't match its hash");
+    return false;
+  }
+
+  return true;
+}
+
+PlayerMoveResponse::PlayerMoveResponse(EntityID playerID, sf::Vector2f newPos,
+                                       uint32_t lastSequence)
+    : playerID(playerID), newPos(newPos), lastSequence(lastSequence) {}
+
+void PlayerMoveResponse::serialize(std::string &dest) const {
+  constexpr Encoding encoding = encodingOf<PlayerMoveResponse>();
+
+  internal::BitWriter writer(dest);
+  // Player ids are low slot indices so they are small
+  writer.writeVarUint(playerID);
+  writer.writeVarUint(lastSequence);
+  internal::writePosition(writer, newPos, encoding);
+  writer.flush();
+}
+
+bool PlayerMoveResponse::deserialize(std::string_view body) {
+  constexpr Encoding encoding = encodingOf<PlayerMoveResponse>();
+
+  internal::BitReader reader(body);
+  if (!reader.readVarUint(playerID) || !reader.readVarUint(lastSequence) ||
+      !internal::readPosition(reader, newPos, encoding))
+    return false;
+  return reader.finished();
+}
+
+EnemyUpdateResponse::EnemyUpdateResponse(SnapshotDelta<Enemy::DTO> delta)
+    : delta(std::move(delta)) {}
+
+void EnemyUpdateResponse::serialize(std::string &dest) const {
+  this->delta.serialize(dest, encodingOf<EnemyUpdateResponse>());
+}
+
+bool EnemyUpdateResponse::deserialize(const std::string_view body) {
   LOG_DEBUG("Deserializing EnemyUpdateResponse");
-  LOG_DEBUG("Received packet: ");
   DEBUG_ONLY(printBytes(body));
-  size_t offset = internal::deserialize(body, this->enemies);
-  LOG_DEBUG("Received enemies: ", enemies.size());
+  internal::Reader reader(body);
+  if (!this->delta.deserialize(reader, encodingOf<EnemyUpdateResponse>()))
+    return false;
+  LOG_DEBUG("Received enemy entries: ", delta.entries.size(),
+            " removed: ", delta.removed.size());
+  return reader.finished();
 }
 
 UpdateFireballsResponse::UpdateFireballsResponse(
-    std::vector<Fireball::DTO> fireballs)
-    : fireballs(fireballs) {}
+    SnapshotDelta<Fireball::DTO> delta)
+    : delta(std::move(delta)) {}
 
-std::string UpdateFireballsResponse::serialize() const {
-  return internal::serialize(this->fireballs);
+void UpdateFireballsResponse::serialize(std::string &dest) const {
+  this->delta.serialize(dest, encodingOf<UpdateFireballsResponse>());
 }
 
-void UpdateFireballsResponse::deserialize(std::string_view body) {
+bool UpdateFireballsResponse::deserialize(std::string_view body) {
   LOG_DEBUG("Deserializing UpdateFireballsResponse");
   LOG_DEBUG("Body size: ", body.size());
-  internal::deserialize(body, this->fireballs);
+  internal::Reader reader(body);
+  if (!this->delta.deserialize(reader,
+                               encodingOf<UpdateFireballsResponse>()))
+    return false;
 
   LOG_DEBUG("Deserialized");
+  return reader.finished();
 }
 
 namespace internal {
 
-// Creates the header of the packet
-std::string createPacketHeader(PacketType type,
-                               PacketContentLength contentLength) {
+// Appends the header of the packet
+void appendPacketHeader(std::string &dest, PacketType type,
+                        PacketContentLength contentLength) {
 
   static_assert(sizeof((VERSION)) == 4, "Version length == 4");
 
-  std::string header = std::string(HEADER_LENGTH_BYTES, '-');
-  LOG_DEBUG("Encoded header length", header.size());
-  std::memcpy(header.data(), VERSION, sizeof(VERSION));
+  const size_t start = dest.size();
+  dest.resize(start + HEADER_LENGTH_BYTES);
+  char *header = dest.data() + start;
+  std::memcpy(header, VERSION, sizeof(VERSION));
   size_t offset = sizeof(VERSION);
-  std::memcpy(header.data() + offset, &type, sizeof(type));
+  std::memcpy(header + offset, &type, sizeof(type));
   offset += sizeof(type);
-  std::memcpy(header.data() + sizeof(VERSION) + sizeof(type), &contentLength,
-              sizeof(contentLength));
+  std::memcpy(header + offset, &contentLength, sizeof(contentLength));
   offset += sizeof(contentLength);
 
   const auto timestamp =
       std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
   static_assert(sizeof(timestamp) == sizeof(Timestamp));
-  std::memcpy(header.data() + offset, &timestamp, sizeof(Timestamp));
+  std::memcpy(header + offset, &timestamp, sizeof(Timestamp));
+}
 
-  return header;
+void writeContentLength(std::string &packet,
+                        PacketContentLength contentLength) {
+  ASSERT(packet.size() >= HEADER_LENGTH_BYTES);
+  std::memcpy(packet.data() + sizeof(VERSION) + sizeof(PacketType),
+              &contentLength, sizeof(contentLength));
 }
 
 std::expected<PacketHeader, PacketError>
-parseHeader(const std::string &packet) {
+parseHeader(std::string_view packet) {
   if (packet.size() < HEADER_LENGTH_BYTES) {
     LOG_ERROR("Packet is too short with size of: ", packet.size());
     return std::unexpected(PacketError::InvalidLength);
   }
-  if (!packet.starts_with(VERSION)) {
-    LOG_ERROR("Invalid version of packet (", packet.substr(sizeof(VERSION)),
+  // VERSION starts with a null byte so it can't be compared as a c-string
+  if (!packet.starts_with(std::string_view(VERSION, sizeof(VERSION)))) {
+    LOG_ERROR("Invalid version of packet (", packet.substr(0, sizeof(VERSION)),
               ")");
     return std::unexpected(PacketError::InvalidVersion);
   }
@@ -137,38 +336,32 @@ parseHeader(const std::string &packet) {
   std::memcpy(&length, packet.data() + offset, sizeof(length));
   offset += sizeof(length);
   std::memcpy(&timestamp, packet.data() + offset, sizeof(timestamp));
+
+  if (length > MAX_CONTENT_LENGTH) {
+    LOG_ERROR("Packet content length ", length, " is over the limit");
+    return std::unexpected(PacketError::InvalidLength);
+  }
+
   return PacketHeader{
       .type = type, .contentLength = length, .timestamp = timestamp};
 }
 
-void printPacket(const std::string &s) {
-
-  std::string x;
-
-  std::cout << "Packet version: ";
-
-  PacketType type = 0;
-  PacketContentLength length = 0;
+void printPacket([[maybe_unused]] std::string_view s) {
+  if (s.size() < HEADER_LENGTH_BYTES) {
+    LOG_DEBUG("Packet shorter than its header: ", toHex(s));
+    return;
+  }
 
+  [[maybe_unused]] PacketType type = 0;
+  [[maybe_unused]] PacketContentLength length = 0;
   std::memcpy(&type, s.data() + sizeof(VERSION), sizeof(PacketType));
   std::memcpy(&length, s.data() + sizeof(VERSION) + sizeof(PacketType),
               sizeof(PacketContentLength));
 
-  printBytes(s.substr(0, sizeof(VERSION)));
-  std::cout << "Packet type: " << type << '\n';
-  // bytes are reversed whne sent
-  std::cout << "Packet content length: " << length << '\n';
-  // bytes are reversed whne sent
-  std::cout << "Packet content body (first 100 bytes): \n";
-
-  std::ios_base::fmtflags f(std::cout.flags());
-
-  for (int i = 0; i < s.substr(HEADER_LENGTH_BYTES).size() && i < 100; ++i) {
-    std::cout << std::hex << std::setfill('0') << std::setw(2)
-              << (int)s.substr(HEADER_LENGTH_BYTES)[i] << " ";
-  }
-  std::cout.flags(f);
-  std::cout << std::endl;
+  LOG_DEBUG("Packet version: ", toHex(s.substr(0, sizeof(VERSION))),
+            "type: ", type, " content length: ", length,
+            " body (first 100 bytes): ",
+            toHex(s.substr(HEADER_LENGTH_BYTES, 100)));
 }
 
 } // namespace internal
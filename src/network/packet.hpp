@@ -3,22 +3,30 @@
 #include <SFML/Graphics/Rect.hpp>
 #include <cstdint>
 #include <expected>
+#include <memory>
+#include <tuple>
 
 #include "../game/Enemy.hpp"
 #include "../game/Level.hpp"
 #include "../game/Player.hpp"
+#include "buffer_pool.hpp"
+#include "snapshot.hpp"
 
 namespace network {
 
 namespace internal {
 
-// Byte sequence used to separate messages in TCP stream
-constexpr char VERSION[4] = {0, 0, 0, 1};
-constexpr char SEPARATOR[4] = {0x0F, 0x00, 0x01, 0x0A};
+// Every packet starts with the protocol version.
+// Packets are framed by the contentLength of the header
+constexpr char VERSION[4] = {0, 0, 0, 2};
 typedef uint16_t PacketType;
-typedef uint16_t PacketContentLength;
+typedef uint32_t PacketContentLength;
 typedef uint64_t Timestamp;
 
+// Largest body of a packet. Bigger ones aren't sent, and a header claiming
+// more is treated as a corrupted stream rather than waited for
+constexpr PacketContentLength MAX_CONTENT_LENGTH = 4 * 1024 * 1024;
+
 struct PacketHeader {
   PacketType type;
   PacketContentLength contentLength;
@@ -30,47 +38,61 @@ template <typename T> struct PacketWrapper {
   T body;
 };
 
-template <typename T> struct PacketCompare {
-  bool operator()(const PacketWrapper<T> &a, const PacketWrapper<T> &b) {
-    return a.header.timestamp > b.header.timestamp;
-  }
-};
-
 enum class PacketError { InvalidVersion, InvalidType, InvalidLength };
 
 constexpr int32_t HEADER_LENGTH_BYTES = sizeof(VERSION) + sizeof(PacketType) +
                                         sizeof(PacketContentLength) +
                                         sizeof(Timestamp);
+// Body size reserved with the header. Bodies of most packets fit in it, so
+// encoding them takes a single allocation
+constexpr size_t SMALL_BODY_BYTES = 32;
 
 template <typename T>
 constexpr inline void appendBytes(std::string &dest, const T &obj);
-// returns the number of bytes read
-template <typename T>
-constexpr inline size_t readBytes(std::string_view src, T &outObj,
-                                  size_t offset = 0);
 
-template <typename T>
-constexpr inline std::string serialize(const std::vector<T> &a);
-
-template <typename T>
-constexpr inline size_t deserialize(std::string_view s, std::vector<T> &out);
+// Bounds checked cursor over a received packet body.
+// Views the data in place (never allocates). A read past the end fails and
+// leaves the reader in the failed state, so a corrupted packet can be
+// detected by checking "ok" once after all the reads
+struct Reader {
+  explicit Reader(std::string_view data) : m_data(data) {}
+
+  template <typename T> bool read(T &outObj);
+  // Returns the next "count" bytes without copying them
+  std::optional<std::string_view> take(size_t count);
+
+  size_t remaining() const { return m_data.size() - m_offset; }
+  bool ok() const { return !m_failed; }
+  // True when every byte was read and nothing failed
+  bool finished() const { return ok() && remaining() == 0; }
+
+private:
+  std::string_view m_data;
+  size_t m_offset = 0;
+  bool m_failed = false;
+};
 
-void printPacket(const std::string &s);
+void printPacket(std::string_view s);
 
-std::string createPacketHeader(PacketType type,
-                               PacketContentLength contentLength);
+void appendPacketHeader(std::string &dest, PacketType type,
+                        PacketContentLength contentLength);
+// Overwrites the content length of an encoded header
+void writeContentLength(std::string &packet, PacketContentLength contentLength);
 
-std::expected<PacketHeader, PacketError> parseHeader(const std::string &packet);
+std::expected<PacketHeader, PacketError> parseHeader(std::string_view packet);
 
 } // namespace internal
 
 class Serializable {
-  virtual std::string serialize() const = 0;
-  virtual void deserialize(std::string_view body) = 0;
+  // Appends the body to dest - right after the header of the message, so
+  // nothing is built on the side
+  virtual void serialize(std::string &dest) const = 0;
+  // Returns false if the body is malformed
+  virtual bool deserialize(std::string_view body) = 0;
 };
 
 struct PlayerDisconnectedResponse {
-  int32_t playerID;
+  EntityID playerID;
 };
 
 struct JoinLobbyRequest {};
@@ -87,58 +109,102 @@ struct JoinLobbyResponse : public Serializable {
   JoinLobbyResponse(std::unordered_map<int32_t, bool> lobbyPlayers);
   std::unordered_map<int32_t, bool> lobbyPlayers;
 
-  std::string serialize() const override;
-  void deserialize(std::string_view body) override;
+  void serialize(std::string &dest) const override;
+  bool deserialize(std::string_view body) override;
 };
 
 struct StartGameResponse {};
-struct GameReadyRequest {};
 
-struct GameReadyResponse {
-  int32_t thisPlayerID;
-  sf::Vector2f thisPlayerPos;
-  int32_t otherID;
-  sf::Vector2f otherPlayerPos;
+struct CachedMap {
+  uint8_t id;
+  uint64_t hash;
+};
 
-  // TODO ::  Change this to vector and add customserialzation for this not to
-  // take millin bytes
-  Level::MapData map;
+struct GameReadyRequest : public Serializable {
+  GameReadyRequest() = default;
+  GameReadyRequest(std::vector<CachedMap> cachedMaps);
 
-  // std::string serialize() const;
-  // void deserialize(std::string_view body);
+  // Maps the client already has. The server doesn't send their tiles
+  std::vector<CachedMap> cachedMaps;
+
+  void serialize(std::string &dest) const override;
+  bool deserialize(std::string_view body) override;
+};
+
+// Maps are kept out of line so they don't make every packet 4 KB big
+typedef BufferPool<Level::MapData> MapBufferPool;
+
+struct GameReadyResponse : public Serializable {
+  EntityID thisPlayerID;
+  sf::Vector2f thisPlayerPos;
+  EntityID otherID;
+  sf::Vector2f otherPlayerPos;
+  // Seconds between two enemy/fireball snapshots. The client uses it to
+  // turn snapshot ticks into time for the interpolation
+  float snapshotInterval;
+
+  uint8_t mapID;
+  uint64_t mapHash;
+  // Empty when the client has the map cached. Otherwise the tiles are sent
+  // 3 bits each with runs of the same tile run-length encoded
+  MapBufferPool::Handle map;
+
+  void serialize(std::string &dest) const override;
+  bool deserialize(std::string_view body) override;
 };
 
 struct PlayerMoveRequest {
   Direction direction;
+  // Increases by one with every move of the client. The client predicts the
+  // move right away and matches it with the server's answer by this number
+  uint32_t sequence;
 };
 
-struct PlayerMoveResponse {
-  int32_t playerID;
+struct PlayerMoveResponse : public Serializable {
+  PlayerMoveResponse() = default;
+  PlayerMoveResponse(EntityID playerID, sf::Vector2f newPos,
+                     uint32_t lastSequence);
+
+  EntityID playerID;
   sf::Vector2f newPos;
+  // Sequence of the last PlayerMoveRequest of this player included in newPos
+  uint32_t lastSequence;
+
+  void serialize(std::string &dest) const override;
+  bool deserialize(std::string_view body) override;
 };
 
+// Enemies changed since the last snapshot acknowledged by the client
 struct EnemyUpdateResponse : public Serializable {
   EnemyUpdateResponse() = default;
-  EnemyUpdateResponse(std::vector<Enemy::DTO> enemies);
-  std::vector<Enemy::DTO> enemies;
-  std::string serialize() const override;
-  void deserialize(std::string_view body) override;
+  EnemyUpdateResponse(SnapshotDelta<Enemy::DTO> delta);
+  SnapshotDelta<Enemy::DTO> delta;
+  void serialize(std::string &dest) const override;
+  bool deserialize(std::string_view body) override;
 };
 
 struct FireballShotRequest {
-  int32_t playerID;
+  EntityID playerID;
   Fireball::DTO fireball;
 };
 
+// Fireballs changed since the last snapshot acknowledged by the client
 struct UpdateFireballsResponse : public Serializable {
 
   UpdateFireballsResponse() = default;
-  UpdateFireballsResponse(std::vector<Fireball::DTO> fireballs);
+  UpdateFireballsResponse(SnapshotDelta<Fireball::DTO> delta);
 
-  std::vector<Fireball::DTO> fireballs;
+  SnapshotDelta<Fireball::DTO> delta;
 
-  std::string serialize() const override;
-  void deserialize(std::string_view body) override;
+  void serialize(std::string &dest) const override;
+  bool deserialize(std::string_view body) override;
+};
+
+// Newest snapshots applied by the client. The server diffs the next ones
+// against them
+struct SnapshotAckRequest {
+  SnapshotTick enemyTick;
+  SnapshotTick fireballTick;
 };
 
 struct BaseHitResponse {
@@ -149,11 +215,55 @@ struct GameOverResponse {
   int isWon;
 };
 
+namespace internal {
+
+/**
+ * Wire layout of a packet (or a struct inside one) without custom
+ * serialization: its fields in the order they are written. There is no
+ * padding between them. Types without a schema are copied as they are
+ **/
+template <typename T> struct Schema;
+
+#define PACKET_SCHEMA(TYPE, ...)                                               \
+  template <> struct Schema<TYPE> {                                            \
+    static constexpr auto fields = std::make_tuple(__VA_ARGS__);               \
+  }
+
+PACKET_SCHEMA(Fireball::DTO, &Fireball::DTO::id, &Fireball::DTO::pos,
+              &Fireball::DTO::direction);
+
+PACKET_SCHEMA(PlayerDisconnectedResponse,
+              &PlayerDisconnectedResponse::playerID);
+PACKET_SCHEMA(JoinLobbyRequest);
+PACKET_SCHEMA(LobbyReadyRequst, &LobbyReadyRequst::isReady);
+PACKET_SCHEMA(LobbyReadyResponse, &LobbyReadyResponse::playerID,
+              &LobbyReadyResponse::isReady);
+PACKET_SCHEMA(StartGameResponse);
+PACKET_SCHEMA(PlayerMoveRequest, &PlayerMoveRequest::direction,
+              &PlayerMoveRequest::sequence);
+PACKET_SCHEMA(FireballShotRequest, &FireballShotRequest::playerID,
+              &FireballShotRequest::fireball);
+PACKET_SCHEMA(SnapshotAckRequest, &SnapshotAckRequest::enemyTick,
+              &SnapshotAckRequest::fireballTick);
+PACKET_SCHEMA(BaseHitResponse, &BaseHitResponse::newHealth);
+PACKET_SCHEMA(GameOverResponse, &GameOverResponse::isWon);
+
+#undef PACKET_SCHEMA
+
+template <typename T>
+concept HasSchema = requires { Schema<T>::fields; };
+
+// Number of bytes the type takes on the wire
+template <typename T> constexpr size_t wireSize();
+
+} // namespace internal
+
 void printBytes(std::string_view s);
 
 // TODO :: Change this to inheritance?
 typedef std::variant<JoinLobbyRequest, LobbyReadyRequst, GameReadyRequest,
-                     PlayerMoveRequest, FireballShotRequest>
+                     PlayerMoveRequest, FireballShotRequest,
+                     SnapshotAckRequest>
     ClientPacket;
 // TODO :: Change this to inheritance?
 typedef std::variant<PlayerDisconnectedResponse, JoinLobbyResponse,
@@ -162,11 +272,59 @@ typedef std::variant<PlayerDisconnectedResponse, JoinLobbyResponse,
                      UpdateFireballsResponse, BaseHitResponse, GameOverResponse>
     ServerPacket;
 
+// Delivery guarantee of a packet when it's sent over UDP.
+// Unreliable packets are latest-wins snapshots - a lost one is never resent
+// and an older one arriving after a newer one of the same type is dropped.
+// So only packets where the newest one replaces all the older ones can be
+// unreliable. A PlayerMoveResponse is only sent when the player moves and
+// there's one for every player, so it's reliable.
+// Reliable packets are resent until acknowledged and delivered in order.
+// TCP delivers everything reliably regardless of the channel
+enum class Channel : uint8_t { Unreliable, Reliable };
+
+template <typename T> constexpr Channel channelOf() {
+  return Channel::Reliable;
+}
+template <> constexpr Channel channelOf<EnemyUpdateResponse>() {
+  return Channel::Unreliable;
+}
+template <> constexpr Channel channelOf<UpdateFireballsResponse>() {
+  return Channel::Unreliable;
+}
+template <> constexpr Channel channelOf<SnapshotAckRequest>() {
+  return Channel::Unreliable;
+}
+
+template <class VARIANT> constexpr Channel channelOf(const VARIANT &packet) {
+  return std::visit(
+      [](auto &&p) { return channelOf<std::decay_t<decltype(p)>>(); },
+      packet);
+}
+
+// Encoding of the fields of packets with custom serialization (see Encoding
+// for the precision of the quantized one). Both sides must agree on it
+template <typename T> constexpr Encoding encodingOf() { return Encoding::Raw; }
+template <> constexpr Encoding encodingOf<PlayerMoveResponse>() {
+  return Encoding::Quantized;
+}
+template <> constexpr Encoding encodingOf<EnemyUpdateResponse>() {
+  return Encoding::Quantized;
+}
+template <> constexpr Encoding encodingOf<UpdateFireballsResponse>() {
+  return Encoding::Quantized;
+}
+
+// Returns an empty string when the body is over MAX_CONTENT_LENGTH. Queueing
+// an empty message does nothing
 template <class PACKET> std::string encodePacket(const PACKET &packet);
 
+// Encoded message. Broadcasts share a single instance between all the clients
+// instead of copying it into every queue
+typedef std::shared_ptr<const std::string> SharedMessage;
+
 template <class VARIANT>
 std::optional<internal::PacketWrapper<VARIANT>>
-decodePacket(const std::string &packet);
+decodePacket(std::string_view packet);
 
 } // namespace network
 
@@ -3,10 +3,13 @@
 #include <cstdint>
 #include <cstring>
 #include <expected>
+#include <limits>
 #include <optional>
-#include <stdexcept>
+#include <array>
 #include <string>
+#include <tuple>
 #include <type_traits>
+#include <utility>
 #include <variant>
 
 #include "../debug.hpp"
@@ -23,124 +26,181 @@ constexpr inline void appendBytes(std::string &dest, const T &obj) {
   dest.append((char *)&obj, sizeof(obj));
 }
 
-template <typename T>
-constexpr inline size_t readBytes(std::string_view src, T &obj, size_t offset) {
-  ASSERT(src.size() >= offset && "Offset is smaller than string");
-  LOG_DEBUG("buffer size: ", src.size(), " offset: ", offset,
-            " sizeof(T): ", sizeof(T));
-  ASSERT(sizeof(T) <= (src.size() - offset) && "Enough bytes to read");
+template <typename T> inline bool Reader::read(T &obj) {
+  static_assert(std::is_trivially_copyable_v<T>);
+
+  if (m_failed || remaining() < sizeof(T)) {
+    LOG_DEBUG("Reading past the end. remaining: ", remaining(),
+              " sizeof(T): ", sizeof(T));
+    m_failed = true;
+    return false;
+  }
 
-  std::memcpy(&obj, src.data() + offset, sizeof(T));
+  std::memcpy(&obj, m_data.data() + m_offset, sizeof(T));
+  m_offset += sizeof(T);
 
-  return sizeof(T);
+  return true;
 }
 
-template <typename T>
-constexpr inline std::string serialize(const std::vector<T> &a) {
-
-  std::string b;
-  appendBytes(b, a.size());
-  LOG_DEBUG("b: ");
-  DEBUG_ONLY(printBytes(b));
-  for (const auto &x : a) {
-    appendBytes(b, x);
+inline std::optional<std::string_view> Reader::take(size_t count) {
+  if (m_failed || remaining() < count) {
+    m_failed = true;
+    return std::nullopt;
   }
 
-  return b;
+  std::string_view result = m_data.substr(m_offset, count);
+  m_offset += count;
+
+  return result;
 }
 
 template <typename T>
-constexpr inline size_t deserialize(std::string_view s, std::vector<T> &out) {
-  size_t offset = 0;
-  size_t count = 0;
-  offset += readBytes(s, count);
-
-  out.reserve(count);
-  out.clear();
-
-  for (int i = 0; i < count; ++i) {
-    T x;
-    offset += readBytes(s, x, offset);
-    out.push_back(x);
+concept HasCustomSerialization = std::is_base_of_v<Serializable, T>;
+
+template <typename M> struct MemberType;
+template <typename C, typename F> struct MemberType<F C::*> {
+  using type = F;
+};
+
+template <typename T> constexpr size_t wireSize() {
+  if constexpr (HasSchema<T>) {
+    return std::apply(
+        [](auto... fields) {
+          return (size_t{0} + ... +
+                  wireSize<typename MemberType<decltype(fields)>::type>());
+        },
+        Schema<T>::fields);
+  } else {
+    static_assert(std::is_trivially_copyable_v<T>);
+    return sizeof(T);
+  }
+}
+
+// Copies the fields listed by the schema one after another. Returns the end
+// of what was written
+template <typename T> inline char *writeFields(char *dest, const T &obj) {
+  if constexpr (HasSchema<T>) {
+    std::apply(
+        [&](auto... fields) { ((dest = writeFields(dest, obj.*fields)), ...); },
+        Schema<T>::fields);
+    return dest;
+  } else {
+    std::memcpy(dest, &obj, sizeof(T));
+    return dest + sizeof(T);
   }
+}
 
-  return offset;
+template <typename T> inline bool readFields(Reader &src, T &obj) {
+  if constexpr (HasSchema<T>) {
+    return std::apply(
+        [&](auto... fields) { return (readFields(src, obj.*fields) && ...); },
+        Schema<T>::fields);
+  } else {
+    return src.read(obj);
+  }
 }
 
-template <typename T>
-concept HasCustomSerialization = std::is_base_of_v<Serializable, T>;
+template <class VARIANT>
+using PacketEncoder = void (*)(std::string &dest, const VARIANT &packet);
+template <class VARIANT>
+using PacketDecoder = std::optional<VARIANT> (*)(std::string_view body);
 
-template <typename VARIANT>
-constexpr std::string serializePacket(const VARIANT &packet) {
-
-  std::string packetBody;
-  std::visit(
-      [&packetBody](auto &&p) {
-        using T = std::decay_t<decltype(p)>;
-        if constexpr (HasCustomSerialization<T>) {
-          LOG_DEBUG("Custom serialization");
-          packetBody.append(p.serialize());
-        } else {
-          char buf[sizeof(T)] = {0};
-          std::memcpy(buf, &p, sizeof(T));
-          packetBody.append(buf, sizeof(T));
-        }
-      },
-      packet);
-
-  return packetBody;
+template <class VARIANT, size_t INDEX>
+void encodeAlternative(std::string &dest, const VARIANT &packet) {
+  using T = std::variant_alternative_t<INDEX, VARIANT>;
+  const T &p = *std::get_if<INDEX>(&packet);
+
+  if constexpr (HasCustomSerialization<T>) {
+    p.serialize(dest);
+  } else {
+    // Packed on the stack first, so the string is only grown once
+    std::array<char, wireSize<T>()> fields;
+    writeFields(fields.data(), p);
+    dest.append(fields.data(), fields.size());
+  }
 }
 
-template <class VARIANT, PacketType INDEX = 0>
-VARIANT deserializePacket(PacketType index, const std::string &data) {
-  if constexpr (INDEX < std::variant_size_v<VARIANT>) {
-    if (index == INDEX) {
-      using alt = std::variant_alternative_t<INDEX, VARIANT>;
-      LOG_DEBUG("DATA_SIZE: ", data.size());
-      LOG_DEBUG("altSize: ", sizeof(alt));
-      alt obj;
-
-      if constexpr (HasCustomSerialization<alt>) {
-        LOG_DEBUG("Custom serialization");
-        obj.deserialize(data);
-      } else {
-        ASSERT(data.size() == sizeof(alt));
-        std::memcpy(&obj, data.data(), sizeof(alt));
-      }
-
-      return VARIANT{std::move(obj)};
-    } else {
-      return deserializePacket<VARIANT, INDEX + 1>(index, data);
-    }
+// Returns std::nullopt when the body doesn't match the packet type
+template <class VARIANT, size_t INDEX>
+std::optional<VARIANT> decodeAlternative(std::string_view body) {
+  using T = std::variant_alternative_t<INDEX, VARIANT>;
+  T obj;
+
+  if constexpr (HasCustomSerialization<T>) {
+    if (!obj.deserialize(body))
+      return std::nullopt;
   } else {
-    throw std::out_of_range("Invalid variant index");
+    // Fixed size packets are read field by field from the received view
+    Reader reader(body);
+    if (body.size() != wireSize<T>() || !readFields(reader, obj))
+      return std::nullopt;
   }
+
+  return VARIANT(std::in_place_index<INDEX>, std::move(obj));
 }
-} // namespace internal
 
-template <class PACKET> std::string encodePacket(const PACKET &packet) {
-  std::string body = internal::serializePacket(packet);
+template <class VARIANT, size_t... INDICES>
+constexpr auto makeEncoders(std::index_sequence<INDICES...>) {
+  return std::array<PacketEncoder<VARIANT>, sizeof...(INDICES)>{
+      &encodeAlternative<VARIANT, INDICES>...};
+}
+
+template <class VARIANT, size_t... INDICES>
+constexpr auto makeDecoders(std::index_sequence<INDICES...>) {
+  return std::array<PacketDecoder<VARIANT>, sizeof...(INDICES)>{
+      &decodeAlternative<VARIANT, INDICES>...};
+}
+
+// Serializers and deserializers of every packet indexed by PacketType
+template <class VARIANT>
+constexpr auto PACKET_ENCODERS = makeEncoders<VARIANT>(
+    std::make_index_sequence<std::variant_size_v<VARIANT>>{});
+template <class VARIANT>
+constexpr auto PACKET_DECODERS = makeDecoders<VARIANT>(
+    std::make_index_sequence<std::variant_size_v<VARIANT>>{});
 
-  LOG_DEBUG("Body size bytes: ", body.size());
+// Appends the body of the packet
+template <typename VARIANT>
+inline void serializePacket(std::string &dest, const VARIANT &packet) {
+  PACKET_ENCODERS<VARIANT>[packet.index()](dest, packet);
+}
 
-  std::string msg = internal::createPacketHeader(
-      (internal::PacketType)packet.index(), body.size());
+template <class VARIANT>
+std::optional<VARIANT> deserializePacket(PacketType index,
+                                         std::string_view data) {
+  if (index >= std::variant_size_v<VARIANT>)
+    return std::nullopt;
+  return PACKET_DECODERS<VARIANT>[index](data);
+}
+} // namespace internal
 
-  LOG_DEBUG("Encoded Header bytes:");
-  DEBUG_ONLY(printBytes(msg));
+template <class PACKET> std::string encodePacket(const PACKET &packet) {
+  // The body is written right after the header. The content length is filled
+  // in once the body size is known
+  std::string msg;
+  msg.reserve(internal::HEADER_LENGTH_BYTES + internal::SMALL_BODY_BYTES);
+  internal::appendPacketHeader(msg, (internal::PacketType)packet.index(), 0);
+  internal::serializePacket(msg, packet);
+
+  const size_t bodySize = msg.size() - internal::HEADER_LENGTH_BYTES;
+  LOG_DEBUG("Body size bytes: ", bodySize);
+  if (bodySize > internal::MAX_CONTENT_LENGTH) {
+    LOG_ERROR("Packet ", packet.index(), " not sent. Body of ", bodySize,
+              " bytes is over the limit of ", internal::MAX_CONTENT_LENGTH);
+    return {};
+  }
+  internal::writeContentLength(msg, bodySize);
 
-  LOG_DEBUG("Packet index: ", packet.index(), " body size: ", body.size());
-  msg.append(body);
-  msg.append(internal::SEPARATOR, sizeof(internal::SEPARATOR));
+  LOG_DEBUG("Packet index: ", packet.index(), " body size: ", bodySize);
 
   DEBUG_ONLY(internal::printPacket(msg));
-  LOG_DEBUG("Encoded message size (with separator): ", msg.size());
+  LOG_DEBUG("Encoded message size: ", msg.size());
 
   return msg;
 }
 template <class VARIANT>
 std::optional<internal::PacketWrapper<VARIANT>>
-decodePacket(const std::string &packet) {
+decodePacket(std::string_view packet) {
 
   DEBUG_ONLY(internal::printPacket(packet));
 
@@ -171,20 +231,30 @@ decodePacket(const std::string &packet) {
 
   LOG_DEBUG("Packet size:", packet.size(), " type: ", type, " length ", length);
 
-  ASSERT(bodysize == length &&
-         "Packet content length is equal to specified in header");
+  if (bodysize != length) {
+    LOG_ERROR("Packet content length (", length,
+              ") doesn't match the body size (", bodysize, ")");
+    return std::nullopt;
+  }
 
-  const std::string &body =
-      packet.substr(internal::HEADER_LENGTH_BYTES, std::string::npos);
+  // View of the body. Nothing is copied until the packet itself is built
+  const std::string_view body = packet.substr(internal::HEADER_LENGTH_BYTES);
 
   LOG_DEBUG("Body size: ", body.size());
 
   auto decoded = internal::deserializePacket<VARIANT>(type, body);
 
+  if (!decoded) {
+    LOG_ERROR("Malformed body of packet with type: ", type);
+    return std::nullopt;
+  }
+
   LOG_DEBUG("Packet decoded");
 
   return internal::PacketWrapper<VARIANT>{.header = *headerResult,
-                                          .body = decoded};
+                                          .body = std::move(*decoded)};
 }
 
 } // namespace network
+
+#include "snapshot_impl.hpp"
@@ -0,0 +1,60 @@
+#include "poller.hpp"
+#include "../logging.hpp"
+#include <cerrno>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+namespace network {
+
+Poller::Poller() : m_epollfd(epoll_create1(EPOLL_CLOEXEC)), m_events(8) {
+  if (m_epollfd < 0) {
+    LOG_ERROR("Couldn't create epoll instance. errno: ", errno);
+  }
+}
+
+Poller::~Poller() {
+  if (m_epollfd >= 0)
+    ::close(m_epollfd);
+}
+
+bool Poller::add(int32_t fd, uint32_t events) {
+  epoll_event ev = {};
+  ev.events = events;
+  ev.data.fd = fd;
+
+  if (epoll_ctl(m_epollfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    LOG_ERROR("Couldn't register fd ", fd, " in epoll. errno: ", errno);
+    return false;
+  }
+
+  ++m_registered;
+  // Making sure a single wait can report every registered descriptor
+  if (m_events.size() < m_registered)
+    m_events.resize(m_registered * 2);
+
+  return true;
+}
+
+bool Poller::remove(int32_t fd) {
+  if (epoll_ctl(m_epollfd, EPOLL_CTL_DEL, fd, nullptr) < 0) {
+    LOG_ERROR("Couldn't unregister fd ", fd, " from epoll. errno: ", errno);
+    return false;
+  }
+  --m_registered;
+  return true;
+}
+
+std::span<const epoll_event> Poller::wait(int timeoutMs) {
+  const int ready =
+      epoll_wait(m_epollfd, m_events.data(), m_events.size(), timeoutMs);
+
+  if (ready < 0) {
+    if (errno != EINTR)
+      LOG_ERROR("epoll_wait failed. errno: ", errno);
+    return {};
+  }
+
+  return std::span<const epoll_event>(m_events.data(), ready);
+}
+
+} // namespace network
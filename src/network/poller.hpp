@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <sys/epoll.h>
+#include <vector>
+
+namespace network {
+
+// Counters describing the work done by a single call to "poll"
+struct PollStats {
+  // epoll_wait + accept + recv calls issued during the poll
+  uint32_t syscalls = 0;
+  // Number of descriptors reported as ready by epoll
+  uint32_t readyEvents = 0;
+  // Number of clients accepted during the poll (server only)
+  uint32_t accepted = 0;
+};
+
+// Thin wrapper around epoll.
+// Descriptors are registered once and "wait" returns only the ready ones, so
+// idle sockets cost nothing per tick.
+struct Poller {
+
+  Poller();
+  ~Poller();
+
+  Poller(const Poller &) = delete;
+  Poller &operator=(const Poller &) = delete;
+
+  bool add(int32_t fd, uint32_t events = EPOLLIN | EPOLLRDHUP);
+  bool remove(int32_t fd);
+
+  // Returns the descriptors that are ready.
+  // timeoutMs = 0 returns immediately (never blocks the frame)
+  std::span<const epoll_event> wait(int timeoutMs = 0);
+
+  bool isValid() const { return m_epollfd >= 0; }
+
+private:
+  int32_t m_epollfd;
+  uint32_t m_registered = 0;
+  std::vector<epoll_event> m_events;
+};
+
+} // namespace network
@@ -0,0 +1,68 @@
+#include "receive_buffer.hpp"
+#include "../debug.hpp"
+#include "../logging.hpp"
+#include "packet.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace network {
+
+std::span<char> ReceiveBuffer::writable(size_t minimum) {
+  // Everything was consumed - starting from the front again for free
+  if (m_read == m_write) {
+    m_read = 0;
+    m_write = 0;
+  }
+
+  if (m_data.size() - m_write < minimum && m_read > 0) {
+    // Moving the unread tail to the front
+    const size_t pending = size();
+    std::memmove(m_data.data(), m_data.data() + m_read, pending);
+    m_read = 0;
+    m_write = pending;
+  }
+
+  if (m_data.size() - m_write < minimum) {
+    m_data.resize(std::max(m_data.size() * 2, m_write + minimum));
+  }
+
+  return std::span<char>(m_data.data() + m_write, m_data.size() - m_write);
+}
+
+void ReceiveBuffer::commit(size_t count) {
+  ASSERT(m_write + count <= m_data.size() && "Commit within buffer");
+  m_write += count;
+}
+
+std::optional<std::string_view> ReceiveBuffer::nextFrame() {
+  const std::string_view pending(m_data.data() + m_read, size());
+
+  if (pending.size() < internal::HEADER_LENGTH_BYTES)
+    return std::nullopt;
+
+  auto header = internal::parseHeader(pending);
+
+  if (!header) {
+    // Without a valid header there's no way to find the next frame
+    LOG_ERROR("Corrupted stream. Dropping ", pending.size(), " bytes");
+    clear();
+    return std::nullopt;
+  }
+
+  const size_t frameLength =
+      internal::HEADER_LENGTH_BYTES + header->contentLength;
+
+  if (pending.size() < frameLength)
+    return std::nullopt;
+
+  m_read += frameLength;
+
+  return pending.substr(0, frameLength);
+}
+
+void ReceiveBuffer::clear() {
+  m_read = 0;
+  m_write = 0;
+}
+
+} // namespace network
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace network {
+
+/**
+ * Receive buffer of a single socket.
+ *
+ * Data is read straight into the free space behind the write cursor and
+ * complete frames (header + body, sized by the contentLength of the header)
+ * are handed out as views from the read cursor. Nothing is copied or shifted
+ * per message - the unread tail (at most one partial frame) is moved to the
+ * front only when the free space runs out, so a burst of packets is parsed in
+ * linear time.
+ **/
+struct ReceiveBuffer {
+
+  // Returns at least "minimum" bytes of free space behind the write cursor.
+  // Invalidates views returned by "nextFrame"
+  std::span<char> writable(size_t minimum);
+  // Marks "count" bytes written into "writable" as received
+  void commit(size_t count);
+
+  // Returns the next complete frame or std::nullopt if it hasn't fully
+  // arrived yet. The view is valid until the next call to "writable"
+  std::optional<std::string_view> nextFrame();
+
+  size_t size() const { return m_write - m_read; }
+  void clear();
+
+private:
+  std::vector<char> m_data;
+  size_t m_read = 0;
+  size_t m_write = 0;
+};
+
+} // namespace network
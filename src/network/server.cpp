@@ -1,5 +1,6 @@
 #include <algorithm>
 #include <arpa/inet.h>
+#include <array>
 #include <cassert>
 #include <cstring>
 #include <netinet/in.h>
@@ -20,15 +21,22 @@ Server::Server() : m_socket(Socket::NULL_SOCKET), m_clients({}) {}
 
 Server::~Server() { m_socket.shutdown(); }
 
-bool Server::bind(const char *ipAddress, unsigned short port) {
+bool Server::bind(const char *ipAddress, unsigned short port,
+                  SocketType transport) {
 
-  auto result = Socket::create(ipAddress, port, SocketType::TCP, 0);
+  auto result = Socket::create(ipAddress, port, transport, 0);
 
   if (!result)
     return false;
 
   m_socket = result.value();
 
+  // Connected client sockets are bound to the same port
+  if (transport == SocketType::UDP && !m_socket.setReusePort()) {
+    LOG_ERROR("Couldn't set SO_REUSEPORT on server socket");
+    return false;
+  }
+
   // Binding the server
   if (::bind(m_socket.fd, (struct sockaddr *)&m_socket.addr, m_socket.addrlen) <
       0) {
@@ -39,7 +47,7 @@ bool Server::bind(const char *ipAddress, unsigned short port) {
   }
 
   // default 4 clients
-  if (listen(m_socket.fd, 4) < 0) {
+  if (transport == SocketType::TCP && listen(m_socket.fd, 4) < 0) {
     LOG_ERROR("listen failed");
     return false;
   }
@@ -48,128 +56,249 @@ bool Server::bind(const char *ipAddress, unsigned short port) {
   if (!m_socket.setBlocking(false))
     return false;
 
+  if (!m_poller.add(m_socket.fd, EPOLLIN))
+    return false;
+
   return true;
 }
 
-bool Server::tryAcceptClient() {
-  auto result = m_socket.accept();
+const PollStats &Server::poll() {
+  m_pollStats = PollStats{};
 
-  if (result.has_value()) {
-    Socket s = *result;
-    m_clients.push_back(s);
-    s.setBlocking(false);
-    return true;
+  auto events = m_poller.wait(0);
+  ++m_pollStats.syscalls;
+  m_pollStats.readyEvents = events.size();
+
+  std::vector<int32_t> closed;
+
+  for (const epoll_event &event : events) {
+    if (event.data.fd == m_socket.fd) {
+      acceptClients();
+      continue;
+    }
+
+    Socket *client = findClient(event.data.fd);
+    if (!client)
+      continue;
+
+    const bool isConnected = receive(*client);
+
+    // Peer hung up. Everything it sent before that was already read above
+    if (!isConnected || event.events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+      closed.push_back(event.data.fd);
   }
-  return false;
-}
 
-std::optional<SocketError> Server::sendAll(network::ServerPacket packet) {
-  auto msg = encodePacket(packet);
-  size_t len = msg.size();
+  for (int32_t fd : closed) {
+    if (findClient(fd))
+      disconnect(fd);
+  }
 
-  int clients = m_clients.size();
+  if (m_pollStats.readyEvents > 0) {
+    LOG_DEBUG("Poll: ready events: ", m_pollStats.readyEvents,
+              " syscalls: ", m_pollStats.syscalls,
+              " accepted: ", m_pollStats.accepted);
+  }
 
-  for (int i = clients - 1; i >= 0; --i) {
+  return m_pollStats;
+}
 
-    Socket &client = m_clients[i];
+void Server::acceptClients() {
+  if (m_socket.type == SocketType::UDP) {
+    acceptDatagramClients();
+    return;
+  }
 
-    auto err = client.send(msg.c_str(), len);
+  // Listening socket is level triggered so anything left here will be
+  // reported again in the next poll
+  while (true) {
+    auto result = m_socket.accept();
+    ++m_pollStats.syscalls;
 
-    if (err) {
-      LOG_ERROR("SendAll client error", std::to_underlying(*err));
-      if (err == SocketError::Disconnected) {
-        LOG_INFO("Client disconnected");
-        m_clients.erase(m_clients.begin() + i);
-        m_onDisconnect(client.fd);
-      }
-      return *err;
+    if (!result)
+      return;
+
+    Socket s = *result;
+    s.setBlocking(false);
+
+    if (!m_poller.add(s.fd)) {
+      s.close();
+      continue;
     }
+
+    addClient(s);
+    ++m_pollStats.accepted;
+    LOG_INFO("Client connected (fd: ", s.fd, ")");
   }
-  return std::nullopt;
 }
-std::optional<SocketError> Server::sendOthers(const Socket *client,
-                                              network::ServerPacket packet) {
-  auto msg = encodePacket(packet);
-  size_t len = msg.size();
 
-  int clients = m_clients.size();
-  for (int i = clients - 1; i >= 0; --i) {
-    Socket &current = m_clients[i];
+void Server::acceptDatagramClients() {
+  // Only handshakes are expected here. Everything else a client sends goes
+  // to its connected socket
+  std::array<char, 512> buf;
 
-    if (client->fd == current.fd)
+  while (true) {
+    struct sockaddr_in from = {};
+    socklen_t len = sizeof(from);
+
+    const ssize_t bytesRead = recvfrom(m_socket.fd, buf.data(), buf.size(), 0,
+                                       (struct sockaddr *)&from, &len);
+    ++m_pollStats.syscalls;
+
+    if (bytesRead < 0)
+      return;
+
+    internal::Reader reader(std::string_view(buf.data(), bytesRead));
+    auto header = internal::readDatagramHeader(reader);
+
+    if (!header || header->kind != internal::DatagramKind::Connect)
       continue;
 
-    auto err = current.send(msg.c_str(), len);
-    if (err) {
-      LOG_ERROR("SendOthers client error", std::to_underlying(*err));
-      if (err == SocketError::Disconnected) {
-        LOG_INFO("Client disconnected");
-        m_clients.erase(m_clients.begin() + i);
-        m_onDisconnect(current.fd);
-      }
-      return *err;
+    // Handshake retried before the connected socket took over
+    if (Socket *existing = findClient(from)) {
+      existing->sendControl(internal::DatagramKind::Accept);
+      continue;
     }
+
+    auto result = Socket::acceptDatagram(m_socket, from, ++m_lastConnectionID);
+    if (!result)
+      continue;
+
+    Socket s = *result;
+    if (!m_poller.add(s.fd, EPOLLIN)) {
+      s.close();
+      continue;
+    }
+
+    addClient(s);
+    ++m_pollStats.accepted;
+    LOG_INFO("Client connected over UDP (fd: ", s.fd,
+             " connection: ", s.udp->id, ")");
   }
-  return std::nullopt;
 }
 
-void Server::setOnDisconnectCallback(std::function<void(int32_t)> cb) {
-  m_onDisconnect = cb;
+bool Server::receive(Socket &client) {
+  auto e = client.receive(&m_pollStats.syscalls);
+
+  while (auto packet = client.nextMessage<network::ClientPacket>()) {
+    m_incomingPackets.push(
+        ClientMessage{.fd = client.fd, .packet = std::move(*packet)});
+  }
+
+  if (e == SocketError::Disconnected)
+    return false;
+
+  if (e)
+    LOG_ERROR("Receive failed for client ", client.fd);
+
+  return true;
 }
 
-std::optional<SocketError> Server::send(Socket *client,
-                                        network::ServerPacket packet) {
-  auto msg = encodePacket(packet);
-  size_t len = msg.size();
-
-  auto err = client->send(msg.c_str(), len);
-  if (err) {
-    if (err == SocketError::Disconnected) {
-      LOG_ERROR(
-          "Client is disconnected cannot send IT IS NOT REMOVED from clients");
-      m_clients.resize(std::distance(
-          m_clients.begin(),
-          std::remove_if(m_clients.begin(), m_clients.end(),
-                         [client](Socket s) { return s.fd == client->fd; })));
-      m_onDisconnect(client->fd);
-    }
+void Server::addClient(const Socket &client) {
+  if (static_cast<size_t>(client.fd) >= m_clientIndices.size())
+    m_clientIndices.resize(client.fd + 1, -1);
+  m_clientIndices[client.fd] = static_cast<int32_t>(m_clients.size());
+  m_clients.push_back(client);
+}
+
+void Server::disconnect(int32_t fd) {
+  LOG_INFO("Client disconnected (fd: ", fd, ")");
+
+  m_poller.remove(fd);
 
-    return *err;
+  if (Socket *client = findClient(fd)) {
+    const size_t index = client - m_clients.data();
+    client->close();
+    m_clients.erase(m_clients.begin() + index);
+    m_clientIndices[fd] = -1;
+
+    // Clients behind it moved one place to the front
+    for (size_t i = index; i < m_clients.size(); ++i)
+      m_clientIndices[m_clients[i].fd] = static_cast<int32_t>(i);
   }
 
-  return std::nullopt;
+  if (m_onDisconnect)
+    m_onDisconnect(fd);
+}
+
+Socket *Server::findClient(int32_t fd) {
+  if (fd < 0 || static_cast<size_t>(fd) >= m_clientIndices.size() ||
+      m_clientIndices[fd] < 0)
+    return nullptr;
+  return &m_clients[m_clientIndices[fd]];
 }
 
-std::optional<SocketError> Server::receive() {
+Socket *Server::findClient(const sockaddr_in &addr) {
   for (Socket &client : m_clients) {
-    auto e = client.receive();
-    if (e)
-      return e;
+    if (client.addr.sin_addr.s_addr == addr.sin_addr.s_addr &&
+        client.addr.sin_port == addr.sin_port)
+      return &client;
+  }
+  return nullptr;
+}
+
+void Server::sendAll(const network::ServerPacket &packet) {
+  auto msg = std::make_shared<const std::string>(encodePacket(packet));
+  const Channel channel = channelOf(packet);
+
+  for (Socket &client : m_clients) {
+    client.queue(msg, channel);
+  }
+}
 
-    auto packet = client.nextMessage<network::ClientPacket>();
+void Server::sendOthers(const Socket *client,
+                        const network::ServerPacket &packet) {
+  auto msg = std::make_shared<const std::string>(encodePacket(packet));
+  const Channel channel = channelOf(packet);
 
-    if (!packet)
+  for (Socket &current : m_clients) {
+    if (client->fd == current.fd)
       continue;
 
-    m_incomingPackets.push(ClientMessage{.socket = &client, .packet = *packet});
+    current.queue(msg, channel);
   }
-  return std::nullopt;
 }
 
-std::optional<std::pair<Socket *, network::ClientPacket>>
-Server::pollMessage() {
-  if (receive()) {
-    LOG_ERROR("Receive failed");
+void Server::setOnDisconnectCallback(std::function<void(int32_t)> cb) {
+  m_onDisconnect = cb;
+}
+
+void Server::send(Socket *client, const network::ServerPacket &packet) {
+  client->queue(std::make_shared<const std::string>(encodePacket(packet)),
+                channelOf(packet));
+}
+
+void Server::flush() {
+  std::vector<int32_t> disconnected;
+
+  for (Socket &client : m_clients) {
+    auto err = client.flush();
+
+    if (err) {
+      LOG_ERROR("Flush client error", std::to_underlying(*err));
+      if (err == SocketError::Disconnected)
+        disconnected.push_back(client.fd);
+    }
   }
 
-  if (m_incomingPackets.empty()) {
-    return std::nullopt;
+  // Disconnecting after the loop as the callback is free to send packets
+  for (int32_t fd : disconnected) {
+    if (findClient(fd))
+      disconnect(fd);
   }
+}
 
-  const auto packet = m_incomingPackets.top();
-  m_incomingPackets.pop();
+std::optional<std::pair<Socket *, network::ClientPacket>>
+Server::pollMessage() {
+  while (auto message = m_incomingPackets.pop()) {
+    // Client could have disconnected after the message was received
+    Socket *client = findClient(message->fd);
+    if (!client)
+      continue;
 
-  return std::make_pair(packet.socket, packet.packet.body);
+    return std::make_pair(client, std::move(message->packet.body));
+  }
+
+  return std::nullopt;
 }
 
 } // namespace network
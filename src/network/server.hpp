@@ -1,8 +1,9 @@
 #pragma once
 #include "packet.hpp"
+#include "poller.hpp"
+#include "message_queue.hpp"
 #include "socket.hpp"
 #include <netinet/in.h>
-#include <queue>
 #include <vector>
 
 namespace network {
@@ -16,42 +17,63 @@ struct Server {
    * Initializes the server socket.
    * !! Must be called before trying to use any other function !!
    **/
-  bool bind(const char *ipAddress, unsigned short port);
-  bool tryAcceptClient();
-  //
+  bool bind(const char *ipAddress, unsigned short port,
+            SocketType transport = SocketType::TCP);
+
+  /**
+   * Runs one iteration of the event loop.
+   * Accepts pending clients and drains only the sockets that are readable.
+   * Should be called once per tick before "pollMessage"
+   **/
+  const PollStats &poll();
+  // Returns the next message received during the last "poll"
   std::optional<std::pair<Socket *, network::ClientPacket>> pollMessage();
-  std::optional<SocketError> sendAll(network::ServerPacket packet);
-  std::optional<SocketError> sendOthers(const Socket *client,
-                                        network::ServerPacket packet);
-  std::optional<SocketError> send(Socket *client, network::ServerPacket packet);
 
-  // Read all pending data from sockets
+  // Packets are only queued here. They are written to the clients by "flush"
+  void sendAll(const network::ServerPacket &packet);
+  void sendOthers(const Socket *client, const network::ServerPacket &packet);
+  void send(Socket *client, const network::ServerPacket &packet);
+
+  /**
+   * Writes everything queued for every client, one sendmsg per client.
+   * Should be called once at the end of a tick
+   **/
+  void flush();
 
   const std::vector<Socket> &getClients() { return m_clients; }
+  // Returns nullptr if there is no client with the descriptor
+  Socket *findClient(int32_t fd);
+  const PollStats &getPollStats() const { return m_pollStats; }
   void setOnDisconnectCallback(std::function<void(int32_t)> cb);
 
 private:
   struct ClientMessage {
-    Socket *socket;
+    // Descriptor of the sender. Resolved to socket when the message is polled
+    // so the message doesn't outlive the client
+    int32_t fd;
     internal::PacketWrapper<network::ClientPacket> packet;
-
-    struct Comparator {
-      bool operator()(const ClientMessage &a, const ClientMessage &b) {
-        auto x = internal::PacketCompare<network::ClientPacket>();
-        return x(a.packet, b.packet);
-      }
-    };
   };
 
-  std::optional<SocketError> receive();
+  void acceptClients();
+  void acceptDatagramClients();
+  void addClient(const Socket &client);
+  // Returns false when the client has closed the connection
+  bool receive(Socket &client);
+  void disconnect(int32_t fd);
+  Socket *findClient(const sockaddr_in &addr);
 
-  std::priority_queue<ClientMessage, std::vector<ClientMessage>,
-                      ClientMessage::Comparator>
-      m_incomingPackets;
+  // Messages of all the clients in arrival order
+  MessageQueue<ClientMessage> m_incomingPackets;
 
   Socket m_socket;
+  Poller m_poller;
+  PollStats m_pollStats;
+  internal::ConnectionID m_lastConnectionID = 0;
 
   std::vector<Socket> m_clients;
+  // Index of every client in m_clients by descriptor, -1 for the others.
+  // Descriptors are small numbers so every event is looked up in O(1)
+  std::vector<int32_t> m_clientIndices;
   std::function<void(int32_t)> m_onDisconnect;
 };
 } // namespace network
@@ -0,0 +1,99 @@
+#include "snapshot.hpp"
+#include "packet.hpp"
+
+namespace network {
+
+FieldMask DeltaTraits<Enemy::DTO>::diff(const Enemy::DTO &from,
+                                        const Enemy::DTO &to) {
+  FieldMask mask = 0;
+  if (from.pos != to.pos)
+    mask |= Pos;
+  if (from.destination != to.destination)
+    mask |= Destination;
+  if (from.health != to.health)
+    mask |= Health;
+  return mask;
+}
+
+void DeltaTraits<Enemy::DTO>::apply(Enemy::DTO &dest, const Enemy::DTO &src,
+                                    FieldMask mask) {
+  if (mask & Pos)
+    dest.pos = src.pos;
+  if (mask & Destination)
+    dest.destination = src.destination;
+  if (mask & Health)
+    dest.health = src.health;
+}
+
+void DeltaTraits<Enemy::DTO>::write(internal::BitWriter &dest,
+                                    const Enemy::DTO &dto, FieldMask mask,
+                                    Encoding encoding) {
+  if (mask & Pos)
+    internal::writePosition(dest, dto.pos, encoding);
+  if (mask & Destination)
+    internal::writePosition(dest, dto.destination, encoding);
+  if (mask & Health)
+    internal::writeHealth(dest, dto.health, encoding);
+}
+
+bool DeltaTraits<Enemy::DTO>::read(internal::BitReader &src, Enemy::DTO &dto,
+                                   FieldMask mask, Encoding encoding) {
+  if (mask & Pos)
+    internal::readPosition(src, dto.pos, encoding);
+  if (mask & Destination)
+    internal::readPosition(src, dto.destination, encoding);
+  if (mask & Health)
+    internal::readHealth(src, dto.health, encoding);
+  return src.ok();
+}
+
+uint32_t DeltaTraits<Enemy::DTO>::bits(FieldMask mask, Encoding encoding) {
+  return (mask & Pos ? internal::positionBits(encoding) : 0) +
+         (mask & Destination ? internal::positionBits(encoding) : 0) +
+         (mask & Health ? internal::healthBits(encoding) : 0);
+}
+
+FieldMask DeltaTraits<Fireball::DTO>::diff(const Fireball::DTO &from,
+                                           const Fireball::DTO &to) {
+  FieldMask mask = 0;
+  if (from.pos != to.pos)
+    mask |= Pos;
+  if (from.direction != to.direction)
+    mask |= Direction;
+  return mask;
+}
+
+void DeltaTraits<Fireball::DTO>::apply(Fireball::DTO &dest,
+                                       const Fireball::DTO &src,
+                                       FieldMask mask) {
+  if (mask & Pos)
+    dest.pos = src.pos;
+  if (mask & Direction)
+    dest.direction = src.direction;
+}
+
+void DeltaTraits<Fireball::DTO>::write(internal::BitWriter &dest,
+                                       const Fireball::DTO &dto,
+                                       FieldMask mask, Encoding encoding) {
+  if (mask & Pos)
+    internal::writePosition(dest, dto.pos, encoding);
+  if (mask & Direction)
+    internal::writeDirection(dest, dto.direction, encoding);
+}
+
+bool DeltaTraits<Fireball::DTO>::read(internal::BitReader &src,
+                                      Fireball::DTO &dto, FieldMask mask,
+                                      Encoding encoding) {
+  if (mask & Pos)
+    internal::readPosition(src, dto.pos, encoding);
+  if (mask & Direction)
+    internal::readDirection(src, dto.direction, encoding);
+  return src.ok();
+}
+
+uint32_t DeltaTraits<Fireball::DTO>::bits(FieldMask mask, Encoding encoding) {
+  return (mask & Pos ? internal::positionBits(encoding) : 0) +
+         (mask & Direction ? internal::directionBits(encoding) : 0);
+}
+
+} // namespace network
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+#include "../game/Enemy.hpp"
+#include "../game/Fireball.hpp"
+#include "bit_stream.hpp"
+
+namespace network {
+
+namespace internal {
+struct Reader;
+}
+
+// Tick of the server snapshot. 0 means "no snapshot"
+typedef uint32_t SnapshotTick;
+// Bit set of fields of a DTO that changed against the baseline
+typedef uint8_t FieldMask;
+
+/**
+ * Describes how a DTO is diffed and which fields go on the wire.
+ * Specialized for every replicated DTO (see snapshot.cpp)
+ **/
+template <typename DTO> struct DeltaTraits;
+
+template <> struct DeltaTraits<Enemy::DTO> {
+  enum Field : FieldMask {
+    Pos = 1 << 0,
+    Destination = 1 << 1,
+    Health = 1 << 2
+  };
+  static constexpr FieldMask ALL_FIELDS = Pos | Destination | Health;
+  static constexpr uint32_t MASK_BITS = 3;
+
+  static FieldMask diff(const Enemy::DTO &from, const Enemy::DTO &to);
+  static void apply(Enemy::DTO &dest, const Enemy::DTO &src, FieldMask mask);
+  static void write(internal::BitWriter &dest, const Enemy::DTO &dto,
+                    FieldMask mask, Encoding encoding);
+  static bool read(internal::BitReader &src, Enemy::DTO &dto, FieldMask mask,
+                   Encoding encoding);
+  // Bits taken by "write" with the given mask
+  static uint32_t bits(FieldMask mask, Encoding encoding);
+};
+
+template <> struct DeltaTraits<Fireball::DTO> {
+  enum Field : FieldMask { Pos = 1 << 0, Direction = 1 << 1 };
+  static constexpr FieldMask ALL_FIELDS = Pos | Direction;
+  static constexpr uint32_t MASK_BITS = 2;
+
+  static FieldMask diff(const Fireball::DTO &from, const Fireball::DTO &to);
+  static void apply(Fireball::DTO &dest, const Fireball::DTO &src,
+                    FieldMask mask);
+  static void write(internal::BitWriter &dest, const Fireball::DTO &dto,
+                    FieldMask mask, Encoding encoding);
+  static bool read(internal::BitReader &src, Fireball::DTO &dto,
+                   FieldMask mask, Encoding encoding);
+  static uint32_t bits(FieldMask mask, Encoding encoding);
+};
+
+// State of all entities of one kind at a given tick. Sorted by id
+template <typename DTO> struct Snapshot {
+  SnapshotTick tick = 0;
+  std::vector<DTO> entities;
+};
+
+/**
+ * Difference between two snapshots.
+ * Only added entities (all fields), changed fields of existing entities and
+ * ids of removed ones are sent. baselineTick == 0 means it's a full snapshot.
+ * The body is bit packed. Ids are sorted so only the gaps between them are
+ * written, which usually takes a single byte.
+ * The server only keeps a delta until it's encoded, so makeDelta can put it
+ * in the frame arena
+ **/
+template <typename DTO> struct SnapshotDelta {
+  struct Entry {
+    FieldMask mask;
+    DTO value;
+  };
+
+  SnapshotDelta() = default;
+  explicit SnapshotDelta(std::pmr::memory_resource *memory)
+      : removed(memory), entries(memory) {}
+
+  SnapshotTick baselineTick = 0;
+  SnapshotTick tick = 0;
+  std::pmr::vector<uint32_t> removed;
+  std::pmr::vector<Entry> entries;
+
+  // Appends the body to dest
+  void serialize(std::string &dest, Encoding encoding) const;
+  bool deserialize(internal::Reader &src, Encoding encoding);
+  size_t serializedSize(Encoding encoding) const;
+};
+
+// Last HISTORY_SIZE snapshots. Older ones can't be used as a baseline so
+// clients that didn't acknowledge anything newer get a full snapshot
+template <typename DTO> struct SnapshotHistory {
+  constexpr static size_t HISTORY_SIZE = 32;
+
+  void push(Snapshot<DTO> snapshot);
+  // Slot of the tick, to be filled in place and kept sorted. The entities of
+  // the snapshot it replaces are cleared but keep their memory
+  Snapshot<DTO> &emplace(SnapshotTick tick);
+  const Snapshot<DTO> *find(SnapshotTick tick) const;
+  void clear() { m_snapshots = {}; }
+
+private:
+  std::array<Snapshot<DTO>, HISTORY_SIZE> m_snapshots;
+};
+
+template <typename DTO>
+SnapshotDelta<DTO>
+makeDelta(const Snapshot<DTO> *baseline, const Snapshot<DTO> &current,
+          std::pmr::memory_resource *memory = std::pmr::get_default_resource());
+
+// Size of the delta sending the whole snapshot (no baseline)
+template <typename DTO>
+size_t fullSnapshotSize(const Snapshot<DTO> &snapshot, Encoding encoding);
+
+// Rebuilds the snapshot the delta was made from
+template <typename DTO>
+Snapshot<DTO> applyDelta(const Snapshot<DTO> *baseline,
+                         const SnapshotDelta<DTO> &delta);
+
+} // namespace network
+
+// Definitions need the wire helpers so they live in snapshot_impl.hpp which is
+// included by packet_impl.hpp
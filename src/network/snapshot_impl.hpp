@@ -0,0 +1,249 @@
+#pragma once
+
+#include <algorithm>
+#include <limits>
+
+#include "../debug.hpp"
+#include "../logging.hpp"
+
+#include "packet.hpp"
+#include "snapshot.hpp"
+
+namespace network {
+
+/*
+ * Layout (bit packed, see BitWriter):
+ * tick | tick - baselineTick | removedCount | removed id gaps... |
+ * entryCount | (id gap | mask | fields selected by the mask)...
+ */
+template <typename DTO>
+void SnapshotDelta<DTO>::serialize(std::string &dest, Encoding encoding) const {
+  using Traits = DeltaTraits<DTO>;
+
+  dest.reserve(dest.size() + serializedSize(encoding));
+  internal::BitWriter writer(dest);
+
+  writer.write(tick, 32);
+  writer.writeVarUint(tick - baselineTick);
+
+  writer.writeVarUint(removed.size());
+  uint32_t previousID = 0;
+  for (uint32_t id : removed) {
+    writer.writeVarUint(id - previousID);
+    previousID = id;
+  }
+
+  writer.writeVarUint(entries.size());
+  previousID = 0;
+  for (const Entry &e : entries) {
+    writer.writeVarUint(e.value.id - previousID);
+    previousID = e.value.id;
+    writer.write(e.mask, Traits::MASK_BITS);
+    Traits::write(writer, e.value, e.mask, encoding);
+  }
+
+  writer.flush();
+}
+
+template <typename DTO>
+bool SnapshotDelta<DTO>::deserialize(internal::Reader &src,
+                                     Encoding encoding) {
+  using Traits = DeltaTraits<DTO>;
+
+  const std::string_view body = *src.take(src.remaining());
+  internal::BitReader reader(body);
+
+  uint32_t age = 0;
+  if (!reader.read(tick, 32) || !reader.readVarUint(age) || age > tick)
+    return false;
+  baselineTick = tick - age;
+
+  // Every id takes at least a byte. Checked before allocating anything
+  uint32_t removedCount = 0;
+  if (!reader.readVarUint(removedCount) || removedCount > body.size())
+    return false;
+
+  removed.resize(removedCount);
+  uint32_t previousID = 0;
+  for (uint32_t &id : removed) {
+    uint32_t gap = 0;
+    if (!reader.readVarUint(gap))
+      return false;
+    id = previousID += gap;
+  }
+
+  uint32_t entryCount = 0;
+  if (!reader.readVarUint(entryCount) || entryCount > body.size())
+    return false;
+
+  entries.clear();
+  entries.reserve(entryCount);
+  previousID = 0;
+  for (uint32_t i = 0; i < entryCount; ++i) {
+    Entry e{};
+    uint32_t gap = 0;
+    uint32_t mask = 0;
+    if (!reader.readVarUint(gap) || !reader.read(mask, Traits::MASK_BITS))
+      return false;
+    e.value.id = previousID += gap;
+    e.mask = static_cast<FieldMask>(mask);
+    if (!Traits::read(reader, e.value, e.mask, encoding))
+      return false;
+    entries.push_back(e);
+  }
+
+  return reader.finished();
+}
+
+template <typename DTO>
+size_t SnapshotDelta<DTO>::serializedSize(Encoding encoding) const {
+  using Traits = DeltaTraits<DTO>;
+  using internal::BitWriter;
+
+  size_t bits = 32 + BitWriter::varUintBits(tick - baselineTick) +
+                BitWriter::varUintBits(removed.size()) +
+                BitWriter::varUintBits(entries.size());
+
+  uint32_t previousID = 0;
+  for (uint32_t id : removed) {
+    bits += BitWriter::varUintBits(id - previousID);
+    previousID = id;
+  }
+
+  previousID = 0;
+  for (const Entry &e : entries) {
+    bits += BitWriter::varUintBits(e.value.id - previousID) +
+            Traits::MASK_BITS + Traits::bits(e.mask, encoding);
+    previousID = e.value.id;
+  }
+
+  return (bits + 7) / 8;
+}
+
+template <typename DTO>
+void SnapshotHistory<DTO>::push(Snapshot<DTO> snapshot) {
+  ASSERT(snapshot.tick != 0);
+  ASSERT(std::is_sorted(
+      snapshot.entities.begin(), snapshot.entities.end(),
+      [](const DTO &a, const DTO &b) { return a.id < b.id; }));
+
+  m_snapshots[snapshot.tick % HISTORY_SIZE] = std::move(snapshot);
+}
+
+template <typename DTO>
+Snapshot<DTO> &SnapshotHistory<DTO>::emplace(SnapshotTick tick) {
+  ASSERT(tick != 0);
+
+  Snapshot<DTO> &snapshot = m_snapshots[tick % HISTORY_SIZE];
+  snapshot.tick = tick;
+  snapshot.entities.clear();
+  return snapshot;
+}
+
+template <typename DTO>
+const Snapshot<DTO> *SnapshotHistory<DTO>::find(SnapshotTick tick) const {
+  if (tick == 0)
+    return nullptr;
+
+  const Snapshot<DTO> &s = m_snapshots[tick % HISTORY_SIZE];
+  return s.tick == tick ? &s : nullptr;
+}
+
+template <typename DTO>
+size_t fullSnapshotSize(const Snapshot<DTO> &snapshot, Encoding encoding) {
+  using Traits = DeltaTraits<DTO>;
+  using internal::BitWriter;
+
+  size_t bits = 32 + BitWriter::varUintBits(snapshot.tick) +
+                BitWriter::varUintBits(0) +
+                BitWriter::varUintBits(snapshot.entities.size());
+
+  uint32_t previousID = 0;
+  for (const DTO &dto : snapshot.entities) {
+    bits += BitWriter::varUintBits(dto.id - previousID) + Traits::MASK_BITS +
+            Traits::bits(Traits::ALL_FIELDS, encoding);
+    previousID = dto.id;
+  }
+
+  return (bits + 7) / 8;
+}
+
+// Both snapshots are sorted by id so they are diffed in a single pass
+template <typename DTO>
+SnapshotDelta<DTO> makeDelta(const Snapshot<DTO> *baseline,
+                             const Snapshot<DTO> &current,
+                             std::pmr::memory_resource *memory) {
+  using Traits = DeltaTraits<DTO>;
+
+  SnapshotDelta<DTO> delta(memory);
+  delta.tick = current.tick;
+  delta.entries.reserve(current.entities.size());
+
+  if (baseline == nullptr) {
+    for (const DTO &dto : current.entities)
+      delta.entries.push_back({Traits::ALL_FIELDS, dto});
+    return delta;
+  }
+
+  delta.baselineTick = baseline->tick;
+
+  const std::vector<DTO> &from = baseline->entities;
+  const std::vector<DTO> &to = current.entities;
+  size_t i = 0, j = 0;
+  while (i < from.size() || j < to.size()) {
+    if (j == to.size() || (i < from.size() && from[i].id < to[j].id)) {
+      delta.removed.push_back(from[i].id);
+      ++i;
+    } else if (i == from.size() || to[j].id < from[i].id) {
+      delta.entries.push_back({Traits::ALL_FIELDS, to[j]});
+      ++j;
+    } else {
+      FieldMask mask = Traits::diff(from[i], to[j]);
+      if (mask != 0)
+        delta.entries.push_back({mask, to[j]});
+      ++i;
+      ++j;
+    }
+  }
+
+  return delta;
+}
+
+template <typename DTO>
+Snapshot<DTO> applyDelta(const Snapshot<DTO> *baseline,
+                         const SnapshotDelta<DTO> &delta) {
+  using Traits = DeltaTraits<DTO>;
+
+  Snapshot<DTO> result;
+  result.tick = delta.tick;
+
+  static const std::vector<DTO> empty;
+  const std::vector<DTO> &from = baseline ? baseline->entities : empty;
+  result.entities.reserve(from.size() + delta.entries.size());
+
+  // Entries and removed ids are produced in id order by makeDelta
+  size_t i = 0, e = 0, r = 0;
+  while (i < from.size() || e < delta.entries.size()) {
+    if (e == delta.entries.size() ||
+        (i < from.size() && from[i].id < delta.entries[e].value.id)) {
+      while (r < delta.removed.size() && delta.removed[r] < from[i].id)
+        ++r;
+      if (r == delta.removed.size() || delta.removed[r] != from[i].id)
+        result.entities.push_back(from[i]);
+      ++i;
+    } else if (i == from.size() || delta.entries[e].value.id < from[i].id) {
+      result.entities.push_back(delta.entries[e].value);
+      ++e;
+    } else {
+      DTO dto = from[i];
+      Traits::apply(dto, delta.entries[e].value, delta.entries[e].mask);
+      result.entities.push_back(dto);
+      ++i;
+      ++e;
+    }
+  }
+
+  return result;
+}
+
+} // namespace network
@@ -1,8 +1,10 @@
 #include "socket.hpp"
+#include "../debug.hpp"
 #include "../logging.hpp"
 #include "packet.hpp"
 #include <SFML/System/Err.hpp>
 #include <arpa/inet.h>
+#include <array>
 #include <cerrno>
 #include <fcntl.h>
 #include <map>
@@ -10,12 +12,13 @@
 #include <optional>
 #include <string>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 namespace network {
 
-constexpr Socket Socket::NULL_SOCKET = {
-    .fd = -1, .addr = {}, .addrlen = 0, .currentData = ""};
+const Socket Socket::NULL_SOCKET = {
+    .fd = -1, .addr = {}, .addrlen = 0, .incoming = {}};
 
 SocketError errnoToSocketError() {
 
@@ -24,6 +27,9 @@ SocketError errnoToSocketError() {
 
   switch (errno) {
   case EPIPE:
+  case ECONNRESET:
+  // Connected UDP socket whose peer is gone (ICMP port unreachable)
+  case ECONNREFUSED:
     return SocketError::Disconnected;
   case EACCES:
     return SocketError::NoAccess;
@@ -38,7 +44,8 @@ SocketError errnoToSocketError() {
   }
 }
 
-SocketError printSocketError(SocketError value) {
+// Logs what failed with the name of the error and returns the error
+SocketError logSocketError(std::string_view what, SocketError value) {
   static const auto strings = [] {
     std::map<SocketError, std::string_view> result;
 #define INSERT_ELEMENT(p) result.emplace(p, #p);
@@ -53,7 +60,7 @@ SocketError printSocketError(SocketError value) {
     return result;
   }();
 
-  std::cout << strings.at(value);
+  LOG_ERROR(what, ": ", strings.at(value));
   return value;
 }
 constexpr int INVALID_SOCKET_DESCRIPTOR = -1;
@@ -96,7 +103,7 @@ std::expected<Socket, SocketError> Socket::create(const char *ipAddress,
       .addr = addr,
       .addrlen = sizeof(addr),
       .type = type,
-      .currentData = std::string(0, 0),
+      .incoming = {},
   };
 }
 std::optional<SocketError> Socket::shutdown() noexcept {
@@ -104,6 +111,12 @@ std::optional<SocketError> Socket::shutdown() noexcept {
   if (this->fd == INVALID_SOCKET_DESCRIPTOR)
     return SocketError::InvalidDescriptor;
 
+  // There's no stream to shut down. Telling the peer instead of letting it
+  // wait for the timeout
+  if (this->type == SocketType::UDP)
+    return (this->udp) ? sendControl(internal::DatagramKind::Disconnect)
+                       : std::nullopt;
+
   if (::shutdown(this->fd, SHUT_RDWR) < 0)
     return errnoToSocketError();
 
@@ -117,37 +130,179 @@ std::optional<SocketError> Socket::send(const char *msg, uint32_t msglen) {
 
   // Is this necessary?
   if (r < 0) {
-    LOG_ERROR("SEND ERROR: ");
-    return printSocketError(errnoToSocketError());
+    return logSocketError("SEND ERROR", errnoToSocketError());
   }
   return std::nullopt;
 }
 
-std::optional<SocketError> Socket::receive() {
+void Socket::queue(SharedMessage msg, Channel channel) {
+  if (msg->empty())
+    return;
+
+  if (this->udp) {
+    this->udp->queue(std::move(msg), channel);
+    return;
+  }
+
+  this->outgoing.push_back(std::move(msg));
+}
+
+bool Socket::needsFlush() const {
+  return this->udp || !this->outgoing.empty();
+}
+
+std::optional<SocketError> Socket::flush(uint32_t *syscalls) {
+  if (this->udp)
+    return flushDatagrams(syscalls);
+
+  // Upper bound of buffers gathered by a single sendmsg
+  constexpr size_t MAX_IOVECS = 64;
+
+  while (!this->outgoing.empty()) {
+    std::array<iovec, MAX_IOVECS> iov;
+    size_t count = 0;
+    size_t total = 0;
+
+    for (const SharedMessage &msg : this->outgoing) {
+      if (count == MAX_IOVECS)
+        break;
+      const size_t offset = (count == 0) ? this->outgoingOffset : 0;
+      iov[count].iov_base = const_cast<char *>(msg->data() + offset);
+      iov[count].iov_len = msg->size() - offset;
+      total += iov[count].iov_len;
+      ++count;
+    }
+
+    struct msghdr header = {};
+    header.msg_iov = iov.data();
+    header.msg_iovlen = count;
+
+    // sendmsg instead of writev to pass MSG_NOSIGNAL
+    const ssize_t sent = ::sendmsg(this->fd, &header, MSG_NOSIGNAL);
+    if (syscalls)
+      ++(*syscalls);
+
+    if (sent < 0) {
+      SocketError e = errnoToSocketError();
+      if (e == SocketError::WouldBlock)
+        return std::nullopt;
+      return logSocketError("FLUSH ERROR", e);
+    }
+
+    // Dropping everything that was fully written
+    size_t written = sent + this->outgoingOffset;
+    while (!this->outgoing.empty() &&
+           written >= this->outgoing.front()->size()) {
+      written -= this->outgoing.front()->size();
+      this->outgoing.pop_front();
+    }
+    this->outgoingOffset = written;
+
+    // Socket buffer is full. The tail is retried on the next flush
+    if (static_cast<size_t>(sent) < total)
+      return std::nullopt;
+  }
+
+  return std::nullopt;
+}
+
+std::optional<SocketError> Socket::flushDatagrams(uint32_t *syscalls) {
+  if (this->udp->isTimedOut())
+    return SocketError::Disconnected;
+
+  for (const std::string &datagram : this->udp->collectDatagrams()) {
+    const ssize_t sent =
+        ::send(this->fd, datagram.data(), datagram.size(), MSG_NOSIGNAL);
+    if (syscalls)
+      ++(*syscalls);
+
+    if (sent < 0) {
+      SocketError e = errnoToSocketError();
+      // Same as a lost datagram. Reliable messages will be resent
+      if (e == SocketError::WouldBlock)
+        return std::nullopt;
+      return logSocketError("DATAGRAM SEND ERROR", e);
+    }
+  }
+
+  return std::nullopt;
+}
+
+std::optional<SocketError> Socket::sendControl(internal::DatagramKind kind) {
+  ASSERT(this->udp && "Control datagrams are UDP only");
+
+  const std::string datagram = this->udp->controlDatagram(kind);
+  if (::send(this->fd, datagram.data(), datagram.size(), MSG_NOSIGNAL) < 0)
+    return errnoToSocketError();
+
+  return std::nullopt;
+}
+
+std::optional<SocketError> Socket::receiveDatagrams(uint32_t *syscalls) {
+  static thread_local std::array<char, internal::MAX_UDP_PAYLOAD> buf;
+
+  while (true) {
+    const ssize_t bytesRead = ::recv(this->fd, buf.data(), buf.size(), 0);
+    if (syscalls)
+      ++(*syscalls);
+
+    if (bytesRead < 0) {
+      SocketError e = errnoToSocketError();
+      if (e == SocketError::WouldBlock)
+        return std::nullopt;
+      return logSocketError("DATAGRAM RECEIVE ERROR", e);
+    }
+
+    auto kind = this->udp->receive(std::string_view(buf.data(), bytesRead),
+                                   this->incoming);
+
+    if (kind == internal::DatagramKind::Disconnect)
+      return SocketError::Disconnected;
+
+    // Peer didn't get the "Accept" and retried the handshake
+    if (kind == internal::DatagramKind::Connect)
+      sendControl(internal::DatagramKind::Accept);
+  }
+
+  return std::nullopt;
+}
+
+std::optional<SocketError> Socket::receive(uint32_t *syscalls) {
 
   if (this->fd == INVALID_SOCKET_DESCRIPTOR) {
     LOG_ERROR("Invalid socket descriptor");
     return SocketError::InvalidDescriptor;
   }
-  std::string buf(4096, 0);
 
-  int bytesRead = 0;
+  if (this->udp)
+    return receiveDatagrams(syscalls);
+  // Minimal free space for a single read
+  constexpr size_t READ_CHUNK_BYTES = 4096;
 
   struct sockaddr_in from = {0};
   socklen_t len = 0;
 
   while (true) {
-    int bytesRead = recvfrom(this->fd, &buf[0], buf.size(), MSG_NOSIGNAL,
+    // Reading directly into the receive buffer
+    std::span<char> buf = this->incoming.writable(READ_CHUNK_BYTES);
+
+    int bytesRead = recvfrom(this->fd, buf.data(), buf.size(), MSG_NOSIGNAL,
                              (struct sockaddr *)&from, &len);
-    // int bytesRead = recv(this->fd, &buf[0], buf.size(), 0);
-    if (bytesRead <= 0) {
+    if (syscalls)
+      ++(*syscalls);
+
+    // Orderly shutdown of the other side
+    if (bytesRead == 0 && this->type == SocketType::TCP)
+      return SocketError::Disconnected;
+
+    if (bytesRead < 0) {
       SocketError e = errnoToSocketError();
       if (e == SocketError::WouldBlock)
         return std::nullopt;
-      return printSocketError(e);
+      return logSocketError("RECEIVE ERROR", e);
     }
 
-    this->currentData.append(buf.substr(0, bytesRead));
+    this->incoming.commit(bytesRead);
   }
 
   return std::nullopt;
@@ -158,14 +313,14 @@ std::expected<Socket, SocketError> Socket::accept() {
   // TODO :: Move this to socket class
   //
   struct sockaddr_in client = {0};
-  socklen_t len = 0;
+  socklen_t len = sizeof(client);
 
   const int clientSocket = ::accept(this->fd, (struct sockaddr *)&client, &len);
 
   if (clientSocket < 0) {
     SocketError e = errnoToSocketError();
     if (e != SocketError::WouldBlock)
-      printSocketError(e);
+      logSocketError("ACCEPT ERROR", e);
     return std::unexpected(e);
   }
   // Nonblocking socket
@@ -173,6 +328,45 @@ std::expected<Socket, SocketError> Socket::accept() {
   return Socket{.fd = clientSocket, .addr = client, .addrlen = len};
 }
 
+std::expected<Socket, SocketError>
+Socket::acceptDatagram(const Socket &listener, const sockaddr_in &peer,
+                       internal::ConnectionID id) {
+  const int32_t socketfd = socket(AF_INET, SOCK_DGRAM, 0);
+
+  if (socketfd < 0) {
+    LOG_ERROR("Couldn't create datagram socket. errno: ", errno);
+    return std::unexpected(errnoToSocketError());
+  }
+
+  Socket s = Socket{.fd = socketfd,
+                    .addr = peer,
+                    .addrlen = sizeof(peer),
+                    .type = SocketType::UDP};
+
+  if (!s.setReusePort() ||
+      ::bind(s.fd, (const struct sockaddr *)&listener.addr, listener.addrlen) <
+          0 ||
+      ::connect(s.fd, (const struct sockaddr *)&peer, sizeof(peer)) < 0 ||
+      !s.setBlocking(false)) {
+    LOG_ERROR("Couldn't create connected datagram socket. errno: ", errno);
+    SocketError e = errnoToSocketError();
+    s.close();
+    return std::unexpected(e);
+  }
+
+  s.udp = std::make_shared<UdpConnection>(id);
+  s.sendControl(internal::DatagramKind::Accept);
+
+  return s;
+}
+
+void Socket::close() noexcept {
+  if (this->fd == INVALID_SOCKET_DESCRIPTOR)
+    return;
+  ::close(this->fd);
+  this->fd = INVALID_SOCKET_DESCRIPTOR;
+}
+
 bool Socket::setBlocking(bool shouldBlock) {
   // TODO :: add errors for this function
   //
@@ -190,4 +384,13 @@ bool Socket::setBlocking(bool shouldBlock) {
   return true;
 }
 
+bool Socket::setReusePort() {
+  // Lets every connected datagram socket share the listener's port
+  const int enable = 1;
+  return setsockopt(this->fd, SOL_SOCKET, SO_REUSEADDR, &enable,
+                    sizeof(enable)) == 0 &&
+         setsockopt(this->fd, SOL_SOCKET, SO_REUSEPORT, &enable,
+                    sizeof(enable)) == 0;
+}
+
 } // namespace network
@@ -3,6 +3,10 @@
 #include <expected>
 
 #include "packet.hpp"
+#include "receive_buffer.hpp"
+#include "udp.hpp"
+#include <deque>
+#include <memory>
 #include <netinet/in.h>
 #include <optional>
 #include <string>
@@ -30,8 +34,15 @@ struct Socket {
 
   // Holds all data read from socket
   // To read individual messages use "nextMessage"
-  std::string currentData;
-  ;
+  ReceiveBuffer incoming;
+
+  // Messages waiting to be written by "flush"
+  std::deque<SharedMessage> outgoing;
+  // Bytes of the first outgoing message already written by a partial write
+  size_t outgoingOffset = 0;
+
+  // Reliability state. Only set for connected UDP sockets
+  std::shared_ptr<UdpConnection> udp;
 
   [[nodiscard]] static std::expected<Socket, SocketError>
   create(const char *addr, uint16_t port, SocketType type = SocketType::TCP,
@@ -39,46 +50,52 @@ struct Socket {
 
   std::optional<SocketError> shutdown() noexcept;
   std::optional<SocketError> send(const char *msg, uint32_t msglen);
-  std::optional<SocketError> receive();
+  // Adds the message to the outgoing queue. Nothing is sent until "flush".
+  // Channel matters only for UDP sockets
+  void queue(SharedMessage msg, Channel channel = Channel::Reliable);
+  // Writes the outgoing queue with a single sendmsg (gather write).
+  // Whatever the kernel didn't accept stays queued for the next flush.
+  // When "syscalls" is given it's incremented for every sendmsg issued
+  std::optional<SocketError> flush(uint32_t *syscalls = nullptr);
+  // True if "flush" has anything to do. UDP sockets always do (acks, resends)
+  bool needsFlush() const;
+  // Reads everything that is currently available on the socket.
+  // When "syscalls" is given it's incremented for every recv issued
+  std::optional<SocketError> receive(uint32_t *syscalls = nullptr);
+  void close() noexcept;
 
   // valid only if the socket is server
   std::expected<Socket, SocketError> accept();
 
+  // Creates a UDP socket bound to the same address as "listener" and
+  // connected to "peer", so the kernel routes the peer's datagrams to it
+  // instead of the listener. Replies to the handshake with "Accept"
+  [[nodiscard]] static std::expected<Socket, SocketError>
+  acceptDatagram(const Socket &listener, const sockaddr_in &peer,
+                 internal::ConnectionID id);
+  // Sends a handshake/teardown datagram (UDP only)
+  std::optional<SocketError> sendControl(internal::DatagramKind kind);
+
   template <typename T>
   std::optional<internal::PacketWrapper<T>> nextMessage() {
+    // Skipping frames that couldn't be decoded
+    while (auto frame = this->incoming.nextFrame()) {
+      auto decoded = decodePacket<T>(*frame);
 
-    constexpr auto separator = network::internal::SEPARATOR;
-    constexpr auto separatorSize = sizeof(network::internal::SEPARATOR);
-
-    if (this->currentData.size() <= separatorSize)
-      return std::nullopt;
-
-    const int sepIndex = this->currentData.find(separator, 0, separatorSize);
-    if (sepIndex == std::string::npos) {
-      LOG_ERROR("No separator found in (", std::string(separator, 4), ")");
-      return std::nullopt;
+      if (decoded)
+        return decoded;
     }
 
-    LOG_DEBUG("Sep message: ", sepIndex);
-
-    // Copying the message
-    // Starting is also the length of current message
-    std::string msg = std::string(this->currentData.substr(0, sepIndex));
-
-    // Moving the internal buffer to the next message
-    const auto startOfNextMessage = sepIndex + separatorSize;
-    this->currentData.erase(0, startOfNextMessage);
-
-    auto decoded = decodePacket<T>(msg);
-
-    if (!decoded)
-      return std::nullopt;
-
-    return *decoded;
+    return std::nullopt;
   }
 
   bool setBlocking(bool shouldBlock);
+  bool setReusePort();
 
   static const Socket NULL_SOCKET;
+
+private:
+  std::optional<SocketError> receiveDatagrams(uint32_t *syscalls);
+  std::optional<SocketError> flushDatagrams(uint32_t *syscalls);
 };
 } // namespace network
@@ -0,0 +1,499 @@
+#include "udp.hpp"
+#include "../logging.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace network {
+
+// Unacknowledged reliable messages are resent after this delay
+constexpr auto RESEND_DELAY = std::chrono::milliseconds(100);
+// Bare ack is sent at least this often so the other side knows we're alive
+constexpr auto KEEPALIVE_DELAY = std::chrono::milliseconds(250);
+constexpr auto CONNECTION_TIMEOUT = std::chrono::seconds(5);
+// Reliable messages further ahead than this are treated as stale duplicates
+constexpr internal::Sequence RELIABLE_WINDOW = 1024;
+// Datagrams covered by one ack: the newest plus one per bit of ackBits
+constexpr size_t ACKED_DATAGRAMS = 33;
+
+// Channel byte of a fragment
+constexpr uint8_t fragmentChannel(Channel channel) {
+  return static_cast<uint8_t>(channel) | internal::FRAGMENT_FLAG;
+}
+
+// A frame put together from fragments is exactly what its header says
+static bool isWholeFrame(std::string_view frame) {
+  auto header = internal::parseHeader(frame);
+  return header && internal::HEADER_LENGTH_BYTES + header->contentLength ==
+                       frame.size();
+}
+
+namespace internal {
+
+void appendDatagramHeader(std::string &dest, const DatagramHeader &header) {
+  appendBytes(dest, header.kind);
+  appendBytes(dest, header.connection);
+  appendBytes(dest, header.sequence);
+  appendBytes(dest, header.ack);
+  appendBytes(dest, header.ackBits);
+}
+
+std::optional<DatagramHeader> readDatagramHeader(Reader &reader) {
+  DatagramHeader header = {};
+  reader.read(header.kind);
+  reader.read(header.connection);
+  reader.read(header.sequence);
+  reader.read(header.ack);
+  reader.read(header.ackBits);
+
+  if (!reader.ok() || header.kind > DatagramKind::Disconnect)
+    return std::nullopt;
+
+  return header;
+}
+
+void appendFragmentHeader(std::string &dest, const FragmentHeader &header) {
+  appendBytes(dest, header.index);
+  appendBytes(dest, header.count);
+  appendBytes(dest, header.size);
+}
+
+std::optional<FragmentHeader> readFragmentHeader(Reader &reader) {
+  FragmentHeader header = {};
+  reader.read(header.index);
+  reader.read(header.count);
+  reader.read(header.size);
+
+  // Every fragment but the last one is full. A forged count would have the
+  // receiver allocate a frame bigger than any packet
+  const bool isLast = header.index + 1 == header.count;
+  const size_t frameSize = (header.count - 1) * FRAGMENT_BYTES + header.size;
+  if (!reader.ok() || header.count < 2 || header.count > MAX_FRAGMENTS ||
+      header.index >= header.count || header.size == 0 ||
+      header.size > FRAGMENT_BYTES ||
+      (!isLast && header.size != FRAGMENT_BYTES) ||
+      (isLast && frameSize > MAX_FRAME_BYTES))
+    return std::nullopt;
+
+  return header;
+}
+
+} // namespace internal
+
+UdpConnection::UdpConnection(internal::ConnectionID id)
+    : id(id), m_lastSent(Clock::now()), m_lastReceived(Clock::now()) {}
+
+void UdpConnection::queue(SharedMessage frame, Channel channel) {
+  const size_t fragments = internal::fragmentCount(frame->size());
+  if (fragments > internal::MAX_FRAGMENTS) {
+    LOG_ERROR("Message of ", frame->size(), " bytes has too many fragments");
+    return;
+  }
+
+  if (channel == Channel::Reliable) {
+    auto push = [&](internal::FragmentHeader fragment) {
+      m_unacked.push_back(PendingReliable{.reliableID = m_nextReliableID++,
+                                          .frame = frame,
+                                          .fragment = fragment,
+                                          .sentIn = 0,
+                                          .sentAt = {},
+                                          .isSent = false});
+    };
+
+    if (fragments == 0)
+      push({});
+    for (size_t i = 0; i < fragments; ++i) {
+      const size_t offset = i * internal::FRAGMENT_BYTES;
+      push({.index = static_cast<uint16_t>(i),
+            .count = static_cast<uint16_t>(fragments),
+            .size = static_cast<uint16_t>(
+                std::min(internal::FRAGMENT_BYTES, frame->size() - offset))});
+    }
+  } else {
+    m_unreliable.push_back(std::move(frame));
+  }
+}
+
+std::optional<internal::DatagramKind>
+UdpConnection::receive(std::string_view datagram, ReceiveBuffer &incoming) {
+  internal::Reader reader(datagram);
+
+  auto header = internal::readDatagramHeader(reader);
+  if (!header) {
+    LOG_ERROR("Dropping malformed datagram");
+    return std::nullopt;
+  }
+
+  // Stale datagram of a previous connection
+  if (header->kind != internal::DatagramKind::Connect &&
+      header->connection != this->id)
+    return std::nullopt;
+
+  m_lastReceived = Clock::now();
+
+  if (header->kind != internal::DatagramKind::Data)
+    return header->kind;
+
+  const bool isDuplicate = !recordSequence(header->sequence);
+  acknowledge(header->ack, header->ackBits);
+  m_ackPending = true;
+
+  while (reader.remaining() > 0) {
+    uint8_t flags = 0;
+    internal::Sequence reliableID = 0;
+
+    reader.read(flags);
+    const bool isFragment = flags & internal::FRAGMENT_FLAG;
+    const auto channel = static_cast<Channel>(flags & ~internal::FRAGMENT_FLAG);
+    if (channel == Channel::Reliable)
+      reader.read(reliableID);
+
+    // A whole frame's length comes from its own header, a fragment's from
+    // the fragment header
+    internal::FragmentHeader fragment = {};
+    std::optional<std::string_view> bytes;
+    if (isFragment) {
+      auto fragmentHeader = internal::readFragmentHeader(reader);
+      if (!fragmentHeader)
+        break;
+      fragment = *fragmentHeader;
+      bytes = reader.take(fragment.size);
+    } else {
+      auto frameHeader = reader.take(internal::HEADER_LENGTH_BYTES);
+      if (!frameHeader)
+        break;
+      auto packetHeader = internal::parseHeader(*frameHeader);
+      if (!packetHeader || !reader.take(packetHeader->contentLength))
+        break;
+      bytes = std::string_view(frameHeader->data(),
+                               internal::HEADER_LENGTH_BYTES +
+                                   packetHeader->contentLength);
+    }
+    if (!bytes)
+      break;
+
+    if (channel == Channel::Unreliable) {
+      if (isDuplicate)
+        continue;
+
+      if (isFragment)
+        receiveFragment(*bytes, header->sequence, fragment, incoming);
+      else
+        deliverLatest(*bytes, header->sequence, incoming);
+      continue;
+    }
+
+    if (reliableID == m_nextExpectedReliable) {
+      deliverReliable(*bytes, fragment, incoming);
+      ++m_nextExpectedReliable;
+
+      // Releasing messages that were waiting for this one
+      auto next = m_outOfOrder.find(m_nextExpectedReliable);
+      while (next != m_outOfOrder.end()) {
+        deliverReliable(next->second.bytes, next->second.fragment, incoming);
+        m_outOfOrder.erase(next);
+        next = m_outOfOrder.find(++m_nextExpectedReliable);
+      }
+    } else if (static_cast<internal::Sequence>(
+                   reliableID - m_nextExpectedReliable) < RELIABLE_WINDOW) {
+      m_outOfOrder.try_emplace(reliableID, std::string(*bytes), fragment);
+    }
+    // Otherwise it's a duplicate of something already delivered
+  }
+
+  if (!reader.ok()) {
+    LOG_ERROR("Datagram ", header->sequence, " has a malformed message");
+  }
+
+  return header->kind;
+}
+
+std::span<const std::string> UdpConnection::collectDatagrams() {
+  const auto now = Clock::now();
+
+  // The strings of the last call are reused, so they keep their capacity
+  size_t count = 0;
+  std::string *current = nullptr;
+  internal::Sequence currentSequence = 0;
+
+  auto startDatagram = [&]() {
+    if (count == m_datagrams.size())
+      m_datagrams.emplace_back().reserve(internal::MAX_DATAGRAM_BYTES);
+    current = &m_datagrams[count++];
+
+    currentSequence = m_nextSequence++;
+    current->clear();
+    internal::appendDatagramHeader(
+        *current, internal::DatagramHeader{
+                      .kind = internal::DatagramKind::Data,
+                      .connection = this->id,
+                      .sequence = currentSequence,
+                      .ack = m_remoteSequence,
+                      .ackBits = m_receivedBits,
+                  });
+  };
+
+  // A message bigger than the space left still goes in an empty datagram
+  auto fits = [&](size_t messageSize) {
+    return current != nullptr &&
+           (current->size() + messageSize <= internal::MAX_DATAGRAM_BYTES ||
+            current->size() == internal::DATAGRAM_HEADER_BYTES);
+  };
+
+  auto reserve = [&](size_t messageSize) {
+    if (!fits(messageSize))
+      startDatagram();
+  };
+
+  auto appendFragment = [&](const std::string &frame,
+                            const internal::FragmentHeader &fragment) {
+    internal::appendFragmentHeader(*current, fragment);
+    current->append(frame, fragment.index * internal::FRAGMENT_BYTES,
+                    fragment.size);
+  };
+
+  for (const SharedMessage &frame : m_unreliable) {
+    const size_t fragments = internal::fragmentCount(frame->size());
+    if (fragments == 0) {
+      reserve(sizeof(Channel) + frame->size());
+      internal::appendBytes(*current, Channel::Unreliable);
+      current->append(*frame);
+      continue;
+    }
+
+    // A datagram each, so their sequences are consecutive
+    for (size_t i = 0; i < fragments; ++i) {
+      const size_t offset = i * internal::FRAGMENT_BYTES;
+      startDatagram();
+      internal::appendBytes(*current, fragmentChannel(Channel::Unreliable));
+      appendFragment(
+          *frame,
+          {.index = static_cast<uint16_t>(i),
+           .count = static_cast<uint16_t>(fragments),
+           .size = static_cast<uint16_t>(
+               std::min(internal::FRAGMENT_BYTES, frame->size() - offset))});
+    }
+  }
+  m_unreliable.clear();
+
+  // Reliable messages go last and in at most ACKED_DATAGRAMS datagrams. An
+  // ack only covers that many, so anything sent before them would be resent
+  // even though it arrived. The last datagram so far may get some of them
+  const size_t firstReliable = (current != nullptr) ? count - 1 : count;
+  for (PendingReliable &pending : m_unacked) {
+    if (pending.isSent && now - pending.sentAt < RESEND_DELAY)
+      continue;
+    // Further ahead than the receiver keeps. Sent once the ones before it
+    // are acknowledged
+    if (static_cast<internal::Sequence>(pending.reliableID -
+                                        m_unacked.front().reliableID) >=
+        RELIABLE_WINDOW)
+      break;
+
+    const bool isFragment = pending.fragment.count != 0;
+    const size_t messageSize =
+        sizeof(Channel) + sizeof(internal::Sequence) +
+        (isFragment ? internal::FRAGMENT_HEADER_BYTES + pending.fragment.size
+                    : pending.frame->size());
+    if (!fits(messageSize) && count - firstReliable >= ACKED_DATAGRAMS)
+      break;
+    reserve(messageSize);
+
+    if (isFragment) {
+      internal::appendBytes(*current, fragmentChannel(Channel::Reliable));
+      internal::appendBytes(*current, pending.reliableID);
+      appendFragment(*pending.frame, pending.fragment);
+    } else {
+      internal::appendBytes(*current, Channel::Reliable);
+      internal::appendBytes(*current, pending.reliableID);
+      current->append(*pending.frame);
+    }
+
+    pending.sentIn = currentSequence;
+    pending.sentAt = now;
+    pending.isSent = true;
+  }
+
+  // Nothing to send but the other side is waiting for an ack (or keepalive)
+  if (current == nullptr &&
+      (m_ackPending || now - m_lastSent >= KEEPALIVE_DELAY))
+    startDatagram();
+
+  if (current != nullptr) {
+    m_ackPending = false;
+    m_lastSent = now;
+  }
+
+  return {m_datagrams.data(), count};
+}
+
+std::string UdpConnection::controlDatagram(internal::DatagramKind kind) const {
+  std::string datagram;
+  internal::appendDatagramHeader(datagram,
+                                 internal::DatagramHeader{
+                                     .kind = kind,
+                                     .connection = this->id,
+                                     .sequence = 0,
+                                     .ack = 0,
+                                     .ackBits = 0,
+                                 });
+  return datagram;
+}
+
+bool UdpConnection::isTimedOut() const {
+  return Clock::now() - m_lastReceived > CONNECTION_TIMEOUT;
+}
+
+bool UdpConnection::recordSequence(internal::Sequence sequence) {
+  if (!m_hasReceived) {
+    m_hasReceived = true;
+    m_remoteSequence = sequence;
+    m_receivedBits = 0;
+    return true;
+  }
+
+  if (internal::sequenceGreater(sequence, m_remoteSequence)) {
+    const uint32_t shift =
+        static_cast<internal::Sequence>(sequence - m_remoteSequence);
+
+    // Previous newest datagram becomes bit (shift - 1)
+    m_receivedBits = (shift < 32) ? (m_receivedBits << shift) : 0;
+    if (shift <= 32)
+      m_receivedBits |= 1u << (shift - 1);
+
+    m_remoteSequence = sequence;
+    return true;
+  }
+
+  const uint32_t age =
+      static_cast<internal::Sequence>(m_remoteSequence - sequence);
+
+  // Too old to tell - treating as a duplicate
+  if (age == 0 || age > 32)
+    return false;
+
+  const uint32_t bit = 1u << (age - 1);
+  if (m_receivedBits & bit)
+    return false;
+
+  m_receivedBits |= bit;
+  return true;
+}
+
+void UdpConnection::acknowledge(internal::Sequence ack, uint32_t ackBits) {
+  auto isAcked = [ack, ackBits](const PendingReliable &pending) {
+    if (!pending.isSent)
+      return false;
+    if (pending.sentIn == ack)
+      return true;
+
+    const uint32_t age = static_cast<internal::Sequence>(ack - pending.sentIn);
+    return age >= 1 && age <= 32 && (ackBits & (1u << (age - 1)));
+  };
+
+  std::erase_if(m_unacked, isAcked);
+}
+
+void UdpConnection::deliver(std::string_view frame,
+                            ReceiveBuffer &incoming) const {
+  std::span<char> dest = incoming.writable(frame.size());
+  std::memcpy(dest.data(), frame.data(), frame.size());
+  incoming.commit(frame.size());
+}
+
+void UdpConnection::deliverLatest(std::string_view frame,
+                                  internal::Sequence sequence,
+                                  ReceiveBuffer &incoming) {
+  auto packetHeader = internal::parseHeader(frame);
+  if (!packetHeader)
+    return;
+
+  // Latest wins - anything older than what was delivered is useless
+  auto latest = m_latestUnreliable.find(packetHeader->type);
+  if (latest != m_latestUnreliable.end() &&
+      internal::sequenceGreater(latest->second, sequence))
+    return;
+
+  m_latestUnreliable[packetHeader->type] = sequence;
+  deliver(frame, incoming);
+}
+
+void UdpConnection::deliverReliable(std::string_view bytes,
+                                    const internal::FragmentHeader &fragment,
+                                    ReceiveBuffer &incoming) {
+  if (fragment.count == 0)
+    return deliver(bytes, incoming);
+
+  // Reliable fragments are delivered in order, so they are simply appended.
+  // Delivered as one frame so nothing ends up in the middle of it
+  if (fragment.index == 0)
+    m_reliableFrame.clear();
+  else if (m_reliableFrame.size() != fragment.index * internal::FRAGMENT_BYTES)
+    return;
+
+  m_reliableFrame.append(bytes);
+  if (fragment.index + 1 == fragment.count) {
+    if (isWholeFrame(m_reliableFrame))
+      deliver(m_reliableFrame, incoming);
+    else
+      LOG_ERROR("Dropping a malformed fragmented message");
+    m_reliableFrame.clear();
+  }
+}
+
+void UdpConnection::receiveFragment(std::string_view bytes,
+                                    internal::Sequence sequence,
+                                    const internal::FragmentHeader &fragment,
+                                    ReceiveBuffer &incoming) {
+  // Fragments are sent in consecutive datagrams
+  const auto frameSequence =
+      static_cast<internal::Sequence>(sequence - fragment.index);
+
+  PartialFrame *partial = nullptr;
+  for (PartialFrame &p : m_partialFrames) {
+    if (p.count == fragment.count && p.sequence == frameSequence) {
+      partial = &p;
+      break;
+    }
+  }
+
+  if (partial == nullptr) {
+    // A free slot or the one of the oldest frame, which is likely lost
+    partial = &m_partialFrames.front();
+    for (PartialFrame &p : m_partialFrames) {
+      if (p.count == 0) {
+        partial = &p;
+        break;
+      }
+      if (internal::sequenceGreater(partial->sequence, p.sequence))
+        partial = &p;
+    }
+
+    partial->sequence = frameSequence;
+    partial->count = fragment.count;
+    partial->received = 0;
+    partial->size = 0;
+    partial->hasFragment.assign(fragment.count, false);
+    partial->data.resize(fragment.count * internal::FRAGMENT_BYTES);
+  }
+
+  if (partial->hasFragment[fragment.index])
+    return;
+  partial->hasFragment[fragment.index] = true;
+  ++partial->received;
+
+  const size_t offset = fragment.index * internal::FRAGMENT_BYTES;
+  std::memcpy(partial->data.data() + offset, bytes.data(), bytes.size());
+  if (fragment.index + 1 == fragment.count)
+    partial->size = offset + bytes.size();
+
+  if (partial->received == partial->count) {
+    partial->count = 0;
+    const auto frame = std::string_view(partial->data).substr(0, partial->size);
+    if (isWholeFrame(frame))
+      deliverLatest(frame, frameSequence, incoming);
+    else
+      LOG_ERROR("Dropping a malformed fragmented message");
+  }
+}
+
+} // namespace network
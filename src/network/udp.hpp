@@ -0,0 +1,203 @@
+#pragma once
+
+#include "packet.hpp"
+#include "receive_buffer.hpp"
+#include <array>
+#include <chrono>
+#include <deque>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace network {
+
+namespace internal {
+
+typedef uint16_t Sequence;
+typedef uint32_t ConnectionID;
+
+enum class DatagramKind : uint8_t { Connect, Accept, Data, Disconnect };
+
+/**
+ * Every datagram starts with this header followed by any number of messages:
+ *   Channel | Sequence reliableID (reliable channel only) | packet frame
+ * Fields are written one by one so the wire layout has no padding
+ **/
+struct DatagramHeader {
+  DatagramKind kind;
+  ConnectionID connection;
+  // Sequence number of this datagram
+  Sequence sequence;
+  // Newest datagram received from the other side
+  Sequence ack;
+  // Bit N set means datagram (ack - N - 1) was received as well
+  uint32_t ackBits;
+};
+
+constexpr size_t DATAGRAM_HEADER_BYTES =
+    sizeof(DatagramKind) + sizeof(ConnectionID) + sizeof(Sequence) * 2 +
+    sizeof(uint32_t);
+
+// Messages are packed into datagrams up to this size (below the common MTU).
+// Bigger frames are split into fragments, so no datagram is ever larger
+constexpr size_t MAX_DATAGRAM_BYTES = 1200;
+// Largest payload of a single IPv4 UDP datagram
+constexpr size_t MAX_UDP_PAYLOAD = 65507;
+
+/**
+ * A frame too big for one datagram is split into fragments of FRAGMENT_BYTES
+ * (the last one takes the rest). A fragment is a message with FRAGMENT_FLAG
+ * set on its channel byte:
+ *   Channel | Sequence reliableID (reliable channel only) | FragmentHeader |
+ *   bytes
+ * Every reliable fragment gets its own reliable id, so only the lost ones are
+ * resent. Unreliable fragments of a frame are sent in consecutive datagrams,
+ * which tells the receiver the frame a fragment belongs to
+ **/
+struct FragmentHeader {
+  uint16_t index;
+  uint16_t count;
+  uint16_t size;
+};
+
+constexpr uint8_t FRAGMENT_FLAG = 0x80;
+constexpr size_t FRAGMENT_HEADER_BYTES = sizeof(uint16_t) * 3;
+constexpr size_t FRAGMENT_BYTES = MAX_DATAGRAM_BYTES - DATAGRAM_HEADER_BYTES -
+                                  sizeof(Channel) - sizeof(Sequence) -
+                                  FRAGMENT_HEADER_BYTES;
+// Largest frame there is, so the most fragments a frame can have. A fragment
+// claiming more is dropped before any memory is set aside for its frame
+constexpr size_t MAX_FRAME_BYTES = HEADER_LENGTH_BYTES + MAX_CONTENT_LENGTH;
+constexpr size_t MAX_FRAGMENTS =
+    (MAX_FRAME_BYTES + FRAGMENT_BYTES - 1) / FRAGMENT_BYTES;
+
+// Number of fragments the frame is split into. 0 when it's sent whole
+constexpr size_t fragmentCount(size_t frameSize) {
+  if (DATAGRAM_HEADER_BYTES + sizeof(Channel) + sizeof(Sequence) + frameSize <=
+      MAX_DATAGRAM_BYTES)
+    return 0;
+  return (frameSize + FRAGMENT_BYTES - 1) / FRAGMENT_BYTES;
+}
+
+// True if "a" is newer than "b" (handles wrap around)
+constexpr bool sequenceGreater(Sequence a, Sequence b) {
+  return ((a > b) && (a - b <= 32768)) || ((a < b) && (b - a > 32768));
+}
+
+void appendDatagramHeader(std::string &dest, const DatagramHeader &header);
+std::optional<DatagramHeader> readDatagramHeader(Reader &reader);
+
+void appendFragmentHeader(std::string &dest, const FragmentHeader &header);
+// Fails on a fragment that couldn't have been produced by the sender
+std::optional<FragmentHeader> readFragmentHeader(Reader &reader);
+
+} // namespace internal
+
+/**
+ * Reliability layer of a single UDP connection.
+ *
+ * Every datagram carries its own sequence number plus an ack of the newest
+ * datagram received and a bitfield of the 32 before it. Reliable messages are
+ * kept until a datagram containing them is acknowledged and resent otherwise.
+ * They get their own ordered id so the receiver can deliver them in order.
+ * Unreliable messages are sent once and the receiver drops any that is older
+ * than the newest one of the same packet type it has already delivered.
+ * Frames bigger than a datagram are fragmented (see FragmentHeader).
+ **/
+struct UdpConnection {
+
+  explicit UdpConnection(internal::ConnectionID id);
+
+  void queue(SharedMessage frame, Channel channel);
+
+  // Processes a received datagram. Frames ready for delivery are appended to
+  // "incoming". Returns std::nullopt when the datagram was dropped
+  std::optional<internal::DatagramKind> receive(std::string_view datagram,
+                                                ReceiveBuffer &incoming);
+
+  // Returns the datagrams that should be sent now - queued messages,
+  // reliable messages due for a resend and a bare ack/keepalive if needed.
+  // Valid until the next call
+  std::span<const std::string> collectDatagrams();
+
+  // Handshake/teardown datagram. Doesn't take part in sequencing
+  std::string controlDatagram(internal::DatagramKind kind) const;
+
+  // Nothing was received from the other side for too long
+  bool isTimedOut() const;
+
+  internal::ConnectionID id;
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct PendingReliable {
+    internal::Sequence reliableID;
+    SharedMessage frame;
+    // Part of the frame carried by this message. count is 0 for a whole frame
+    internal::FragmentHeader fragment;
+    // Datagram the message was last sent in
+    internal::Sequence sentIn;
+    Clock::time_point sentAt;
+    bool isSent;
+  };
+
+  // Returns false if the datagram was already received
+  bool recordSequence(internal::Sequence sequence);
+  void acknowledge(internal::Sequence ack, uint32_t ackBits);
+  void deliver(std::string_view frame, ReceiveBuffer &incoming) const;
+  // Delivers the unreliable frame unless a newer one of its type already was
+  void deliverLatest(std::string_view frame, internal::Sequence sequence,
+                     ReceiveBuffer &incoming);
+  void deliverReliable(std::string_view bytes,
+                       const internal::FragmentHeader &fragment,
+                       ReceiveBuffer &incoming);
+  void receiveFragment(std::string_view bytes, internal::Sequence sequence,
+                       const internal::FragmentHeader &fragment,
+                       ReceiveBuffer &incoming);
+
+  // Sending side
+  internal::Sequence m_nextSequence = 1;
+  internal::Sequence m_nextReliableID = 0;
+  std::deque<PendingReliable> m_unacked;
+  std::vector<SharedMessage> m_unreliable;
+  // Buffers of the datagrams returned by collectDatagrams
+  std::vector<std::string> m_datagrams;
+  Clock::time_point m_lastSent;
+  bool m_ackPending = false;
+
+  // Receiving side
+  bool m_hasReceived = false;
+  internal::Sequence m_remoteSequence = 0;
+  uint32_t m_receivedBits = 0;
+  internal::Sequence m_nextExpectedReliable = 0;
+  struct OutOfOrder {
+    std::string bytes;
+    internal::FragmentHeader fragment;
+  };
+  std::unordered_map<internal::Sequence, OutOfOrder> m_outOfOrder;
+  // Reliable fragments delivered so far of the frame being put together
+  std::string m_reliableFrame;
+
+  // Unreliable frame being put together from its fragments
+  struct PartialFrame {
+    // Datagram of the first fragment
+    internal::Sequence sequence = 0;
+    // 0 when the slot is free
+    uint16_t count = 0;
+    uint16_t received = 0;
+    size_t size = 0;
+    std::vector<bool> hasFragment;
+    std::string data;
+  };
+  // A few frames at once, in case their fragments are interleaved
+  std::array<PartialFrame, 4> m_partialFrames;
+  // Datagram sequence of the newest delivered message of each packet type
+  std::unordered_map<internal::PacketType, internal::Sequence>
+      m_latestUnreliable;
+  Clock::time_point m_lastReceived;
+};
+
+} // namespace network
@@ -0,0 +1,236 @@
+#include "check.hpp"
+#include "network/packet.hpp"
+#include <cmath>
+#include <limits>
+#include <numbers>
+#include <string>
+
+using namespace network;
+using namespace network::internal;
+
+constexpr float COORDINATE_STEP =
+    (COORDINATE_MAX - COORDINATE_MIN) / (1u << COORDINATE_BITS);
+constexpr float PI = std::numbers::pi_v<float>;
+
+static float roundTripCoordinate(float value) {
+  std::string data;
+  BitWriter writer(data);
+  writeCoordinate(writer, value, Encoding::Quantized);
+  writer.flush();
+  CHECK_EQ(data.size(), COORDINATE_BITS / 8);
+
+  BitReader reader(data);
+  float result = -1;
+  CHECK(readCoordinate(reader, result, Encoding::Quantized));
+  CHECK(reader.finished());
+  return result;
+}
+
+static sf::Vector2f roundTripDirection(sf::Vector2f dir) {
+  std::string data;
+  BitWriter writer(data);
+  writeDirection(writer, dir, Encoding::Quantized);
+  writer.flush();
+
+  BitReader reader(data);
+  sf::Vector2f result;
+  CHECK(readDirection(reader, result, Encoding::Quantized));
+  return result;
+}
+
+static void testCoordinateError() {
+  // Half a step, plus the rounding of the float math
+  const float maxError = COORDINATE_STEP / 2 + 1e-4f;
+  float worst = 0;
+  for (float value = COORDINATE_MIN;
+       value < COORDINATE_MAX - COORDINATE_STEP; value += 0.37f) {
+    worst = std::max(worst, std::abs(roundTripCoordinate(value) - value));
+  }
+  CHECK(worst <= maxError);
+  // The steps are exact
+  CHECK_EQ(roundTripCoordinate(100.f + 3 * COORDINATE_STEP),
+           100.f + 3 * COORDINATE_STEP);
+}
+
+static void testCoordinateBounds() {
+  const float last = COORDINATE_MAX - COORDINATE_STEP;
+  CHECK_EQ(roundTripCoordinate(COORDINATE_MIN), COORDINATE_MIN);
+  CHECK_EQ(roundTripCoordinate(last), last);
+
+  // Outside values are clamped
+  CHECK_EQ(roundTripCoordinate(COORDINATE_MIN - 1000), COORDINATE_MIN);
+  CHECK_EQ(roundTripCoordinate(COORDINATE_MAX + 1000), last);
+  CHECK_EQ(roundTripCoordinate(-std::numeric_limits<float>::infinity()),
+           COORDINATE_MIN);
+  CHECK_EQ(roundTripCoordinate(std::numeric_limits<float>::infinity()), last);
+  CHECK_EQ(roundTripCoordinate(std::numeric_limits<float>::quiet_NaN()), 0.f);
+}
+
+static void testDirectionError() {
+  // Half an angle step, plus the rounding of the float math
+  const float maxError = PI / (1u << ANGLE_BITS) + 1e-5f;
+  float worst = 0;
+  for (float angle = -PI; angle < PI; angle += 0.0013f) {
+    const sf::Vector2f dir = {std::cos(angle), std::sin(angle)};
+    const sf::Vector2f result = roundTripDirection(dir * 3.f);
+    CHECK(std::abs(std::hypot(result.x, result.y) - 1) < 1e-5f);
+
+    float error = std::abs(std::atan2(result.y, result.x) - angle);
+    error = std::min(error, 2 * PI - error);
+    worst = std::max(worst, error);
+  }
+  CHECK(worst <= maxError);
+
+  const sf::Vector2f nan = {std::numeric_limits<float>::quiet_NaN(), 1};
+  CHECK(roundTripDirection({0, 0}) == sf::Vector2f(1, 0));
+  CHECK(roundTripDirection(nan) == sf::Vector2f(1, 0));
+}
+
+static void testHealthIsClamped() {
+  for (int health : {-20, 0, 1, 100, 255, 256, 10000}) {
+    std::string data;
+    BitWriter writer(data);
+    writeHealth(writer, health, Encoding::Quantized);
+    writer.flush();
+
+    BitReader reader(data);
+    int result = -1;
+    CHECK(readHealth(reader, result, Encoding::Quantized));
+    CHECK_EQ(result, std::clamp(health, 0, 255));
+  }
+}
+
+static void testVarUints() {
+  const uint32_t values[] = {0,       1,       127,      128,
+                             16383,   16384,   2097151,  2097152,
+                             1u << 28, 0xFFFFFFFF};
+  std::string data;
+  BitWriter writer(data);
+  size_t bits = 0;
+  for (uint32_t value : values) {
+    writer.writeVarUint(value);
+    bits += BitWriter::varUintBits(value);
+  }
+  writer.flush();
+  CHECK_EQ(data.size() * 8, bits);
+
+  BitReader reader(data);
+  for (uint32_t value : values) {
+    uint32_t result = 0;
+    CHECK(reader.readVarUint(result));
+    CHECK_EQ(result, value);
+  }
+  CHECK(reader.finished());
+
+  // Cut short
+  BitReader cut(std::string_view(data).substr(0, data.size() - 1));
+  uint32_t result = 0;
+  for (uint32_t value : values) {
+    if (!cut.readVarUint(result))
+      break;
+    CHECK_EQ(result, value);
+  }
+  CHECK(!cut.ok());
+}
+
+static Enemy::DTO enemy(uint32_t id, float x, float y, int health) {
+  return {.id = id, .pos = {x, y}, .destination = {y, x}, .health = health};
+}
+
+// Decoded delta applied to the baseline, the way the client does it
+static Snapshot<Enemy::DTO>
+roundTripDelta(const Snapshot<Enemy::DTO> *baseline,
+               const Snapshot<Enemy::DTO> &current, Encoding encoding) {
+  const auto delta = makeDelta(baseline, current);
+  std::string data;
+  delta.serialize(data, encoding);
+  CHECK_EQ(data.size(), delta.serializedSize(encoding));
+
+  Reader reader(data);
+  SnapshotDelta<Enemy::DTO> decoded;
+  CHECK(decoded.deserialize(reader, encoding));
+  CHECK_EQ(decoded.tick, current.tick);
+  CHECK_EQ(decoded.baselineTick, baseline ? baseline->tick : 0);
+  return applyDelta(baseline, decoded);
+}
+
+static void testDeltaRoundTrip() {
+  Snapshot<Enemy::DTO> baseline{.tick = 10, .entities = {}};
+  for (uint32_t id = 1; id <= 300; id += 3)
+    baseline.entities.push_back(enemy(id, id * 1.3f, 500 - id * 0.7f, 100));
+
+  // Removed, changed, unchanged and added entities
+  Snapshot<Enemy::DTO> current{.tick = 12, .entities = {}};
+  for (const Enemy::DTO &dto : baseline.entities) {
+    if (dto.id % 5 == 0)
+      continue;
+    Enemy::DTO next = dto;
+    if (dto.id % 2 == 0)
+      next.pos.x += 0.75f;
+    if (dto.id % 7 == 0)
+      next.health -= 30;
+    current.entities.push_back(next);
+  }
+  current.entities.push_back(enemy(1000, 12.5f, 33.25f, 80));
+  current.entities.push_back(enemy(70000, -300.f, 900.f, 300));
+
+  // Raw is exact
+  const auto raw = roundTripDelta(&baseline, current, Encoding::Raw);
+  CHECK_EQ(raw.entities.size(), current.entities.size());
+  for (size_t i = 0; i < raw.entities.size(); ++i) {
+    CHECK_EQ(raw.entities[i].id, current.entities[i].id);
+    CHECK(raw.entities[i].pos == current.entities[i].pos);
+    CHECK_EQ(raw.entities[i].health, current.entities[i].health);
+  }
+
+  // Quantized is within the error of the encoding, clamped at the edges
+  const float maxError = COORDINATE_STEP / 2 + 1e-4f;
+  const Snapshot<Enemy::DTO> *baselines[] = {nullptr, &baseline};
+  for (const Snapshot<Enemy::DTO> *base : baselines) {
+    const auto quantized = roundTripDelta(base, current, Encoding::Quantized);
+    CHECK_EQ(quantized.entities.size(), current.entities.size());
+    if (quantized.entities.size() != current.entities.size())
+      continue;
+
+    for (size_t i = 0; i < quantized.entities.size(); ++i) {
+      const Enemy::DTO &expected = current.entities[i];
+      const Enemy::DTO &actual = quantized.entities[i];
+      CHECK_EQ(actual.id, expected.id);
+      CHECK_EQ(actual.health, std::clamp(expected.health, 0, 255));
+      auto clamped = [](float value) {
+        return std::clamp(value, COORDINATE_MIN,
+                          COORDINATE_MAX - COORDINATE_STEP);
+      };
+      CHECK(std::abs(actual.pos.x - clamped(expected.pos.x)) <= maxError);
+      CHECK(std::abs(actual.pos.y - clamped(expected.pos.y)) <= maxError);
+      // Unchanged fields come from the baseline as they were
+      if (base != nullptr && expected.id % 2 != 0 && expected.id < 1000)
+        CHECK(actual.pos == expected.pos);
+    }
+  }
+}
+
+static void testTruncatedDeltaFails() {
+  Snapshot<Enemy::DTO> current{.tick = 5, .entities = {}};
+  for (uint32_t id = 1; id <= 20; ++id)
+    current.entities.push_back(enemy(id, id * 4.f, id * 2.f, 50));
+
+  std::string data;
+  makeDelta<Enemy::DTO>(nullptr, current).serialize(data, Encoding::Quantized);
+  for (size_t size = 0; size < data.size(); ++size) {
+    Reader reader(std::string_view(data).substr(0, size));
+    SnapshotDelta<Enemy::DTO> decoded;
+    CHECK(!decoded.deserialize(reader, Encoding::Quantized));
+  }
+}
+
+int main() {
+  testCoordinateError();
+  testCoordinateBounds();
+  testDirectionError();
+  testHealthIsClamped();
+  testVarUints();
+  testDeltaRoundTrip();
+  testTruncatedDeltaFails();
+  return testing::testResult();
+}
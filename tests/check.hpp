@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+/**
+ * Checks of the test executables. ASSERT is compiled out of the release
+ * builds the tests use, so they have their own. A failed check prints where
+ * it is and the test goes on - "testResult" makes main return non zero
+ * when anything failed.
+ **/
+namespace testing {
+
+inline int &failures() {
+  static int count = 0;
+  return count;
+}
+
+inline void fail(const char *file, int line, const std::string &message) {
+  ++failures();
+  std::fprintf(stderr, "%s:%d: FAILED %s\n", file, line, message.c_str());
+}
+
+template <typename A, typename B>
+std::string describe(const char *expression, const A &a, const B &b) {
+  std::ostringstream stream;
+  stream << expression << " (" << a << " vs " << b << ")";
+  return stream.str();
+}
+
+inline int testResult() {
+  if (failures() > 0)
+    std::fprintf(stderr, "%d checks failed\n", failures());
+  return failures() == 0 ? 0 : 1;
+}
+
+} // namespace testing
+
+#define CHECK(expr)                                                            \
+  (static_cast<bool>(expr) ? void(0)                                           \
+                           : testing::fail(__FILE__, __LINE__, #expr))
+
+#define CHECK_EQ(a, b)                                                         \
+  ((a) == (b) ? void(0)                                                        \
+              : testing::fail(__FILE__, __LINE__,                              \
+                              testing::describe(#a " == " #b, (a), (b))))
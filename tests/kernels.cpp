@@ -0,0 +1,159 @@
+#include "check.hpp"
+#include "game/Kernels.hpp"
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+using kernels::Isa;
+
+constexpr float NaN = std::numeric_limits<float>::quiet_NaN();
+constexpr float INF = std::numeric_limits<float>::infinity();
+
+// Every tail length of both vector widths and a couple of whole batches
+constexpr size_t COUNTS[] = {0,  1,  2,  3,  4,  5,  6,  7,   8,   9,
+                             10, 11, 12, 13, 15, 16, 17, 23,  31,  33,
+                             63, 64, 65, 99, 1000, 1003};
+
+struct Input {
+  std::vector<float> posX, posY, a, b;
+  std::vector<uint8_t> stopped;
+};
+
+// Random values mixed with the edge cases - NaN, infinities and positions
+// already at the destination (zero length, a division by zero)
+static Input makeInput(size_t count, std::mt19937 &rng) {
+  std::uniform_real_distribution<float> coordinate(-100.f, 600.f);
+  std::uniform_int_distribution<int> kind(0, 15);
+
+  Input input;
+  for (size_t i = 0; i < count; ++i) {
+    float x = coordinate(rng), y = coordinate(rng);
+    float ax = coordinate(rng), ay = coordinate(rng);
+    switch (kind(rng)) {
+    case 0:
+    case 1:
+      ax = x, ay = y;
+      break;
+    case 2:
+      x = NaN;
+      break;
+    case 3:
+      ay = NaN;
+      break;
+    case 4:
+      ax = INF;
+      break;
+    case 5:
+      y = -INF;
+      break;
+    case 6:
+      // Just off the destination
+      ax = std::nextafter(x, INF);
+      ay = y;
+      break;
+    }
+    input.posX.push_back(x);
+    input.posY.push_back(y);
+    input.a.push_back(ax);
+    input.b.push_back(ay);
+    input.stopped.push_back(kind(rng) < 4);
+  }
+  return input;
+}
+
+static bool sameBits(const std::vector<float> &a, const std::vector<float> &b) {
+  return a.size() == b.size() &&
+         std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+}
+
+struct Output {
+  std::vector<float> posX, posY;
+  std::vector<uint32_t> outside;
+};
+
+// All three kernels on a copy of the input with the given instruction set
+static Output runKernels(Isa isa, const Input &input, float step,
+                         sf::FloatRect area) {
+  kernels::setIsa(isa);
+  const size_t count = input.posX.size();
+
+  Output output;
+  output.outside.resize(count);
+  const size_t outside =
+      kernels::findOutside(input.posX.data(), input.posY.data(), count, area,
+                           output.outside.data());
+  output.outside.resize(outside);
+
+  output.posX = input.posX;
+  output.posY = input.posY;
+  kernels::steer(output.posX.data(), output.posY.data(), input.a.data(),
+                 input.b.data(), input.stopped.data(), count, step);
+  // Integrating on top of the steered positions, with the destinations as
+  // directions
+  kernels::integrate(output.posX.data(), output.posY.data(), input.a.data(),
+                     input.b.data(), count, step);
+  return output;
+}
+
+static void testVectorVersionsMatchScalar() {
+  const Isa supported = kernels::getSupportedIsa();
+  if (supported == Isa::Scalar)
+    std::printf("No vector instruction set, nothing to compare\n");
+
+  std::mt19937 rng(1234);
+  // Steps shorter and longer than the distances, and none
+  const float steps[] = {0.f, 0.5f, 3.25f, 1000.f};
+  const sf::FloatRect area({0.f, 0.f}, {512.f, 512.f});
+
+  for (size_t count : COUNTS) {
+    for (float step : steps) {
+      const Input input = makeInput(count, rng);
+      const Output scalar = runKernels(Isa::Scalar, input, step, area);
+
+      for (Isa isa : {Isa::SSE2, Isa::AVX2}) {
+        if (isa > supported)
+          continue;
+        const Output vector = runKernels(isa, input, step, area);
+        CHECK(sameBits(vector.posX, scalar.posX));
+        CHECK(sameBits(vector.posY, scalar.posY));
+        CHECK(vector.outside == scalar.outside);
+      }
+    }
+  }
+  kernels::setIsa(supported);
+}
+
+// The scalar version itself on the cases the vector ones have to copy
+static void testScalarEdgeCases() {
+  kernels::setIsa(Isa::Scalar);
+  float posX[] = {10.f, 10.f, 10.f, NaN};
+  float posY[] = {10.f, 10.f, 10.f, 0.f};
+  const float destX[] = {10.f, 20.f, 12.f, 0.f};
+  const float destY[] = {10.f, 10.f, 10.f, 0.f};
+  const uint8_t stopped[] = {0, 1, 0, 0};
+
+  kernels::steer(posX, posY, destX, destY, stopped, 4, 5.f);
+  // At the destination, stopped, stopping on the destination, NaN stays
+  CHECK_EQ(posX[0], 10.f);
+  CHECK_EQ(posX[1], 10.f);
+  CHECK_EQ(posX[2], 12.f);
+  CHECK(std::isnan(posX[3]));
+
+  uint32_t outside[4];
+  const float edgeX[] = {0.f, 512.f, -0.01f, NaN};
+  const float edgeY[] = {512.f, 0.f, 10.f, 10.f};
+  CHECK_EQ(kernels::findOutside(edgeX, edgeY, 4, {{0, 0}, {512, 512}},
+                                outside),
+           2u);
+  CHECK_EQ(outside[0], 2u);
+  CHECK_EQ(outside[1], 3u);
+  kernels::setIsa(kernels::getSupportedIsa());
+}
+
+int main() {
+  testVectorVersionsMatchScalar();
+  testScalarEdgeCases();
+  return testing::testResult();
+}
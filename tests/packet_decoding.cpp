@@ -0,0 +1,100 @@
+#include "AllocationCounter.hpp"
+#include "check.hpp"
+#include "network/packet.hpp"
+#include <string>
+#include <vector>
+
+using namespace network;
+
+// Heap allocations made by decoding the encoded packet
+template <typename VARIANT>
+static uint64_t decodeAllocations(const std::string &packet) {
+  const uint64_t before = getAllocationCount();
+  auto decoded = decodePacket<VARIANT>(packet);
+  const uint64_t allocations = getAllocationCount() - before;
+  CHECK(decoded.has_value());
+  return allocations;
+}
+
+static void testFixedSizePacketsDontAllocate() {
+  const std::vector<std::string> client = {
+      encodePacket(ClientPacket(JoinLobbyRequest{})),
+      encodePacket(ClientPacket(LobbyReadyRequst{.isReady = true})),
+      encodePacket(ClientPacket(
+          PlayerMoveRequest{.direction = Direction::Up, .sequence = 12})),
+      encodePacket(ClientPacket(FireballShotRequest{
+          .playerID = 3,
+          .fireball = {.id = 4, .pos = {10, 20}, .direction = {1, 0}}})),
+      encodePacket(
+          ClientPacket(SnapshotAckRequest{.enemyTick = 5, .fireballTick = 6})),
+  };
+  for (const std::string &packet : client)
+    CHECK_EQ(decodeAllocations<ClientPacket>(packet), 0u);
+
+  const std::vector<std::string> server = {
+      encodePacket(ServerPacket(PlayerDisconnectedResponse{.playerID = 1})),
+      encodePacket(
+          ServerPacket(LobbyReadyResponse{.playerID = 2, .isReady = false})),
+      encodePacket(ServerPacket(StartGameResponse{})),
+      encodePacket(ServerPacket(PlayerMoveResponse(7, {120.5f, 64.25f}, 99))),
+      encodePacket(ServerPacket(BaseHitResponse{.newHealth = 40})),
+      encodePacket(ServerPacket(GameOverResponse{.isWon = 1})),
+  };
+  for (const std::string &packet : server)
+    CHECK_EQ(decodeAllocations<ServerPacket>(packet), 0u);
+}
+
+// One reserve for the whole vector, whatever its length
+static void testVectorBodiesReserveOnce() {
+  std::vector<CachedMap> maps;
+  for (uint8_t i = 0; i < 40; ++i)
+    maps.push_back({.id = i, .hash = i * 7919ull});
+  const std::string request =
+      encodePacket(ClientPacket(GameReadyRequest(std::move(maps))));
+  CHECK_EQ(decodeAllocations<ClientPacket>(request), 1u);
+
+  SnapshotDelta<Fireball::DTO> delta;
+  delta.tick = 10;
+  delta.baselineTick = 8;
+  for (uint32_t i = 1; i <= 200; ++i) {
+    delta.entries.push_back(
+        {DeltaTraits<Fireball::DTO>::ALL_FIELDS,
+         Fireball::DTO{
+             .id = i, .pos = {i * 2.f, i * 3.f}, .direction = {0, 1}}});
+  }
+  const std::string entriesOnly =
+      encodePacket(ServerPacket(UpdateFireballsResponse(delta)));
+  CHECK_EQ(decodeAllocations<ServerPacket>(entriesOnly), 1u);
+
+  // The removed ids are a second vector
+  for (uint32_t i = 300; i < 350; ++i)
+    delta.removed.push_back(i);
+  const std::string withRemoved =
+      encodePacket(ServerPacket(UpdateFireballsResponse(std::move(delta))));
+  CHECK_EQ(decodeAllocations<ServerPacket>(withRemoved), 2u);
+}
+
+// The map buffer comes from the pool once the first one is released
+static void testMapBufferIsRecycled() {
+  GameReadyResponse response;
+  response.thisPlayerID = 1;
+  response.thisPlayerPos = {32, 32};
+  response.otherID = 2;
+  response.otherPlayerPos = {64, 32};
+  response.snapshotInterval = 1 / 20.f;
+  response.mapID = Level::Map1Data.id;
+  response.mapHash = Level::hashMap(Level::Map1Data);
+  response.map = MapBufferPool::acquire();
+  *response.map = Level::Map1Data;
+
+  const std::string packet = encodePacket(ServerPacket(std::move(response)));
+  decodeAllocations<ServerPacket>(packet);
+  CHECK_EQ(decodeAllocations<ServerPacket>(packet), 0u);
+}
+
+int main() {
+  testFixedSizePacketsDontAllocate();
+  testVectorBodiesReserveOnce();
+  testMapBufferIsRecycled();
+  return testing::testResult();
+}
@@ -0,0 +1,127 @@
+#include "check.hpp"
+#include "network/packet.hpp"
+#include "network/receive_buffer.hpp"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace network;
+
+// Feeds the data to the buffer in pieces of "chunk" bytes like recv would
+static std::vector<std::string> receiveFrames(ReceiveBuffer &buffer,
+                                              std::string_view data,
+                                              size_t chunk) {
+  std::vector<std::string> frames;
+  for (size_t offset = 0; offset < data.size(); offset += chunk) {
+    const size_t count = std::min(chunk, data.size() - offset);
+    std::span<char> dest = buffer.writable(count);
+    std::memcpy(dest.data(), data.data() + offset, count);
+    buffer.commit(count);
+
+    while (auto frame = buffer.nextFrame())
+      frames.emplace_back(*frame);
+  }
+  return frames;
+}
+
+static void testFramesSplitAcrossReads() {
+  std::string stream;
+  for (int32_t i = 0; i < 50; ++i) {
+    stream += encodePacket(
+        ServerPacket(LobbyReadyResponse{.playerID = i, .isReady = i % 2 == 0}));
+  }
+
+  // Every split of the headers and bodies
+  for (size_t chunk : {1, 3, 7, 18, 23, 4096}) {
+    ReceiveBuffer buffer;
+    const auto frames = receiveFrames(buffer, stream, chunk);
+    CHECK_EQ(frames.size(), 50u);
+    CHECK_EQ(buffer.size(), 0u);
+
+    for (int32_t i = 0; i < static_cast<int32_t>(frames.size()); ++i) {
+      auto decoded = decodePacket<ServerPacket>(frames[i]);
+      CHECK(decoded.has_value());
+      if (!decoded)
+        continue;
+      const auto *response = std::get_if<LobbyReadyResponse>(&decoded->body);
+      CHECK(response != nullptr && response->playerID == i);
+    }
+  }
+}
+
+// Bodies used to be limited by a 16 bit content length
+static void testBodyOver64KB() {
+  std::unordered_map<int32_t, bool> players;
+  for (int32_t i = 0; i < 20000; ++i)
+    players[i] = i % 3 == 0;
+
+  const std::string packet =
+      encodePacket(ServerPacket(JoinLobbyResponse(players)));
+  CHECK(packet.size() > 65535 + internal::HEADER_LENGTH_BYTES);
+
+  auto header = internal::parseHeader(packet);
+  CHECK(header.has_value());
+  if (header)
+    CHECK_EQ(header->contentLength,
+             packet.size() - internal::HEADER_LENGTH_BYTES);
+
+  // Followed by a small packet to check the framing continues after it
+  const std::string next =
+      encodePacket(ServerPacket(BaseHitResponse{.newHealth = 7}));
+
+  ReceiveBuffer buffer;
+  const auto frames = receiveFrames(buffer, packet + next, 4096);
+  CHECK_EQ(frames.size(), 2u);
+  if (frames.size() != 2)
+    return;
+
+  auto decoded = decodePacket<ServerPacket>(frames[0]);
+  CHECK(decoded.has_value());
+  if (decoded) {
+    const auto *response = std::get_if<JoinLobbyResponse>(&decoded->body);
+    CHECK(response != nullptr && response->lobbyPlayers == players);
+  }
+
+  auto hit = decodePacket<ServerPacket>(frames[1]);
+  CHECK(hit.has_value() &&
+        std::get<BaseHitResponse>(hit->body).newHealth == 7);
+}
+
+static void testBodyOverLimitIsNotSent() {
+  SnapshotDelta<Enemy::DTO> delta;
+  delta.tick = 1;
+  // A little over 10 bytes each, quantized
+  for (uint32_t i = 1; i <= 500000; ++i) {
+    delta.entries.push_back(
+        {DeltaTraits<Enemy::DTO>::ALL_FIELDS,
+         Enemy::DTO{.id = i,
+                    .pos = {i % 512 * 1.f, i % 509 * 1.f},
+                    .destination = {i % 499 * 1.f, i % 503 * 1.f},
+                    .health = 100}});
+  }
+
+  const std::string packet =
+      encodePacket(ServerPacket(EnemyUpdateResponse(std::move(delta))));
+  CHECK(packet.empty());
+}
+
+static void testHeaderOverLimitDropsStream() {
+  std::string stream;
+  internal::appendPacketHeader(stream, 0, internal::MAX_CONTENT_LENGTH + 1);
+  CHECK(!internal::parseHeader(stream).has_value());
+
+  // Not waited for - the buffer gives up on the stream
+  ReceiveBuffer buffer;
+  const auto frames = receiveFrames(buffer, stream, stream.size());
+  CHECK(frames.empty());
+  CHECK_EQ(buffer.size(), 0u);
+}
+
+int main() {
+  testFramesSplitAcrossReads();
+  testBodyOver64KB();
+  testBodyOverLimitIsNotSent();
+  testHeaderOverLimitDropsStream();
+  return testing::testResult();
+}
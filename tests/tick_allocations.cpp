@@ -0,0 +1,179 @@
+#include "AllocationCounter.hpp"
+#include "FixedTimestep.hpp"
+#include "FrameArena.hpp"
+#include "check.hpp"
+#include "game/Level.hpp"
+#include "network/packet.hpp"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Ticks run before the allocations are expected to stop
+constexpr int WARMUP_TICKS = 1200;
+constexpr int STEADY_TICKS = 10000;
+
+static void testCountsThisThreadOnly() {
+  const uint64_t before = getAllocationCount();
+  auto value = std::make_unique<int>(1);
+  CHECK_EQ(getAllocationCount() - before, 1u);
+
+  // Other threads have their own counter
+  const uint64_t beforeThread = getAllocationCount();
+  std::thread([] {
+    std::vector<int> values(1000);
+    values.resize(100000);
+  }).join();
+  // Starting the thread allocates its state here, the vector doesn't
+  CHECK(getAllocationCount() - beforeThread <= 1);
+}
+
+static void testArenaStopsAllocating() {
+  FrameArena arena(1024);
+  auto fill = [&arena] {
+    std::pmr::vector<uint64_t> values(&arena);
+    for (uint64_t i = 0; i < 4096; ++i)
+      values.push_back(i);
+    arena.reset();
+  };
+
+  // The first tick doesn't fit and takes the rest from the heap. The reset
+  // grows the buffer so the same tick fits from then on
+  fill();
+  CHECK(arena.getCapacity() > 1024);
+
+  const uint64_t before = getAllocationCount();
+  for (int i = 0; i < 100; ++i)
+    fill();
+  CHECK_EQ(getAllocationCount() - before, 0u);
+  CHECK_EQ(arena.getUsed(), 0u);
+}
+
+/**
+ * What the server does every tick without the sockets: the simulation with
+ * fireballs shot into the enemies, a snapshot in the history and its delta
+ * made in the frame arena and encoded into a reused buffer
+ **/
+static void testSimulationTicksStopAllocating() {
+  Level level(Level::Map1Data, true);
+  network::SnapshotHistory<Enemy::DTO> history;
+  network::SnapshotTick snapshotTick = 0;
+  std::string encoded;
+
+  FixedTimestep timestep(60);
+  uint32_t tick = 0;
+  auto runTick = [&](float dt) {
+    if (tick % 3 == 0) {
+      const float angle = tick * 0.37f;
+      level.spawnFireball(level.getPlayerStartPos(),
+                          {std::cos(angle), std::sin(angle)});
+    }
+    ++tick;
+
+    level.update(dt);
+    level.handleFireballHits();
+    if (level.handleBaseHits())
+      level.base.healthbar.health = level.base.healthbar.maxHealth;
+
+    auto &snapshot = history.emplace(++snapshotTick);
+    for (uint32_t i = 0; i < level.enemies.size(); ++i)
+      snapshot.entities.push_back(level.enemies.toDTO(i));
+    std::ranges::sort(snapshot.entities, {}, &Enemy::DTO::id);
+
+    const auto delta = network::makeDelta(history.find(snapshotTick - 1),
+                                          snapshot, &FrameArena::get());
+    encoded.clear();
+    delta.serialize(encoded, network::Encoding::Quantized);
+  };
+
+  for (int i = 0; i < WARMUP_TICKS; ++i)
+    timestep.run(timestep.getTickDt(), runTick);
+
+  const uint64_t before = getAllocationCount();
+  uint64_t maxAllocations = 0;
+  for (int i = 0; i < STEADY_TICKS; ++i) {
+    timestep.run(timestep.getTickDt(), runTick);
+    maxAllocations =
+        std::max(maxAllocations, timestep.getStats().maxAllocations);
+  }
+
+  CHECK(level.enemies.size() > 0 || level.fireballs.size() > 0);
+  CHECK_EQ(getAllocationCount() - before, 0u);
+  // What the tick stats report, the same number
+  CHECK_EQ(maxAllocations, 0u);
+}
+
+// Enemies spawned and killed at random on the server and mirrored by a
+// client through the ids of the snapshots
+struct EntityChurn {
+  // Most enemies at once
+  static constexpr uint32_t MAX_ENEMIES = 1000;
+
+  std::mt19937 rng{42};
+  EnemyArrays server, client;
+
+  void tick() {
+    std::uniform_int_distribution<uint32_t> count(0, 40);
+    for (uint32_t i = count(rng); i > 0 && server.size() > 0; --i) {
+      std::uniform_int_distribution<size_t> pick(0, server.size() - 1);
+      server.remove(server.ids()[pick(rng)]);
+    }
+    for (uint32_t i = count(rng); i > 0 && server.size() < MAX_ENEMIES; --i)
+      server.insert({i * 1.f, 0.f}, {0.f, i * 1.f});
+
+    client.removeIf(
+        [this](uint32_t i) { return !server.contains(client.ids()[i]); });
+    for (uint32_t i = 0; i < server.size(); ++i)
+      client.assign(server.toDTO(i));
+  }
+};
+
+static void testEntityChurnStopsAllocating() {
+  EntityChurn churn;
+  // Up to the most enemies there will be
+  while (churn.server.size() < EntityChurn::MAX_ENEMIES)
+    churn.tick();
+
+  const uint64_t before = getAllocationCount();
+  for (int i = 0; i < STEADY_TICKS; ++i)
+    churn.tick();
+  CHECK_EQ(getAllocationCount() - before, 0u);
+  CHECK(churn.client.size() == churn.server.size());
+  CHECK(churn.client.capacity() <= 2 * EntityChurn::MAX_ENEMIES);
+}
+
+// Growing allocates every vector once, the slot table along with the columns
+static void testEntityArraysGrowOnce() {
+  EnemyArrays enemies;
+  size_t vectors = 0;
+  enemies.forEachColumn([&vectors](auto &) { ++vectors; });
+  // The 3 of the slot table and the scratch of removeOutside
+  vectors += 4;
+
+  for (size_t i = 0; i < EnemyArrays::CHUNK; ++i)
+    enemies.insert({0.f, 0.f}, {0.f, 0.f});
+  const uint64_t before = getAllocationCount();
+  enemies.insert({0.f, 0.f}, {0.f, 0.f});
+  CHECK_EQ(getAllocationCount() - before, vectors);
+
+  // Same for an id of the server past the end of the slots
+  EnemyArrays mirror;
+  const uint64_t beforeAssign = getAllocationCount();
+  mirror.assign({.id = SlotTable::makeID(EnemyArrays::CHUNK * 3, 1),
+                 .pos = {0.f, 0.f},
+                 .destination = {0.f, 0.f},
+                 .health = 50});
+  CHECK_EQ(getAllocationCount() - beforeAssign, vectors);
+  CHECK(mirror.capacity() > EnemyArrays::CHUNK * 3);
+}
+
+int main() {
+  testCountsThisThreadOnly();
+  testArenaStopsAllocating();
+  testSimulationTicksStopAllocating();
+  testEntityChurnStopsAllocating();
+  testEntityArraysGrowOnce();
+  return testing::testResult();
+}
@@ -0,0 +1,247 @@
+#include "AllocationCounter.hpp"
+#include "check.hpp"
+#include "network/packet.hpp"
+#include "network/udp.hpp"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace network;
+
+constexpr internal::ConnectionID CONNECTION = 7;
+
+static SharedMessage enemySnapshot(SnapshotTick tick, uint32_t count) {
+  SnapshotDelta<Enemy::DTO> delta;
+  delta.tick = tick;
+  for (uint32_t i = 1; i <= count; ++i) {
+    delta.entries.push_back(
+        {DeltaTraits<Enemy::DTO>::ALL_FIELDS,
+         Enemy::DTO{.id = i,
+                    .pos = {i % 512 * 1.f, tick * 1.f},
+                    .destination = {i % 499 * 1.f, i % 503 * 1.f},
+                    .health = 100}});
+  }
+  return std::make_shared<const std::string>(
+      encodePacket(ServerPacket(EnemyUpdateResponse(std::move(delta)))));
+}
+
+static SharedMessage lobby(int32_t players) {
+  std::unordered_map<int32_t, bool> lobbyPlayers;
+  for (int32_t i = 0; i < players; ++i)
+    lobbyPlayers[i] = i % 2 == 0;
+  return std::make_shared<const std::string>(
+      encodePacket(ServerPacket(JoinLobbyResponse(lobbyPlayers))));
+}
+
+// Copies of the datagrams of one collectDatagrams call
+static std::vector<std::string> collect(UdpConnection &connection) {
+  const auto datagrams = connection.collectDatagrams();
+  return {datagrams.begin(), datagrams.end()};
+}
+
+static std::vector<std::string>
+receiveAll(UdpConnection &connection,
+           const std::vector<std::string> &datagrams) {
+  ReceiveBuffer incoming;
+  for (const std::string &datagram : datagrams)
+    CHECK(connection.receive(datagram, incoming).has_value());
+
+  std::vector<std::string> frames;
+  while (auto frame = incoming.nextFrame())
+    frames.emplace_back(*frame);
+  return frames;
+}
+
+static void testDatagramsStayUnderMtu() {
+  UdpConnection sender(CONNECTION), receiver(CONNECTION);
+  const SharedMessage reliable = lobby(5000);
+  const SharedMessage unreliable = enemySnapshot(1, 5000);
+  const SharedMessage small = lobby(2);
+  CHECK(reliable->size() > 10 * internal::MAX_DATAGRAM_BYTES);
+  CHECK(unreliable->size() > 10 * internal::MAX_DATAGRAM_BYTES);
+
+  sender.queue(reliable, Channel::Reliable);
+  sender.queue(unreliable, Channel::Unreliable);
+  sender.queue(small, Channel::Reliable);
+
+  const auto datagrams = collect(sender);
+  for (const std::string &datagram : datagrams)
+    CHECK(datagram.size() <= internal::MAX_DATAGRAM_BYTES);
+
+  // The unreliable one goes first, then the reliable ones in order
+  const auto frames = receiveAll(receiver, datagrams);
+  CHECK_EQ(frames.size(), 3u);
+  if (frames.size() == 3) {
+    CHECK(frames[0] == *unreliable);
+    CHECK(frames[1] == *reliable);
+    CHECK(frames[2] == *small);
+  }
+}
+
+static void testReorderedFragments() {
+  UdpConnection sender(CONNECTION), receiver(CONNECTION);
+  const SharedMessage snapshot = enemySnapshot(1, 3000);
+  sender.queue(snapshot, Channel::Unreliable);
+
+  auto datagrams = collect(sender);
+  CHECK(datagrams.size() > 2);
+  std::ranges::reverse(datagrams);
+  // A duplicate of one of them on top
+  datagrams.push_back(datagrams[1]);
+
+  const auto frames = receiveAll(receiver, datagrams);
+  CHECK_EQ(frames.size(), 1u);
+  CHECK(!frames.empty() && frames[0] == *snapshot);
+}
+
+// A lost fragment loses its snapshot, the next one still gets through
+static void testLostUnreliableFragment() {
+  UdpConnection sender(CONNECTION), receiver(CONNECTION);
+  const SharedMessage first = enemySnapshot(1, 3000);
+  const SharedMessage second = enemySnapshot(2, 3000);
+
+  sender.queue(first, Channel::Unreliable);
+  auto datagrams = collect(sender);
+  datagrams.erase(datagrams.begin() + datagrams.size() / 2);
+  CHECK(receiveAll(receiver, datagrams).empty());
+
+  sender.queue(second, Channel::Unreliable);
+  const auto frames = receiveAll(receiver, collect(sender));
+  CHECK_EQ(frames.size(), 1u);
+  CHECK(!frames.empty() && frames[0] == *second);
+}
+
+// Latest wins for whole snapshots put together from fragments as well
+static void testOlderSnapshotIsDropped() {
+  UdpConnection sender(CONNECTION), receiver(CONNECTION);
+  const SharedMessage older = enemySnapshot(1, 3000);
+  const SharedMessage newer = enemySnapshot(2, 3000);
+
+  sender.queue(older, Channel::Unreliable);
+  const auto olderDatagrams = collect(sender);
+  sender.queue(newer, Channel::Unreliable);
+  auto datagrams = collect(sender);
+  datagrams.insert(datagrams.end(), olderDatagrams.begin(),
+                   olderDatagrams.end());
+
+  const auto frames = receiveAll(receiver, datagrams);
+  CHECK_EQ(frames.size(), 1u);
+  CHECK(!frames.empty() && frames[0] == *newer);
+}
+
+// Only the lost fragment is sent again
+static void testLostReliableFragmentIsResent() {
+  UdpConnection sender(CONNECTION), receiver(CONNECTION);
+  const SharedMessage message = lobby(5000);
+  sender.queue(message, Channel::Reliable);
+
+  auto datagrams = collect(sender);
+  const size_t sent = datagrams.size();
+  datagrams.erase(datagrams.begin() + 3);
+  CHECK(receiveAll(receiver, datagrams).empty());
+
+  // Acknowledging what arrived
+  receiveAll(sender, collect(receiver));
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(150));
+  const auto resent = collect(sender);
+  CHECK_EQ(resent.size(), 1u);
+
+  ReceiveBuffer incoming;
+  for (const std::string &datagram : datagrams)
+    receiver.receive(datagram, incoming);
+  CHECK(!incoming.nextFrame().has_value());
+  CHECK(sent > resent.size());
+
+  const auto frames = receiveAll(receiver, resent);
+  CHECK_EQ(frames.size(), 1u);
+  CHECK(!frames.empty() && frames[0] == *message);
+}
+
+// More than an ack covers is spread over the next calls, nothing is resent
+static void testReliableBurstIsSpread() {
+  UdpConnection sender(CONNECTION), receiver(CONNECTION);
+  const SharedMessage message = lobby(30000);
+  const size_t fragments = internal::fragmentCount(message->size());
+  sender.queue(message, Channel::Reliable);
+
+  size_t sent = 0;
+  std::vector<std::string> frames;
+  for (int i = 0; i < 20 && frames.empty(); ++i) {
+    const auto datagrams = collect(sender);
+    CHECK(datagrams.size() <= 33);
+    sent += datagrams.size();
+    frames = receiveAll(receiver, datagrams);
+    receiveAll(sender, collect(receiver));
+  }
+
+  CHECK(fragments > 100);
+  CHECK_EQ(sent, fragments);
+  CHECK_EQ(frames.size(), 1u);
+  CHECK(!frames.empty() && frames[0] == *message);
+}
+
+// Moves of different players don't replace each other
+static void testPlayerMovesAreReliable() {
+  static_assert(channelOf<PlayerMoveResponse>() == Channel::Reliable);
+
+  UdpConnection sender(CONNECTION), receiver(CONNECTION);
+  auto move = [](EntityID player) {
+    return std::make_shared<const std::string>(encodePacket(
+        ServerPacket(PlayerMoveResponse(player, {32.f * player, 64}, 1))));
+  };
+
+  sender.queue(move(1), Channel::Reliable);
+  const auto first = collect(sender);
+  sender.queue(move(2), Channel::Reliable);
+  auto datagrams = collect(sender);
+  datagrams.insert(datagrams.end(), first.begin(), first.end());
+
+  const auto frames = receiveAll(receiver, datagrams);
+  CHECK_EQ(frames.size(), 2u);
+  if (frames.size() == 2) {
+    CHECK(frames[0] == *move(1));
+    CHECK(frames[1] == *move(2));
+  }
+}
+
+// A fragment claiming more fragments than the biggest packet has is dropped
+// before its frame gets a buffer
+static void testForgedFragmentCountIsDropped() {
+  for (const uint16_t count :
+       {static_cast<uint16_t>(internal::MAX_FRAGMENTS + 1), uint16_t{65535}}) {
+    UdpConnection sender(CONNECTION), receiver(CONNECTION);
+    sender.queue(enemySnapshot(1, 3000), Channel::Unreliable);
+    auto datagrams = collect(sender);
+    CHECK(datagrams.size() > 2);
+
+    // The first fragment is a full one: Channel | FragmentHeader | bytes
+    std::string forged = datagrams.front();
+    datagrams.erase(datagrams.begin());
+    std::memcpy(forged.data() + internal::DATAGRAM_HEADER_BYTES +
+                    sizeof(Channel) + sizeof(uint16_t),
+                &count, sizeof(count));
+    CHECK(receiveAll(receiver, datagrams).empty());
+
+    ReceiveBuffer incoming;
+    const uint64_t before = getAllocationCount();
+    CHECK(receiver.receive(forged, incoming).has_value());
+    CHECK_EQ(getAllocationCount() - before, 0u);
+    CHECK(!incoming.nextFrame());
+  }
+}
+
+int main() {
+  testDatagramsStayUnderMtu();
+  testReorderedFragments();
+  testLostUnreliableFragment();
+  testOlderSnapshotIsDropped();
+  testLostReliableFragmentIsResent();
+  testReliableBurstIsSpread();
+  testPlayerMovesAreReliable();
+  testForgedFragmentCountIsDropped();
+  return testing::testResult();
+}